@@ -1,7 +1,3 @@
-#include <coel/codegen/Context.hh>
-#include <coel/codegen/RegisterAllocator.hh>
-#include <coel/graph/DepthFirstSearch.hh>
-#include <coel/graph/DotGraph.hh>
 #include <coel/ir/BasicBlock.hh>
 #include <coel/ir/Constant.hh>
 #include <coel/ir/Dumper.hh>
@@ -9,15 +5,12 @@
 #include <coel/ir/Instructions.hh>
 #include <coel/ir/Types.hh>
 #include <coel/ir/Unit.hh>
-#include <coel/support/Assert.hh>
-#include <coel/x86/Backend.hh>
-#include <coel/x86/Legaliser.hh>
+#include <coel/jit/JitSession.hh>
 
 #include <fmt/core.h>
 
-#include <fstream>
-#include <sstream>
-#include <sys/mman.h>
+#include <array>
+#include <vector>
 
 using namespace coel;
 
@@ -55,29 +48,6 @@ int main() {
     fmt::print("=====\n");
     ir::dump(unit);
 
-    codegen::Context context(unit);
-    x86::legalise(context);
-
-    fmt::print("=========\n");
-    fmt::print("LEGALISED\n");
-    fmt::print("=========\n");
-    ir::dump(unit);
-
-    codegen::register_allocate(context);
-
-    fmt::print("===================\n");
-    fmt::print("ALLOCATED REGISTERS\n");
-    fmt::print("===================\n");
-    ir::dump(unit);
-
-    auto compiled = x86::compile(unit);
-    auto [entry, encoded] = x86::encode(compiled, main);
-    std::ofstream output_file("foo.bin", std::ios::binary | std::ios::trunc);
-    output_file.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
-    output_file.flush();
-    auto *code_region =
-        // NOLINTNEXTLINE
-        mmap(nullptr, encoded.size(), PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    memcpy(code_region, encoded.data(), encoded.size());
-    return reinterpret_cast<int (*)()>(static_cast<std::uint8_t *>(code_region) + entry)();
+    jit::JitSession session(unit);
+    return session.function<int()>(main)();
 }
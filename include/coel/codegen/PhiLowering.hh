@@ -0,0 +1,18 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::codegen {
+
+class Context;
+
+// Takes functions out of SSA form by replacing their phis with copies through virtual registers, which needs to happen
+// before legalisation. Critical edges are split first so that every copy has a block of its own to go in.
+void lower_phis(Context &context);
+void lower_phis(Context &context, ir::Function &function);
+
+} // namespace coel::codegen
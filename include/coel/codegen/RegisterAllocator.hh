@@ -1,9 +1,16 @@
 #pragma once
 
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
 namespace coel::codegen {
 
 class Context;
 
 void register_allocate(Context &context);
+void register_allocate(Context &context, ir::Function &function);
 
 } // namespace coel::codegen
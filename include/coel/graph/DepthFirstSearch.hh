@@ -3,6 +3,7 @@
 #include <coel/graph/Graph.hh>
 
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace coel {
@@ -20,6 +21,7 @@ private:
 
     std::vector<N *> m_pre_order;
     std::vector<N *> m_post_order;
+    std::vector<std::pair<N *, N *>> m_back_edges;
 
     void dfs(const Graph<N> *graph, std::unordered_map<N *, State> &state, N *node);
 
@@ -30,12 +32,17 @@ protected:
 public:
     const std::vector<N *> &pre_order() const { return m_pre_order; }
     const std::vector<N *> &post_order() const { return m_post_order; }
+    // Edges from a node to one of its ancestors in the search tree, i.e. the edges which close a cycle.
+    const std::vector<std::pair<N *, N *>> &back_edges() const { return m_back_edges; }
 };
 
 template <typename N>
 void DepthFirstSearch<N>::dfs(const Graph<N> *graph, std::unordered_map<N *, State> &state, N *node) {
     m_pre_order.push_back(node);
     for (auto *succ : graph->succs(node)) {
+        if (state[succ] == State::Exploring) {
+            m_back_edges.emplace_back(node, succ);
+        }
         if (state[succ] != State::Unexplored) {
             continue;
         }
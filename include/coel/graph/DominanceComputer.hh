@@ -54,25 +54,24 @@ typename DominanceComputer<N>::Result DominanceComputer<N>::run(const Graph<N> *
     COEL_ASSERT(order.front() == graph->entry());
     order.erase(order.begin());
 
-    // TODO: Clean this up.
+    // Iterate until the immediate dominators settle. Predecessors that haven't been given a dominator yet, including
+    // unreachable ones, are skipped. At least one predecessor of every node comes before it in reverse post-order.
     bool changed = true;
     while (changed) {
         changed = false;
         for (auto *b : order) {
             N *new_idom = nullptr;
             for (auto *pred : graph->preds(b)) {
-                if (!graph->preds(pred).empty() || pred == graph->entry()) {
-                    new_idom = pred;
-                    break;
+                if (doms.contains(pred)) {
+                    new_idom = new_idom != nullptr ? intersect(pred, new_idom) : pred;
                 }
             }
-            for (auto *p : graph->preds(b)) {
-                if (p != new_idom && doms.contains(p)) {
-                    new_idom = intersect(p, new_idom);
-                }
+            COEL_ASSERT(new_idom != nullptr);
+            auto [it, inserted] = doms.try_emplace(b, new_idom);
+            if (inserted || it->second != new_idom) {
+                it->second = new_idom;
+                changed = true;
             }
-            changed = doms[b] == new_idom;
-            doms[b] = new_idom;
         }
     }
 
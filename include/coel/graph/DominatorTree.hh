@@ -1,17 +1,44 @@
 #pragma once
 
+#include <coel/graph/DepthFirstSearch.hh>
 #include <coel/graph/Graph.hh>
 #include <coel/support/Assert.hh>
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 namespace coel {
 
 template <typename N>
 struct DominatorTree : public Graph<N> {
     explicit DominatorTree(N *entry) : Graph<N>(entry) {}
 
+    // Returns whether the node was reachable from the entry of the graph the tree was computed from.
+    bool contains(const N *node) const;
+    bool dominates(const N *dominator, const N *node) const;
     N *idom(const N *node) const;
+
+    // Computes the dominance frontier of every reachable node of the graph the tree was computed from, that is the
+    // nodes which have a predecessor dominated by the node but aren't strictly dominated by it themselves.
+    std::unordered_map<const N *, std::vector<N *>> frontiers(const Graph<N> &graph) const;
 };
 
+template <typename N>
+bool DominatorTree<N>::contains(const N *node) const {
+    return node == this->entry() || !this->preds(node).empty();
+}
+
+template <typename N>
+bool DominatorTree<N>::dominates(const N *dominator, const N *node) const {
+    for (; node != nullptr; node = idom(node)) {
+        if (node == dominator) {
+            return true;
+        }
+    }
+    return false;
+}
+
 template <typename N>
 N *DominatorTree<N>::idom(const N *node) const {
     if (node == this->entry()) {
@@ -21,4 +48,29 @@ N *DominatorTree<N>::idom(const N *node) const {
     return this->preds(node)[0];
 }
 
+template <typename N>
+std::unordered_map<const N *, std::vector<N *>> DominatorTree<N>::frontiers(const Graph<N> &graph) const {
+    std::unordered_map<const N *, std::vector<N *>> frontiers;
+    const auto dfs = graph.template run<DepthFirstSearch>();
+    for (auto *node : dfs.pre_order()) {
+        const auto &preds = graph.preds(node);
+        if (preds.size() < 2) {
+            continue;
+        }
+        // Walk up from each reachable predecessor until reaching the immediate dominator of the join node.
+        for (auto *pred : preds) {
+            if (!contains(pred)) {
+                continue;
+            }
+            for (auto *runner = pred; runner != idom(node); runner = idom(runner)) {
+                auto &frontier = frontiers[runner];
+                if (std::find(frontier.begin(), frontier.end(), node) == frontier.end()) {
+                    frontier.push_back(node);
+                }
+            }
+        }
+    }
+    return frontiers;
+}
+
 } // namespace coel
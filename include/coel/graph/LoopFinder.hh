@@ -0,0 +1,108 @@
+#pragma once
+
+#include <coel/graph/DepthFirstSearch.hh>
+#include <coel/graph/DominanceComputer.hh>
+#include <coel/graph/DominatorTree.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/graph/LoopInfo.hh>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace coel {
+
+// Finds the natural loops of a graph. An edge is a back edge if its destination dominates its source, so the cycles of
+// irreducible control flow don't form loops.
+template <typename N>
+class LoopFinder {
+    friend Graph<N>;
+
+protected:
+    using Result = LoopInfo<N>;
+    Result run(const Graph<N> *graph);
+};
+
+template <typename N>
+typename LoopFinder<N>::Result LoopFinder<N>::run(const Graph<N> *graph) {
+    const auto tree = graph->template run<DominanceComputer>();
+    const auto dfs = graph->template run<DepthFirstSearch>();
+    Result info;
+
+    // A header is finished in the search after any header it dominates, so visiting headers in post-order builds inner
+    // loops first.
+    for (auto *header : dfs.post_order()) {
+        std::vector<N *> worklist;
+        for (auto *pred : graph->preds(header)) {
+            if (tree.contains(pred) && tree.dominates(header, pred)) {
+                worklist.push_back(pred);
+            }
+        }
+        if (worklist.empty()) {
+            continue;
+        }
+
+        auto *loop = info.m_loops.emplace_back(std::make_unique<Loop<N>>(header)).get();
+        loop->m_latches = worklist;
+        loop->add_node(header);
+        info.m_innermost.emplace(header, loop);
+
+        // Walk backwards from the latches. Loops found on the way that aren't nested in anything yet become children of
+        // this one and are stepped over by way of their header.
+        while (!worklist.empty()) {
+            auto *node = worklist.back();
+            worklist.pop_back();
+            if (auto *inner = info.loop_of(node)) {
+                while (inner->m_parent != nullptr) {
+                    inner = inner->m_parent;
+                }
+                if (inner == loop) {
+                    continue;
+                }
+                inner->m_parent = loop;
+                loop->m_children.push_back(inner);
+                node = inner->header();
+            } else {
+                info.m_innermost.emplace(node, loop);
+                loop->add_node(node);
+            }
+            for (auto *pred : graph->preds(node)) {
+                if (tree.contains(pred)) {
+                    worklist.push_back(pred);
+                }
+            }
+        }
+    }
+
+    for (const auto &loop : info.m_loops) {
+        for (auto *child : loop->m_children) {
+            for (auto *node : child->m_nodes) {
+                loop->add_node(node);
+            }
+        }
+        for (auto *node : loop->m_nodes) {
+            for (auto *succ : graph->succs(node)) {
+                const auto &exits = loop->m_exits;
+                if (!loop->contains(succ) && std::find(exits.begin(), exits.end(), succ) == exits.end()) {
+                    loop->m_exits.push_back(succ);
+                }
+            }
+        }
+
+        std::vector<N *> outside_preds;
+        for (auto *pred : graph->preds(loop->header())) {
+            if (!loop->contains(pred)) {
+                outside_preds.push_back(pred);
+            }
+        }
+        if (outside_preds.size() == 1 && graph->succs(outside_preds[0]).size() == 1) {
+            loop->m_preheader = outside_preds[0];
+        }
+        if (loop->m_parent == nullptr) {
+            info.m_top_level.push_back(loop.get());
+        }
+    }
+    return info;
+}
+
+} // namespace coel
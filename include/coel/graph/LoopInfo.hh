@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace coel {
+
+template <typename N>
+class LoopFinder;
+
+// A natural loop: a header which dominates every node of the loop, and the nodes that can reach a back edge into the
+// header without going through it.
+template <typename N>
+class Loop {
+    friend LoopFinder<N>;
+
+private:
+    N *const m_header;
+    Loop *m_parent{nullptr};
+    std::vector<Loop *> m_children;
+    std::vector<N *> m_nodes;
+    std::unordered_set<const N *> m_node_set;
+    std::vector<N *> m_latches;
+    std::vector<N *> m_exits;
+    N *m_preheader{nullptr};
+
+    void add_node(N *node);
+
+public:
+    explicit Loop(N *header) : m_header(header) {}
+    Loop(const Loop &) = delete;
+    Loop(Loop &&) = delete;
+    ~Loop() = default;
+
+    Loop &operator=(const Loop &) = delete;
+    Loop &operator=(Loop &&) = delete;
+
+    bool contains(const N *node) const { return m_node_set.contains(node); }
+    // Returns the number of loops this one is nested in, plus one.
+    std::size_t depth() const;
+
+    N *header() const { return m_header; }
+    Loop *parent() const { return m_parent; }
+    const std::vector<Loop *> &children() const { return m_children; }
+    // All of the nodes in the loop, including those in nested loops, starting with the header.
+    const std::vector<N *> &nodes() const { return m_nodes; }
+    // The nodes in the loop that branch back to the header.
+    const std::vector<N *> &latches() const { return m_latches; }
+    // The nodes outside of the loop that are branched to from inside it.
+    const std::vector<N *> &exits() const { return m_exits; }
+    // The only predecessor of the header from outside of the loop if it has no other successors, or null.
+    N *preheader() const { return m_preheader; }
+};
+
+template <typename N>
+class LoopInfo {
+    friend LoopFinder<N>;
+
+private:
+    // Inner loops come before the loops they're nested in.
+    std::vector<std::unique_ptr<Loop<N>>> m_loops;
+    std::vector<Loop<N> *> m_top_level;
+    std::unordered_map<const N *, Loop<N> *> m_innermost;
+
+public:
+    // Returns the innermost loop containing the node, or null if it isn't in a loop.
+    Loop<N> *loop_of(const N *node) const;
+    // Returns the number of loops the node is in.
+    std::size_t depth(const N *node) const;
+    bool is_header(const N *node) const;
+
+    const std::vector<std::unique_ptr<Loop<N>>> &loops() const { return m_loops; }
+    const std::vector<Loop<N> *> &top_level() const { return m_top_level; }
+};
+
+template <typename N>
+void Loop<N>::add_node(N *node) {
+    if (m_node_set.insert(node).second) {
+        m_nodes.push_back(node);
+    }
+}
+
+template <typename N>
+std::size_t Loop<N>::depth() const {
+    std::size_t depth = 1;
+    for (auto *loop = m_parent; loop != nullptr; loop = loop->m_parent) {
+        depth++;
+    }
+    return depth;
+}
+
+template <typename N>
+Loop<N> *LoopInfo<N>::loop_of(const N *node) const {
+    auto it = m_innermost.find(node);
+    return it != m_innermost.end() ? it->second : nullptr;
+}
+
+template <typename N>
+std::size_t LoopInfo<N>::depth(const N *node) const {
+    auto *loop = loop_of(node);
+    return loop != nullptr ? loop->depth() : 0;
+}
+
+template <typename N>
+bool LoopInfo<N>::is_header(const N *node) const {
+    auto *loop = loop_of(node);
+    return loop != nullptr && loop->header() == node;
+}
+
+} // namespace coel
@@ -41,8 +41,16 @@ public:
     template <std::derived_from<Instruction> Inst, typename... Args>
     Inst *append(Args &&...args);
 
+    // Destroys an instruction of the block, which mustn't have any users left.
+    void remove(Instruction *inst);
+    // Moves all of the instructions of another block onto the end of this one.
+    void splice(BasicBlock *other);
+    // Moves an instruction of this block to before the given position in another block.
+    void transfer(Instruction *inst, BasicBlock *block, Instruction *position);
+
     bool empty() const;
     bool has_terminator() const;
+    Instruction *terminator() const;
 };
 
 inline auto BasicBlock::iterator(Instruction *position) const {
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace coel::ir {
+
+class BasicBlock;
+class Function;
+class Value;
+
+// Returns a detached copy of the given function. Calls in the copy still refer to the original callees, so the copy can
+// be compiled against the same symbols as the original.
+std::unique_ptr<Function> clone(const Function &function);
+
+// Appends a copy of the given blocks of a function, in order, and of its stack slots to another function. Values
+// already in the value map are used in place of the originals, and the map is filled in with the copy of every other
+// value. The blocks must only branch to each other, and any value they use from outside of them must be in the map.
+// Phis only keep the values coming in from the copied blocks.
+void clone_into(const Function &function, const std::vector<const BasicBlock *> &blocks, Function &target,
+                std::unordered_map<const Value *, Value *> &value_map);
+
+} // namespace coel::ir
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <coel/graph/Graph.hh>
+
+#include <vector>
+
+namespace coel::ir {
+
+class BasicBlock;
+class Function;
+
+// Returns the blocks that the terminator of a block branches to.
+std::vector<BasicBlock *> successors(BasicBlock *block);
+
+// Builds the control flow graph of a function, entered at its first block.
+Graph<BasicBlock> build_cfg(Function &function);
+
+// Splits every edge from a block with several successors to a block with several predecessors by placing a block that
+// only branches on to the original target after the source, so that code can be put on the edge. The incoming blocks of
+// phis in the target are updated.
+void split_critical_edges(Function &function);
+
+// Gives every natural loop a preheader, a block outside of the loop whose only successor is the header and which is the
+// only way into the loop, by placing one before the header when needed. The phis of the header take the values from
+// outside of the loop from the preheader, merging them there first if there are several ways in. Loops headed by the
+// entry block are left alone.
+void insert_loop_preheaders(Function &function);
+
+// Deletes the blocks that can't be reached from the entry, taking their edges out of the phis of reachable blocks.
+void remove_unreachable_blocks(Function &function);
+
+} // namespace coel::ir
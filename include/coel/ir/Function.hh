@@ -16,22 +16,29 @@ namespace coel::ir {
 
 class Function final : public Value, public ListNode {
     const std::string m_name;
+    const void *const m_address;
     std::vector<Argument> m_arguments;
     List<BasicBlock> m_blocks;
     List<StackSlot> m_stack_slots;
 
 public:
-    Function(std::string &&name, const Type *return_type, std::span<const Type *> parameters);
+    Function(std::string &&name, const Type *return_type, std::span<const Type *> parameters,
+             const void *address = nullptr);
 
     auto begin() const { return m_blocks.begin(); }
     auto end() const { return m_blocks.end(); }
 
     BasicBlock *append_block();
+    BasicBlock *insert_block(ListIterator<BasicBlock> position);
+    void remove_block(BasicBlock *block);
     StackSlot *append_stack_slot(const Type *type);
+    void remove_stack_slot(StackSlot *stack_slot);
     Argument *argument(std::size_t index) { return &m_arguments[index]; }
     const Argument *argument(std::size_t index) const { return &m_arguments[index]; }
 
+    bool is_external() const { return m_address != nullptr; }
     const std::string &name() const { return m_name; }
+    const void *address() const { return m_address; }
     const std::vector<Argument> &arguments() const { return m_arguments; }
     const List<StackSlot> &stack_slots() const { return m_stack_slots; }
 };
@@ -9,6 +9,7 @@ class CompareInst;
 class CondBranchInst;
 class CopyInst;
 class LoadInst;
+class PhiInst;
 class RetInst;
 class StoreInst;
 
@@ -20,6 +21,7 @@ struct InstVisitor {
     virtual void visit(CondBranchInst *) = 0;
     virtual void visit(CopyInst *) = 0;
     virtual void visit(LoadInst *) = 0;
+    virtual void visit(PhiInst *) = 0;
     virtual void visit(RetInst *) = 0;
     virtual void visit(StoreInst *) = 0;
 };
@@ -15,6 +15,7 @@ enum class Opcode {
     CondBranch,
     Copy,
     Load,
+    Phi,
     Ret,
     Store,
 };
@@ -3,6 +3,7 @@
 #include <coel/codegen/Register.hh>
 #include <coel/ir/Instruction.hh>
 
+#include <utility>
 #include <vector>
 
 namespace coel::ir {
@@ -78,6 +79,7 @@ public:
     const std::vector<Value *> &args() const { return m_args; }
 };
 
+// Lt, Gt, Le and Ge treat their operands as signed, and the U variants as unsigned.
 enum class CompareOp {
     Eq,
     Ne,
@@ -85,6 +87,10 @@ enum class CompareOp {
     Gt,
     Le,
     Ge,
+    ULt,
+    UGt,
+    ULe,
+    UGe,
 };
 
 class CompareInst final : public Instruction {
@@ -175,6 +181,33 @@ public:
     Value *ptr() const { return m_ptr; }
 };
 
+// Selects the value for the predecessor that control came from. Phis come before any other instruction in a block, and
+// all of the phis of a block are evaluated at once on entry to it.
+class PhiInst final : public Instruction {
+    std::vector<std::pair<BasicBlock *, Value *>> m_incoming;
+
+    bool uses(const Value *value) const;
+
+public:
+    explicit PhiInst(const Type *type);
+    PhiInst(const PhiInst &) = delete;
+    PhiInst(PhiInst &&) = delete;
+    ~PhiInst() override;
+
+    PhiInst &operator=(const PhiInst &) = delete;
+    PhiInst &operator=(PhiInst &&) = delete;
+
+    void accept(InstVisitor *visitor) override;
+    bool is_terminator() const override { return false; }
+    void replace_uses_of_with(Value *orig, Value *repl) override;
+    void add_incoming(BasicBlock *block, Value *value);
+    void remove_incoming(BasicBlock *block);
+
+    // Returns the value coming in from the given predecessor, or null if there isn't one.
+    Value *incoming_value(const BasicBlock *block) const;
+    const std::vector<std::pair<BasicBlock *, Value *>> &incoming() const { return m_incoming; }
+};
+
 class RetInst final : public Instruction {
     Value *m_value;
 
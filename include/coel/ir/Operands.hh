@@ -0,0 +1,35 @@
+#pragma once
+
+#include <coel/ir/InstVisitor.hh>
+#include <coel/ir/Instructions.hh>
+
+#include <vector>
+
+namespace coel::ir {
+
+// The values read by an instruction. Blocks branched to aren't included.
+class Operands final : public InstVisitor {
+    std::vector<Value *> m_values;
+
+public:
+    explicit Operands(Instruction *inst) { inst->accept(this); }
+
+    void visit(BinaryInst *binary) override { m_values = {binary->lhs(), binary->rhs()}; }
+    void visit(BranchInst *) override {}
+    void visit(CallInst *call) override { m_values = call->args(); }
+    void visit(CompareInst *compare) override { m_values = {compare->lhs(), compare->rhs()}; }
+    void visit(CondBranchInst *cond_branch) override { m_values = {cond_branch->cond()}; }
+    void visit(CopyInst *copy) override { m_values = {copy->src()}; }
+    void visit(LoadInst *load) override { m_values = {load->ptr()}; }
+    void visit(PhiInst *phi) override {
+        for (auto [block, value] : phi->incoming()) {
+            m_values.push_back(value);
+        }
+    }
+    void visit(RetInst *ret) override { m_values = {ret->value()}; }
+    void visit(StoreInst *store) override { m_values = {store->ptr(), store->value()}; }
+
+    const std::vector<Value *> &values() const { return m_values; }
+};
+
+} // namespace coel::ir
@@ -8,6 +8,10 @@ namespace coel::ir {
 class StackSlot : public Value, public ListNode {
 public:
     explicit StackSlot(const Type *type);
+
+    // Whether the slot's address is used for anything other than loading from and storing to it, in which case it may
+    // be accessed through another pointer.
+    bool is_address_taken() const;
 };
 
 } // namespace coel::ir
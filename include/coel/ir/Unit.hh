@@ -17,6 +17,8 @@ public:
     auto end() const { return m_functions.end(); }
 
     Function *append_function(std::string name, const Type *return_type, std::span<const Type *> parameters);
+    Function *declare_function(std::string name, const Type *return_type, std::span<const Type *> parameters,
+                               const void *address);
     Function *find_function(std::string_view name);
 };
 
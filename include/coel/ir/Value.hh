@@ -74,6 +74,7 @@ public:
 
     ValueKind kind() const { return m_kind; }
     const Type *type() const { return m_type; }
+    const std::unordered_set<Value *> &users() const { return m_users; }
 };
 
 } // namespace coel::ir
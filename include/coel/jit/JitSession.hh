@@ -0,0 +1,134 @@
+#pragma once
+
+#include <coel/codegen/Context.hh>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace coel::ir {
+
+class Function;
+class Unit;
+
+} // namespace coel::ir
+
+namespace coel::x86 {
+
+class InstStream;
+
+} // namespace coel::x86
+
+namespace coel::jit {
+
+class CodeHeap;
+
+struct JitOptions {
+    // Compile each function on its first call rather than the whole unit up front.
+    bool lazy{false};
+
+    // Compile functions without optimisation first, counting entries and loop back edges, and recompile them with
+    // the optimiser on a background thread once they've been executed tier_up_threshold times.
+    bool tiered{false};
+    std::uint64_t tier_up_threshold{1000};
+    std::chrono::milliseconds tier_up_interval{10};
+    std::function<void(ir::Function &)> optimise{};
+
+    // With tiered, also let a call that spends long in a loop of baseline code carry on in optimised code from the
+    // loop header (on-stack replacement) after osr_threshold back edges.
+    bool osr{false};
+    std::uint32_t osr_threshold{10000};
+};
+
+// Compiles an IR unit to executable memory and hands back pointers to the compiled functions. The session takes over
+// the unit: code generation rewrites the IR in place, so it must not be modified or compiled again afterwards.
+class JitSession {
+    struct LazyStub {
+        JitSession *session;
+        ir::Function *function;
+        std::uint8_t *code;
+        // Whether the function has been compiled for the last time, so its callers don't need to be retargeted again.
+        bool final;
+        // Whether the function is an on-stack replacement variant, which is only called once it's hot.
+        bool osr_variant;
+    };
+
+    struct TierState {
+        // Stand-ins for the functions called by the copy below, keyed by the function they stand in for. They keep the
+        // copy from sharing any values with the unit so that it can be compiled without holding the session lock.
+        std::unordered_map<const ir::Function *, std::unique_ptr<ir::Function>> callees;
+        // Copy of the function from before baseline code generation rewrote it, recompiled when the function is hot.
+        std::unique_ptr<ir::Function> original;
+        std::uint64_t *counter;
+        std::uint8_t *baseline;
+    };
+
+    const JitOptions m_options;
+    codegen::Context m_context;
+    std::unique_ptr<CodeHeap> m_code_heap;
+    mutable std::mutex m_mutex;
+
+    // Current address of every function in the unit, keyed by the function. For a lazily compiled function this is its
+    // stub until it gets compiled.
+    std::unordered_map<const void *, std::uintptr_t> m_symbols;
+    std::unordered_map<std::string_view, const ir::Function *> m_symbol_names;
+
+    std::unordered_map<const ir::Function *, std::unique_ptr<LazyStub>> m_stubs;
+    std::vector<std::unique_ptr<ir::Function>> m_osr_variants;
+    // Call instructions in compiled code that target the keyed function, retargeted whenever it gets (re)compiled.
+    std::unordered_map<const ir::Function *, std::vector<std::uint8_t *>> m_call_sites;
+    std::uint8_t *m_trampoline{nullptr};
+
+    std::unordered_map<const ir::Function *, TierState> m_tiers;
+    // Only used by the tier up thread.
+    codegen::Context m_tier_up_context;
+    std::uint64_t *m_counters{nullptr};
+    std::size_t m_counter_count{0};
+    std::condition_variable m_tier_up_cv;
+    std::thread m_tier_up_thread;
+    bool m_stopping{false};
+
+    std::uint8_t *place(const std::vector<std::uint8_t> &code);
+    std::uint64_t *allocate_counter();
+    void emit_trampoline();
+    void emit_stub(ir::Function *function);
+    std::uint8_t *compile_function(ir::Function &function, std::uint64_t *counter);
+    std::uint8_t *install(const x86::InstStream &insts, const ir::Function &function,
+                          const std::unordered_map<const void *, const ir::Function *> &aliases = {});
+    void retarget(LazyStub *stub, std::uint8_t *entry);
+    std::uint8_t *compile_lazy(LazyStub *stub);
+    void tier_up(const ir::Function *function, TierState &tier, const x86::InstStream &insts);
+    void tier_up_loop();
+    static std::uint8_t *resolve_stub(LazyStub *stub);
+
+public:
+    explicit JitSession(ir::Unit &unit, const JitOptions &options = {});
+    JitSession(const JitSession &) = delete;
+    JitSession(JitSession &&) = delete;
+    ~JitSession();
+
+    JitSession &operator=(const JitSession &) = delete;
+    JitSession &operator=(JitSession &&) = delete;
+
+    void *lookup(const ir::Function *function) const;
+    void *lookup(std::string_view name) const;
+
+    template <typename Signature>
+    Signature *function(const ir::Function *function) const {
+        return reinterpret_cast<Signature *>(lookup(function));
+    }
+
+    template <typename Signature>
+    Signature *function(std::string_view name) const {
+        return reinterpret_cast<Signature *>(lookup(name));
+    }
+};
+
+} // namespace coel::jit
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Replaces binary instructions, compares and loads that compute the same value as an instruction dominating them with
+// that instruction. Values are numbered by opcode and operands while walking the dominator tree, and a load is only
+// reused when nothing can have been stored in between.
+void eliminate_common_subexpressions(ir::Function &function);
+
+} // namespace coel::opt
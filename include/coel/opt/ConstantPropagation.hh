@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Sparse conditional constant propagation. Folds arithmetic and compares whose operands are constant on every path
+// that can actually be taken, and turns conditional branches on a known condition into plain branches. Blocks that are
+// never executed are left without any predecessors for dead code elimination to pick up.
+void propagate_constants(ir::Function &function);
+
+} // namespace coel::opt
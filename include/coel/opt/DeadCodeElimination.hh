@@ -0,0 +1,15 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Removes blocks that can't be reached from the entry, instructions whose results are never used by anything with a
+// side effect, and stack slots that are never loaded from.
+void eliminate_dead_code(ir::Function &function);
+
+} // namespace coel::opt
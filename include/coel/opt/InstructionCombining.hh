@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Simplifies binary instructions and compares using algebraic identities until none apply: constant operands are
+// folded, x + 0 and x - x are removed, chains of adds and subtracts of constants are combined into one, and constants
+// are moved to the right of adds and compares. Adds, subtracts and compares left without users are removed.
+void combine_instructions(ir::Function &function);
+
+} // namespace coel::opt
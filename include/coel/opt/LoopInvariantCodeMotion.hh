@@ -0,0 +1,17 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Moves binary instructions and compares whose operands don't change within a loop, as well as loads from stack slots
+// that aren't stored to in the loop, into the preheader of the loop, inserting preheaders where needed. Stores to
+// stack slots whose address is otherwise unused are sunk into the exit of a loop when the loop only has the one way out
+// and nothing in it loads from the slot.
+void move_loop_invariant_code(ir::Function &function);
+
+} // namespace coel::opt
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Turns loops that test their condition in the header into loops that test it at the bottom, by copying the test into
+// the preheader and the latch, so that each iteration ends with a single conditional branch back to the start of the
+// body. Only headers made up of phis, binary instructions and compares ending in a branch out of the loop are rotated.
+void rotate_loops(ir::Function &function);
+
+} // namespace coel::opt
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Tidies up the control flow graph until nothing changes: blocks are merged into their only predecessor, blocks that
+// only branch on are bypassed, conditional branches whose arms end up at the same place become plain branches, and
+// predecessors that decide the condition of a branch are sent straight to its target. Unreachable blocks are removed.
+void simplify_cfg(ir::Function &function);
+
+} // namespace coel::opt
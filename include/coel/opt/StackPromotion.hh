@@ -0,0 +1,16 @@
+#pragma once
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Promotes the stack slots of a function that are only ever loaded from and stored to into SSA values, placing phis at
+// the iterated dominance frontier of the stores. As with memory, a load that no store reaches gives an unspecified
+// value.
+void promote_stack_slots(ir::Function &function);
+
+} // namespace coel::opt
@@ -30,6 +30,8 @@ public:
     U *emplace(iterator it, Args &&...args);
     void insert(iterator it, T *elem);
     iterator erase(iterator it);
+    // Unlinks an element without destroying it, handing ownership back to the caller.
+    T *extract(iterator it);
 
     iterator begin() const;
     iterator end() const;
@@ -98,14 +100,18 @@ void List<T>::insert(iterator it, T *elem) {
 
 template <std::derived_from<ListNode> T>
 ListIterator<T> List<T>::erase(iterator it) {
+    auto *next = it->next();
+    delete extract(it);
+    return iterator(next);
+}
+
+template <std::derived_from<ListNode> T>
+T *List<T>::extract(iterator it) {
     auto *prev = it->prev();
     auto *next = it->next();
     next->m_prev = prev;
     prev->m_next = next;
-
-    auto ret = it++;
-    delete *it;
-    return ret;
+    return *it;
 }
 
 template <std::derived_from<ListNode> T>
@@ -1,9 +1,13 @@
 #pragma once
 
-#include <coel/x86/MachineInst.hh>
+#include <coel/x86/InstStream.hh>
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachinePasses.hh>
 
 #include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace coel::ir {
@@ -15,8 +19,26 @@ class Unit;
 
 namespace coel::x86 {
 
-std::vector<MachineInst> compile(const ir::Unit &unit);
-std::pair<std::size_t, std::vector<std::uint8_t>> encode(const std::vector<MachineInst> &insts,
-                                                         const ir::Function *entry);
+struct Encoding {
+    std::vector<std::uint8_t> code;
+    std::unordered_map<const void *, std::size_t> label_offsets;
+    // Offsets of call rel32 instructions to external symbols, so that they can be retargeted later.
+    std::vector<std::pair<std::size_t, const void *>> external_calls;
+};
+
+// Selects machine instructions for a function that has been legalised and register allocated. If a counter is given,
+// the function increments it on entry and on every loop back edge.
+MachineFunction select(const ir::Function &function, std::uint64_t *counter = nullptr);
+// Runs the machine passes that compile() applies between instruction selection and encoding.
+void run_machine_passes(MachineFunction &function, MachinePassStats &stats);
+// Appends the blocks of a function to a stream in layout order, each starting with a Lbl pseudo-instruction.
+void flatten(const MachineFunction &function, InstStream &insts);
+
+// Compiles functions through select(), run_machine_passes() and flatten(), adding to the given stats if any.
+InstStream compile(const ir::Unit &unit, MachinePassStats *stats = nullptr);
+InstStream compile(const ir::Function &function, std::uint64_t *counter = nullptr, MachinePassStats *stats = nullptr);
+Encoding encode(const InstStream &insts, std::uintptr_t base,
+                const std::unordered_map<const void *, std::uintptr_t> &symbols);
+std::pair<std::size_t, std::vector<std::uint8_t>> encode(const InstStream &insts, const ir::Function *entry);
 
 } // namespace coel::x86
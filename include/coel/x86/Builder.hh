@@ -15,7 +15,9 @@ class Builder {
 public:
     explicit Builder(MachineInst *inst) : m_inst(inst) {}
 
+    Builder abs(const void *op);
     Builder base_disp(Register base, std::int32_t disp);
+    Builder base_index_disp(Register base, Register index, std::uint8_t scale, std::int32_t disp);
     Builder imm(std::uint64_t op);
     Builder lbl(const void *op);
     Builder off(std::int64_t op);
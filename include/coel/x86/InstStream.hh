@@ -0,0 +1,62 @@
+#pragma once
+
+#include <coel/x86/MachineInst.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coel::x86 {
+
+class InstStreamIterator;
+
+// A sequence of instructions packed into bytes. Each instruction only takes up space for the operands it has, with
+// registers in a single byte and displacements, immediates and offsets in four. Labels, absolute addresses, and
+// immediates and offsets that don't fit in 32 bits go in a side table. Iterating the stream unpacks each instruction.
+class InstStream {
+    friend InstStreamIterator;
+
+    std::vector<std::uint8_t> m_bytes;
+    std::vector<std::uint64_t> m_wide;
+    std::size_t m_size{0};
+
+    void push_index(std::uint64_t value);
+    void push_int32(std::int32_t value);
+
+public:
+    using iterator = InstStreamIterator;
+
+    InstStream() = default;
+    explicit InstStream(const std::vector<MachineInst> &insts);
+
+    void push_back(const MachineInst &inst);
+
+    iterator begin() const;
+    iterator end() const;
+
+    bool empty() const { return m_size == 0; }
+    std::size_t size() const { return m_size; }
+    // Total memory used by the packed instructions and the side table.
+    std::size_t byte_size() const { return m_bytes.size() + m_wide.size() * sizeof(std::uint64_t); }
+};
+
+class InstStreamIterator {
+    const InstStream *m_stream{nullptr};
+    std::size_t m_position{0};
+    std::size_t m_next{0};
+    MachineInst m_inst{};
+
+    void unpack();
+
+public:
+    InstStreamIterator() = default;
+    InstStreamIterator(const InstStream *stream, std::size_t position);
+
+    InstStreamIterator &operator++();
+
+    bool operator==(const InstStreamIterator &other) const { return m_position == other.m_position; }
+    const MachineInst &operator*() const { return m_inst; }
+    const MachineInst *operator->() const { return &m_inst; }
+};
+
+} // namespace coel::x86
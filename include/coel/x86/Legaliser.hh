@@ -6,8 +6,15 @@ class Context;
 
 } // namespace coel::codegen
 
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
 namespace coel::x86 {
 
 void legalise(codegen::Context &context);
+void legalise(codegen::Context &context, ir::Function &function);
 
 } // namespace coel::x86
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <coel/x86/Builder.hh>
+#include <coel/x86/MachineInst.hh>
+
+#include <memory>
+#include <vector>
+
+namespace coel::x86 {
+
+// A straight line run of machine instructions starting at a label. Control leaves a block through the jumps at its end,
+// or otherwise falls through to the next block in the function.
+class MachineBasicBlock {
+    const void *const m_label;
+    std::vector<MachineInst> m_insts;
+
+public:
+    explicit MachineBasicBlock(const void *label) : m_label(label) {}
+    MachineBasicBlock(const MachineBasicBlock &) = delete;
+    MachineBasicBlock(MachineBasicBlock &&) = delete;
+    ~MachineBasicBlock() = default;
+
+    MachineBasicBlock &operator=(const MachineBasicBlock &) = delete;
+    MachineBasicBlock &operator=(MachineBasicBlock &&) = delete;
+
+    Builder append(Opcode opcode);
+
+    const void *label() const { return m_label; }
+    std::vector<MachineInst> &insts() { return m_insts; }
+    const std::vector<MachineInst> &insts() const { return m_insts; }
+};
+
+// The machine code of a function after register allocation, as blocks in layout order. The first block is labelled
+// with the function itself.
+class MachineFunction {
+    std::vector<std::unique_ptr<MachineBasicBlock>> m_blocks;
+
+public:
+    MachineFunction() = default;
+    MachineFunction(const MachineFunction &) = delete;
+    MachineFunction(MachineFunction &&) noexcept = default;
+    ~MachineFunction() = default;
+
+    MachineFunction &operator=(const MachineFunction &) = delete;
+    MachineFunction &operator=(MachineFunction &&) noexcept = default;
+
+    MachineBasicBlock *append_block(const void *label);
+
+    const std::vector<std::unique_ptr<MachineBasicBlock>> &blocks() const { return m_blocks; }
+};
+
+} // namespace coel::x86
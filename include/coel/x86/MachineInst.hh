@@ -11,34 +11,68 @@ namespace coel::x86 {
 enum class Opcode {
     Add,
     Cmp,
+    Dec,
+    Inc,
+    Lea,
     Leave,
     Mov,
+    // Sign and zero extensions from the operand width to 32 bits.
+    Movsx,
+    Movzx,
     Pop,
     Push,
     Ret,
     Sub,
+    Xor,
 
     Call,
+    CallInd,
+    // Conditional jumps, in the same order as their label forms. Jl, Jg, Jle and Jge are signed and Jb, Ja, Jbe and
+    // Jae unsigned.
     Je,
-    Jmp,
     Jne,
+    Jl,
+    Jg,
+    Jle,
+    Jge,
+    Jb,
+    Ja,
+    Jbe,
+    Jae,
+    Jmp,
     Sete,
     Setne,
     Setl,
     Setg,
     Setle,
     Setge,
+    Setb,
+    Seta,
+    Setbe,
+    Setae,
 
     Lbl,
     CallLbl,
     JeLbl,
-    JmpLbl,
     JneLbl,
+    JlLbl,
+    JgLbl,
+    JleLbl,
+    JgeLbl,
+    JbLbl,
+    JaLbl,
+    JbeLbl,
+    JaeLbl,
+    JmpLbl,
 };
 
 enum class OperandType {
     None,
+    // Absolute address of data, encoded rip-relative.
+    Abs,
     BaseDisp,
+    // [base + index * scale + disp], with a scale of 1, 2, 4 or 8.
+    BaseIndexDisp,
     Imm,
     Lbl,
     Off,
@@ -48,9 +82,12 @@ enum class OperandType {
 struct Operand {
     OperandType type;
     union {
+        const void *abs;
         struct {
             std::int32_t disp;
             std::uint8_t base;
+            std::uint8_t index;
+            std::uint8_t scale;
         };
         std::uint64_t imm;
         const void *lbl;
@@ -67,4 +104,13 @@ struct MachineInst {
 
 std::uint8_t encode(const MachineInst &inst, std::span<std::uint8_t, 16> encoded);
 
+// Whether an opcode is a conditional jump, to either an offset or a label.
+bool is_cond_jump(Opcode opcode);
+// Whether an opcode is a jump to a label, conditional or not.
+bool is_label_jump(Opcode opcode);
+// The conditional jump which is taken exactly when the given one isn't, in the same form.
+Opcode invert_cond_jump(Opcode opcode);
+// The jump to an offset that a jump to a label becomes once the label's offset is known.
+Opcode resolve_label_jump(Opcode opcode);
+
 } // namespace coel::x86
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+namespace coel::x86 {
+
+class MachineFunction;
+
+// How many times each rewrite of the machine passes has been applied, to see what they catch.
+struct MachinePassStats {
+    // fold_branches
+    std::size_t jumps_to_next{0};
+    std::size_t inverted_jumps{0};
+
+    // peephole
+    std::size_t self_moves{0};
+    std::size_t zero_moves{0};
+    std::size_t increments{0};
+    std::size_t decrements{0};
+    std::size_t redundant_compares{0};
+    std::size_t three_operand_adds{0};
+};
+
+// Removes jumps to the block that follows, and turns a conditional jump to the following block over an unconditional
+// jump into the inverse conditional jump.
+void fold_branches(MachineFunction &function, MachinePassStats &stats);
+
+// Rewrites instructions into cheaper equivalents: removes mov r, r, turns mov r, 0 into xor r32, r32 and add/sub r, 1
+// into inc/dec r where the flags they'd change aren't read, and removes a cmp r, 0 when only its zero flag is read and
+// the arithmetic instruction that last wrote r already set it. A mov d, a followed by an add d, b or add/sub d, imm
+// becomes lea d, [a + b] or lea d, [a + imm] when the flags aren't read.
+void peephole(MachineFunction &function, MachinePassStats &stats);
+
+} // namespace coel::x86
@@ -1,5 +1,6 @@
 #include "Liveness.hh"
 
+#include <coel/codegen/Register.hh>
 #include <coel/ir/BasicBlock.hh>
 #include <coel/ir/Function.hh>
 #include <coel/ir/InstVisitor.hh>
@@ -8,105 +9,97 @@
 
 namespace coel::codegen {
 
-Liveness::Liveness(ir::Function &function, const Graph<ir::BasicBlock> &cfg) : m_cfg(&cfg) {
-    for (const auto &argument : function.arguments()) {
-        COEL_ASSERT(!m_def_map.contains(&argument));
-        m_def_map.emplace(&argument, cfg.entry());
-    }
-    for (auto *block : function) {
-        m_block = block;
-        for (auto *inst : *block) {
-            m_inst = inst;
-            inst->accept(this);
-        }
-    }
-}
-
-void Liveness::visit_def(const ir::Value *value) {
-    COEL_ASSERT(!m_def_map.contains(value));
-    m_def_map.emplace(value, m_block);
+RegisterOperands::RegisterOperands(ir::Instruction *inst) {
+    inst->accept(this);
 }
 
-void Liveness::visit_use(const ir::Value *value) {
-    if (value->kind() == ir::ValueKind::Constant) {
-        return;
-    }
-    if (const auto *reg = value->as<Register>()) {
-        if (reg->physical()) {
-            return;
-        }
-    }
-    auto *def_block = m_def_map.at(value);
-    std::vector<ir::BasicBlock *> work_queue;
-    work_queue.push_back(m_block);
-    while (!work_queue.empty()) {
-        auto *block = work_queue.back();
-        work_queue.pop_back();
-        auto begin = block->begin();
-        auto end = block->end();
-        if (block == def_block) {
-            // TODO: Properly.
-        }
-        if (block == m_block) {
-            end = block->iterator(m_inst);
-            ++end;
-        }
-        for (auto it = end;; --it) {
-            if (it == block->end()) {
-                continue;
-            }
-            m_live_map[*it][value] = true;
-            if (it == begin) {
-                break;
-            }
-        }
-        if (block == def_block) {
-            break;
-        }
-        for (auto *pred : m_cfg->preds(block)) {
-            work_queue.push_back(pred);
-        }
+void RegisterOperands::use(ir::Value *value) {
+    if (auto *reg = value->as<Register>()) {
+        m_uses.push_back(reg);
     }
 }
 
-bool Liveness::live_at(const ir::Value *value, const ir::Instruction *point) {
-    return m_live_map[point][value];
+void RegisterOperands::visit(ir::BinaryInst *binary) {
+    // Two-address: the result is written back to the lhs.
+    use(binary->lhs());
+    use(binary->rhs());
+    m_defs.push_back(binary->lhs()->as_non_null<Register>());
 }
 
-void Liveness::visit(ir::BinaryInst *binary) {
-    visit_def(binary);
-    visit_use(binary->lhs());
-    visit_use(binary->rhs());
+void RegisterOperands::visit(ir::CompareInst *compare) {
+    use(compare->lhs());
+    use(compare->rhs());
+    // A compare that's still used after legalisation is fused with its branch and only sets the flags.
+    if (compare->users().empty()) {
+        m_defs.push_back(compare->lhs()->as_non_null<Register>());
+    }
 }
 
-void Liveness::visit(ir::CallInst *call) {
-    visit_def(call);
-    for (auto *arg : call->args()) {
-        visit_use(arg);
-    }
+void RegisterOperands::visit(ir::CondBranchInst *cond_branch) {
+    use(cond_branch->cond());
 }
 
-void Liveness::visit(ir::CompareInst *compare) {
-    visit_def(compare);
-    visit_use(compare->lhs());
-    visit_use(compare->rhs());
+void RegisterOperands::visit(ir::CopyInst *copy) {
+    use(copy->src());
+    m_defs.push_back(copy->dst());
 }
 
-void Liveness::visit(ir::CondBranchInst *cond_branch) {
-    visit_use(cond_branch->cond());
+void RegisterOperands::visit(ir::PhiInst *) {
+    // Phis are lowered to copies before register allocation.
+    COEL_ENSURE_NOT_REACHED();
 }
 
-void Liveness::visit(ir::CopyInst *copy) {
-    visit_def(copy->dst());
-    visit_use(copy->src());
+void RegisterOperands::visit(ir::RetInst *ret) {
+    use(ret->value());
 }
 
-void Liveness::visit(ir::LoadInst *load) {
-    visit_def(load);
+void RegisterOperands::visit(ir::StoreInst *store) {
+    use(store->value());
 }
 
-void Liveness::visit(ir::RetInst *ret) {
-    visit_use(ret->value());
+Liveness::Liveness(ir::Function &function, const Graph<ir::BasicBlock> &cfg) {
+    // Registers read before being written in each block, and registers written in each block.
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<Register *>> gen;
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<Register *>> kill;
+    for (auto *block : function) {
+        auto &block_gen = gen[block];
+        auto &block_kill = kill[block];
+        for (auto *inst : *block) {
+            RegisterOperands operands(inst);
+            for (auto *reg : operands.uses()) {
+                if (!reg->physical() && !block_kill.contains(reg)) {
+                    block_gen.insert(reg);
+                }
+            }
+            for (auto *reg : operands.defs()) {
+                if (!reg->physical()) {
+                    block_kill.insert(reg);
+                }
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto *block : function) {
+            auto &live_out = m_live_out[block];
+            for (auto *succ : cfg.succs(block)) {
+                for (auto *reg : m_live_in[succ]) {
+                    live_out.insert(reg);
+                }
+            }
+            auto &live_in = m_live_in[block];
+            const auto size = live_in.size();
+            live_in.insert(gen[block].begin(), gen[block].end());
+            for (auto *reg : live_out) {
+                if (!kill[block].contains(reg)) {
+                    live_in.insert(reg);
+                }
+            }
+            changed |= live_in.size() != size;
+        }
+    }
 }
 
 } // namespace coel::codegen
@@ -4,6 +4,8 @@
 #include <coel/ir/InstVisitor.hh>
 
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace coel::ir {
 
@@ -16,29 +18,44 @@ class Value;
 
 namespace coel::codegen {
 
-class Liveness final : public ir::InstVisitor {
-    const Graph<ir::BasicBlock> *const m_cfg;
-    ir::BasicBlock *m_block{nullptr};
-    ir::Instruction *m_inst{nullptr};
-    std::unordered_map<const ir::Value *, ir::BasicBlock *> m_def_map;
-    std::unordered_map<const ir::Instruction *, std::unordered_map<const ir::Value *, bool>> m_live_map;
+class Register;
 
-    void visit_def(const ir::Value *);
-    void visit_use(const ir::Value *);
+// The registers read and written by a legalised instruction. Calls aren't modelled here since their arguments and
+// result are passed through copies to and from physical registers.
+class RegisterOperands final : public ir::InstVisitor {
+    std::vector<Register *> m_uses;
+    std::vector<Register *> m_defs;
+
+    void use(ir::Value *value);
 
 public:
-    Liveness(ir::Function &function, const Graph<ir::BasicBlock> &cfg);
+    explicit RegisterOperands(ir::Instruction *inst);
 
-    bool live_at(const ir::Value *value, const ir::Instruction *point);
     void visit(ir::BinaryInst *) override;
     void visit(ir::BranchInst *) override {}
-    void visit(ir::CallInst *) override;
+    void visit(ir::CallInst *) override {}
     void visit(ir::CompareInst *) override;
     void visit(ir::CondBranchInst *) override;
     void visit(ir::CopyInst *) override;
-    void visit(ir::LoadInst *) override;
+    void visit(ir::LoadInst *) override {}
+    void visit(ir::PhiInst *) override;
     void visit(ir::RetInst *) override;
-    void visit(ir::StoreInst *) override {}
+    void visit(ir::StoreInst *) override;
+
+    const std::vector<Register *> &uses() const { return m_uses; }
+    const std::vector<Register *> &defs() const { return m_defs; }
+};
+
+// Block level liveness of virtual registers.
+class Liveness {
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<Register *>> m_live_in;
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<Register *>> m_live_out;
+
+public:
+    Liveness(ir::Function &function, const Graph<ir::BasicBlock> &cfg);
+
+    const std::unordered_set<Register *> &live_in(const ir::BasicBlock *block) { return m_live_in[block]; }
+    const std::unordered_set<Register *> &live_out(const ir::BasicBlock *block) { return m_live_out[block]; }
 };
 
 } // namespace coel::codegen
@@ -0,0 +1,66 @@
+#include <coel/codegen/PhiLowering.hh>
+
+#include <coel/codegen/Context.hh>
+#include <coel/codegen/Register.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Unit.hh>
+
+#include <utility>
+#include <vector>
+
+namespace coel::codegen {
+
+void lower_phis(Context &context) {
+    for (auto *function : context.unit()) {
+        lower_phis(context, *function);
+    }
+}
+
+void lower_phis(Context &context, ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    ir::split_critical_edges(function);
+    for (auto *block : function) {
+        std::vector<ir::PhiInst *> phis;
+        for (auto *inst : *block) {
+            if (auto *phi = inst->as<ir::PhiInst>()) {
+                phis.push_back(phi);
+            }
+        }
+
+        // Each phi gets copied through a register of its own that's written at the end of every predecessor and only
+        // read on entry to the block, so the copies for all of the phis of the block behave as if done at once even
+        // when one phi reads another. A predecessor that doesn't end in a plain branch must be the only predecessor of
+        // the block after edge splitting, so its copy can go at the start of the block instead, which keeps it clear of
+        // a compare feeding the branch.
+        std::vector<std::pair<Register *, ir::Value *>> entry_copies;
+        std::vector<std::pair<Register *, Register *>> result_copies;
+        for (auto *phi : phis) {
+            auto *incoming_reg = context.create_virtual(phi->type());
+            auto *result_reg = context.create_virtual(phi->type());
+            for (auto [pred, value] : phi->incoming()) {
+                auto *terminator = pred->terminator();
+                if (terminator->is<ir::BranchInst>()) {
+                    pred->insert<ir::CopyInst>(terminator, incoming_reg, value);
+                } else {
+                    entry_copies.emplace_back(incoming_reg, value);
+                }
+            }
+            result_copies.emplace_back(result_reg, incoming_reg);
+            phi->replace_all_uses_with(result_reg);
+            block->remove(phi);
+        }
+        for (auto it = result_copies.rbegin(); it != result_copies.rend(); ++it) {
+            block->prepend<ir::CopyInst>(it->first, it->second);
+        }
+        for (auto it = entry_copies.rbegin(); it != entry_copies.rend(); ++it) {
+            block->prepend<ir::CopyInst>(it->first, it->second);
+        }
+    }
+}
+
+} // namespace coel::codegen
@@ -4,88 +4,104 @@
 
 #include <coel/codegen/Context.hh>
 #include <coel/codegen/Register.hh>
-#include <coel/graph/DominanceComputer.hh>
-#include <coel/graph/DominatorTree.hh>
 #include <coel/graph/Graph.hh>
+#include <coel/ir/BasicBlock.hh>
 #include <coel/ir/Function.hh>
-#include <coel/ir/InstVisitor.hh>
 #include <coel/ir/Instructions.hh>
 #include <coel/ir/Unit.hh>
 #include <coel/support/Assert.hh>
 #include <coel/x86/Register.hh>
 
-#include <memory>
+#include <algorithm>
+#include <array>
 #include <unordered_map>
 #include <vector>
 
 namespace coel::codegen {
 namespace {
 
-class RegisterAllocator final : public ir::InstVisitor {
-    Context &m_context;
-    const ir::Instruction *m_inst{nullptr};
-    std::unique_ptr<Liveness> m_liveness;
-    std::unordered_map<std::size_t, ir::Value *> m_matrix;
-    std::vector<std::size_t> m_phys_regs;
+// Caller-saved registers come first so that callee-saved ones, which need saving in the prologue, are only used for
+// values that live across calls.
+constexpr std::array k_allocation_order{
+    x86::Register::rax, x86::Register::rcx, x86::Register::rdx, x86::Register::rsi, x86::Register::rdi,
+    x86::Register::r8,  x86::Register::r9,  x86::Register::r10, x86::Register::r11, x86::Register::rbx,
+    x86::Register::r12, x86::Register::r13, x86::Register::r14, x86::Register::r15,
+};
 
-public:
-    explicit RegisterAllocator(Context &context);
+constexpr std::array k_caller_saved{
+    x86::Register::rax, x86::Register::rcx, x86::Register::rdx, x86::Register::rsi, x86::Register::rdi,
+    x86::Register::r8,  x86::Register::r9,  x86::Register::r10, x86::Register::r11,
+};
+
+// TODO: Assuming target/ABI registers.
+constexpr std::array k_argument_registers{
+    x86::Register::rdi, x86::Register::rsi, x86::Register::rdx,
+    x86::Register::rcx, x86::Register::r8,  x86::Register::r9,
+};
+
+// Instructions are numbered in layout order. A value is read at 2 * index and written at 2 * index + 1, so that a
+// value last read by an instruction doesn't interfere with one written by it.
+struct Range {
+    std::size_t start;
+    std::size_t end;
+
+    bool overlaps(const Range &other) const { return start <= other.end && other.start <= end; }
+};
+
+struct Interval {
+    Register *reg;
+    Range range;
+    // Physical register or register of another value that would make a copy redundant.
+    std::size_t hint_phys{SIZE_MAX};
+    Register *hint_reg{nullptr};
+};
+
+class RegisterAllocator {
+    std::unordered_map<Register *, Interval> m_intervals;
+    std::unordered_map<std::size_t, std::vector<Range>> m_fixed;
+
+    void add_fixed_def(std::size_t phys, std::size_t position);
+    void add_fixed_use(std::size_t phys, std::size_t position);
+    void extend(Register *reg, std::size_t position);
+    bool is_free(std::size_t phys, const Range &range, const std::vector<Interval *> &active) const;
 
-    void allocate(Register *virt);
+public:
     void run(ir::Function *function);
-    void visit(ir::BinaryInst *) override;
-    void visit(ir::BranchInst *) override {}
-    void visit(ir::CallInst *) override {}
-    void visit(ir::CompareInst *) override;
-    void visit(ir::CondBranchInst *) override;
-    void visit(ir::CopyInst *) override;
-    void visit(ir::LoadInst *) override {}
-    void visit(ir::RetInst *) override;
-    void visit(ir::StoreInst *) override {}
 };
 
-RegisterAllocator::RegisterAllocator(Context &context) : m_context(context) {
-    m_phys_regs.push_back(x86::Register::rsi);
-    m_phys_regs.push_back(x86::Register::rdi);
-    m_phys_regs.push_back(x86::Register::rax);
-    m_phys_regs.push_back(x86::Register::rcx);
-    m_phys_regs.push_back(x86::Register::rdx);
-    m_phys_regs.push_back(x86::Register::r8);
-    m_phys_regs.push_back(x86::Register::r9);
-    m_phys_regs.push_back(x86::Register::r10);
-    m_phys_regs.push_back(x86::Register::r11);
-
-    // TODO: Allow use of these and preserve them if used.
-    // m_phys_regs.push_back(x86::Register::rbx);
-    // m_phys_regs.push_back(x86::Register::r12);
-    // m_phys_regs.push_back(x86::Register::r13);
-    // m_phys_regs.push_back(x86::Register::r14);
-    // m_phys_regs.push_back(x86::Register::r15);
+void RegisterAllocator::add_fixed_def(std::size_t phys, std::size_t position) {
+    m_fixed[phys].push_back({position, position});
 }
 
-void RegisterAllocator::allocate(Register *virt) {
-    if (virt->physical()) {
+void RegisterAllocator::add_fixed_use(std::size_t phys, std::size_t position) {
+    auto &ranges = m_fixed[phys];
+    if (ranges.empty()) {
+        // Argument registers are defined on entry.
+        ranges.push_back({0, position});
         return;
     }
-    for (std::size_t phys : m_phys_regs) {
-        if (m_matrix[phys] == nullptr) {
-            continue;
-        }
-        bool live = m_liveness->live_at(m_matrix[phys], m_inst);
-        if (!live) {
-            m_matrix[phys] = nullptr;
+    ranges.back().end = std::max(ranges.back().end, position);
+}
+
+void RegisterAllocator::extend(Register *reg, std::size_t position) {
+    auto [it, inserted] = m_intervals.try_emplace(reg, Interval{reg, {position, position}});
+    auto &range = it->second.range;
+    range.start = std::min(range.start, position);
+    range.end = std::max(range.end, position);
+}
+
+bool RegisterAllocator::is_free(std::size_t phys, const Range &range, const std::vector<Interval *> &active) const {
+    for (const auto *interval : active) {
+        if (interval->reg->reg() == phys) {
+            return false;
         }
     }
-    for (std::size_t phys : m_phys_regs) {
-        if (m_matrix[phys] != nullptr) {
-            continue;
-        }
-        virt->set_reg(phys);
-        virt->set_physical(true);
-        m_matrix[phys] = virt;
-        return;
+    if (auto it = m_fixed.find(phys); it != m_fixed.end()) {
+        return std::none_of(it->second.begin(), it->second.end(), [&](const Range &fixed) {
+            return fixed.overlaps(range);
+        });
     }
-    COEL_ENSURE_NOT_REACHED("Ran out of registers");
+    return true;
 }
 
 void RegisterAllocator::run(ir::Function *function) {
@@ -100,57 +116,86 @@ void RegisterAllocator::run(ir::Function *function) {
             }
         }
     }
-    m_liveness = std::make_unique<Liveness>(*function, cfg);
-
-    // TODO: Assuming target/ABI registers.
-    std::array argument_registers{7, 6, 2, 1, 8, 9};
-    for (std::size_t i = 0; i < function->arguments().size(); i++) {
-        auto *argument = function->argument(i);
-        argument->replace_all_uses_with(m_context.create_physical(argument->type(), argument_registers[i]));
-        m_matrix[argument_registers[i]] = argument;
-    }
+    Liveness liveness(*function, cfg);
 
-    auto dom_tree = cfg.run<DominanceComputer>();
-    auto dom_dfs = dom_tree.run<DepthFirstSearch>();
-    for (auto *block : dom_dfs.pre_order()) {
+    // Build a single live range per virtual register over the linear instruction order, and ranges in which physical
+    // registers are reserved for argument passing, return values and call clobbers.
+    std::size_t index = 0;
+    for (auto *block : *function) {
+        const auto block_start = index;
+        for (auto *reg : liveness.live_in(block)) {
+            extend(reg, block_start * 2);
+        }
         for (auto *inst : *block) {
-            m_inst = inst;
-            inst->accept(this);
+            if (auto *call = inst->as<ir::CallInst>()) {
+                for (std::size_t i = 0; i < call->args().size(); i++) {
+                    add_fixed_use(k_argument_registers[i], index * 2);
+                }
+                for (auto phys : k_caller_saved) {
+                    add_fixed_def(phys, index * 2 + 1);
+                }
+            }
+            RegisterOperands operands(inst);
+            for (auto *reg : operands.uses()) {
+                if (reg->physical()) {
+                    add_fixed_use(reg->reg(), index * 2);
+                } else {
+                    extend(reg, index * 2);
+                }
+            }
+            for (auto *reg : operands.defs()) {
+                if (reg->physical()) {
+                    add_fixed_def(reg->reg(), index * 2 + 1);
+                } else {
+                    extend(reg, index * 2 + 1);
+                }
+            }
+            if (auto *copy = inst->as<ir::CopyInst>()) {
+                auto *src = copy->src()->as<Register>();
+                if (src != nullptr && src->physical() && !copy->dst()->physical()) {
+                    m_intervals.at(copy->dst()).hint_phys = src->reg();
+                } else if (src != nullptr && !src->physical() && copy->dst()->physical()) {
+                    m_intervals.at(src).hint_phys = copy->dst()->reg();
+                } else if (src != nullptr && !src->physical()) {
+                    m_intervals.at(copy->dst()).hint_reg = src;
+                }
+            }
+            index++;
         }
+        for (auto *reg : liveness.live_out(block)) {
+            extend(reg, index * 2 - 1);
+        }
+        COEL_ASSERT(index != block_start);
     }
-}
-
-void RegisterAllocator::visit(ir::BinaryInst *binary) {
-    if (auto *reg = binary->lhs()->as<Register>()) {
-        allocate(reg);
-    }
-    if (auto *reg = binary->rhs()->as<Register>()) {
-        allocate(reg);
-    }
-}
-
-void RegisterAllocator::visit(ir::CompareInst *compare) {
-    if (auto *reg = compare->lhs()->as<Register>()) {
-        allocate(reg);
-    }
-    if (auto *reg = compare->rhs()->as<Register>()) {
-        allocate(reg);
-    }
-}
 
-void RegisterAllocator::visit(ir::CondBranchInst *cond_branch) {
-    if (auto *reg = cond_branch->cond()->as<Register>()) {
-        allocate(reg);
+    // Linear scan over the intervals in order of their start.
+    std::vector<Interval *> intervals;
+    for (auto &[reg, interval] : m_intervals) {
+        intervals.push_back(&interval);
     }
-}
-
-void RegisterAllocator::visit(ir::CopyInst *copy) {
-    allocate(copy->dst());
-}
-
-void RegisterAllocator::visit(ir::RetInst *ret) {
-    if (auto *reg = ret->value()->as<Register>()) {
-        allocate(reg);
+    std::sort(intervals.begin(), intervals.end(), [](Interval *lhs, Interval *rhs) {
+        return lhs->range.start < rhs->range.start;
+    });
+    std::vector<Interval *> active;
+    for (auto *interval : intervals) {
+        std::erase_if(active, [&](Interval *other) {
+            return other->range.end < interval->range.start;
+        });
+        std::vector<std::size_t> candidates;
+        if (interval->hint_phys != SIZE_MAX) {
+            candidates.push_back(interval->hint_phys);
+        }
+        if (interval->hint_reg != nullptr && interval->hint_reg->physical()) {
+            candidates.push_back(interval->hint_reg->reg());
+        }
+        candidates.insert(candidates.end(), k_allocation_order.begin(), k_allocation_order.end());
+        auto it = std::find_if(candidates.begin(), candidates.end(), [&](std::size_t phys) {
+            return is_free(phys, interval->range, active);
+        });
+        COEL_ENSURE(it != candidates.end(), "Ran out of registers");
+        interval->reg->set_reg(*it);
+        interval->reg->set_physical(true);
+        active.push_back(interval);
     }
 }
 
@@ -158,9 +203,15 @@ void RegisterAllocator::visit(ir::RetInst *ret) {
 
 void register_allocate(Context &context) {
     for (auto *function : context.unit()) {
-        RegisterAllocator allocator(context);
-        allocator.run(function);
+        if (!function->is_external()) {
+            register_allocate(context, *function);
+        }
     }
 }
 
+void register_allocate(Context &, ir::Function &function) {
+    RegisterAllocator allocator;
+    allocator.run(&function);
+}
+
 } // namespace coel::codegen
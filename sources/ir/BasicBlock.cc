@@ -1,11 +1,27 @@
 #include <coel/ir/BasicBlock.hh>
 
 #include <coel/ir/Instruction.hh>
+#include <coel/support/Assert.hh>
 
 namespace coel::ir {
 
 BasicBlock::~BasicBlock() = default;
 
+void BasicBlock::remove(Instruction *inst) {
+    COEL_ASSERT(inst->users().empty());
+    m_instructions.erase(iterator(inst));
+}
+
+void BasicBlock::splice(BasicBlock *other) {
+    while (!other->empty()) {
+        m_instructions.insert(end(), other->m_instructions.extract(other->begin()));
+    }
+}
+
+void BasicBlock::transfer(Instruction *inst, BasicBlock *block, Instruction *position) {
+    block->m_instructions.insert(iterator(position), m_instructions.extract(iterator(inst)));
+}
+
 bool BasicBlock::empty() const {
     return m_instructions.empty();
 }
@@ -17,4 +33,9 @@ bool BasicBlock::has_terminator() const {
     return (--end())->is_terminator();
 }
 
+Instruction *BasicBlock::terminator() const {
+    COEL_ASSERT(has_terminator());
+    return *--end();
+}
+
 } // namespace coel::ir
@@ -0,0 +1,179 @@
+#include <coel/ir/Cloner.hh>
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/InstVisitor.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/support/Assert.hh>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace coel::ir {
+namespace {
+
+class Cloner final : public InstVisitor {
+    Function *const m_clone;
+    BasicBlock *m_block{nullptr};
+    std::unordered_map<const Value *, Value *> &m_value_map;
+    std::vector<Instruction *> m_insts;
+    // Instructions that were used before being cloned themselves, i.e. defined in a later block.
+    std::unordered_set<Value *> m_forward_refs;
+
+    Value *map(Value *value);
+    BasicBlock *map(const BasicBlock *block);
+    template <std::derived_from<Instruction> Inst, typename... Args>
+    void append(Instruction *original, Args &&...args);
+
+public:
+    Cloner(Function *clone, std::unordered_map<const Value *, Value *> &value_map)
+        : m_clone(clone), m_value_map(value_map) {}
+
+    void run(const Function &function, const std::vector<const BasicBlock *> &blocks);
+    void visit(BinaryInst *) override;
+    void visit(BranchInst *) override;
+    void visit(CallInst *) override;
+    void visit(CompareInst *) override;
+    void visit(CondBranchInst *) override;
+    void visit(CopyInst *) override;
+    void visit(LoadInst *) override;
+    void visit(PhiInst *) override;
+    void visit(RetInst *) override;
+    void visit(StoreInst *) override;
+};
+
+Value *Cloner::map(Value *value) {
+    if (auto it = m_value_map.find(value); it != m_value_map.end()) {
+        return it->second;
+    }
+    if (auto *constant = value->as<Constant>()) {
+        return Constant::get(constant->type(), constant->value());
+    }
+    if (value->is<Instruction>()) {
+        // Temporarily use the original and patch it up once it has been cloned.
+        m_forward_refs.insert(value);
+    }
+    // Callees are shared with the original function.
+    return value;
+}
+
+BasicBlock *Cloner::map(const BasicBlock *block) {
+    return m_value_map.at(block)->as_non_null<BasicBlock>();
+}
+
+template <std::derived_from<Instruction> Inst, typename... Args>
+void Cloner::append(Instruction *original, Args &&...args) {
+    auto *inst = m_block->append<Inst>(std::forward<Args>(args)...);
+    m_value_map.emplace(original, inst);
+    m_insts.push_back(inst);
+}
+
+void Cloner::run(const Function &function, const std::vector<const BasicBlock *> &blocks) {
+    for (const auto *stack_slot : function.stack_slots()) {
+        if (!m_value_map.contains(stack_slot)) {
+            const auto *type = stack_slot->type()->as_non_null<PointerType>()->pointee_type();
+            m_value_map.emplace(stack_slot, m_clone->append_stack_slot(type));
+        }
+    }
+    for (const auto *block : blocks) {
+        m_value_map.emplace(block, m_clone->append_block());
+    }
+    for (const auto *block : blocks) {
+        m_block = map(block);
+        for (auto *inst : *block) {
+            inst->accept(this);
+        }
+    }
+    for (auto *original : m_forward_refs) {
+        auto *repl = m_value_map.at(original);
+        for (auto *inst : m_insts) {
+            inst->replace_uses_of_with(original, repl);
+        }
+    }
+}
+
+void Cloner::visit(BinaryInst *binary) {
+    append<BinaryInst>(binary, binary->op(), map(binary->lhs()), map(binary->rhs()));
+}
+
+void Cloner::visit(BranchInst *branch) {
+    append<BranchInst>(branch, map(branch->dst()));
+}
+
+void Cloner::visit(CallInst *call) {
+    std::vector<Value *> args;
+    for (auto *arg : call->args()) {
+        args.push_back(map(arg));
+    }
+    append<CallInst>(call, map(call->callee()), std::move(args));
+}
+
+void Cloner::visit(CompareInst *compare) {
+    append<CompareInst>(compare, compare->op(), map(compare->lhs()), map(compare->rhs()));
+}
+
+void Cloner::visit(CondBranchInst *cond_branch) {
+    append<CondBranchInst>(cond_branch, map(cond_branch->cond()), map(cond_branch->true_dst()),
+                           map(cond_branch->false_dst()));
+}
+
+void Cloner::visit(CopyInst *) {
+    // Copies only exist after legalisation, at which point the function has been rewritten in terms of registers.
+    COEL_ENSURE_NOT_REACHED();
+}
+
+void Cloner::visit(LoadInst *load) {
+    append<LoadInst>(load, map(load->ptr()));
+}
+
+void Cloner::visit(PhiInst *phi) {
+    append<PhiInst>(phi, phi->type());
+    auto *clone = m_value_map.at(phi)->as_non_null<PhiInst>();
+    for (auto [block, value] : phi->incoming()) {
+        if (m_value_map.contains(block)) {
+            clone->add_incoming(map(block), map(value));
+        }
+    }
+}
+
+void Cloner::visit(RetInst *ret) {
+    append<RetInst>(ret, map(ret->value()));
+}
+
+void Cloner::visit(StoreInst *store) {
+    append<StoreInst>(store, map(store->ptr()), map(store->value()));
+}
+
+} // namespace
+
+std::unique_ptr<Function> clone(const Function &function) {
+    COEL_ASSERT(!function.is_external());
+    std::vector<const Type *> parameters;
+    for (const auto &argument : function.arguments()) {
+        parameters.push_back(argument.type());
+    }
+    auto clone = std::make_unique<Function>(std::string(function.name()), function.type(), parameters);
+    std::unordered_map<const Value *, Value *> value_map;
+    for (std::size_t i = 0; i < function.arguments().size(); i++) {
+        value_map.emplace(function.argument(i), clone->argument(i));
+    }
+    std::vector<const BasicBlock *> blocks;
+    for (const auto *block : function) {
+        blocks.push_back(block);
+    }
+    clone_into(function, blocks, *clone, value_map);
+    return clone;
+}
+
+void clone_into(const Function &function, const std::vector<const BasicBlock *> &blocks, Function &target,
+                std::unordered_map<const Value *, Value *> &value_map) {
+    COEL_ASSERT(!function.is_external());
+    Cloner cloner(&target, value_map);
+    cloner.run(function, blocks);
+}
+
+} // namespace coel::ir
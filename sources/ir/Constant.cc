@@ -1,16 +1,19 @@
 #include <coel/ir/Constant.hh>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace coel::ir {
 namespace {
 
+std::mutex s_constants_mutex;
 std::vector<std::unique_ptr<ir::Constant>> s_constants;
 
 } // namespace
 
 Constant *Constant::get(const Type *type, std::size_t value) {
+    std::scoped_lock lock(s_constants_mutex);
     return s_constants.emplace_back(new Constant(type, value)).get();
 }
 
@@ -0,0 +1,142 @@
+#include <coel/ir/ControlFlow.hh>
+
+#include <coel/graph/DepthFirstSearch.hh>
+#include <coel/graph/LoopFinder.hh>
+#include <coel/graph/LoopInfo.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+
+#include <unordered_set>
+#include <utility>
+
+namespace coel::ir {
+
+std::vector<BasicBlock *> successors(BasicBlock *block) {
+    if (!block->has_terminator()) {
+        return {};
+    }
+    auto *terminator = block->terminator();
+    if (auto *branch = terminator->as<BranchInst>()) {
+        return {branch->dst()};
+    }
+    if (auto *cond_branch = terminator->as<CondBranchInst>()) {
+        return {cond_branch->true_dst(), cond_branch->false_dst()};
+    }
+    return {};
+}
+
+Graph<BasicBlock> build_cfg(Function &function) {
+    Graph<BasicBlock> cfg(*function.begin());
+    for (auto *block : function) {
+        for (auto *succ : successors(block)) {
+            cfg.connect(block, succ);
+        }
+    }
+    return cfg;
+}
+
+void split_critical_edges(Function &function) {
+    const auto cfg = build_cfg(function);
+    std::vector<std::pair<BasicBlock *, BasicBlock *>> critical_edges;
+    for (auto *block : function) {
+        const auto &succs = cfg.succs(block);
+        if (succs.size() < 2) {
+            continue;
+        }
+        for (auto *succ : succs) {
+            if (cfg.preds(succ).size() > 1) {
+                critical_edges.emplace_back(block, succ);
+            }
+        }
+    }
+
+    for (auto [pred, succ] : critical_edges) {
+        auto *split = function.insert_block(++ListIterator<BasicBlock>(pred));
+        split->append<BranchInst>(succ);
+        pred->terminator()->replace_uses_of_with(succ, split);
+        for (auto *inst : *succ) {
+            if (auto *phi = inst->as<PhiInst>()) {
+                auto *value = phi->incoming_value(pred);
+                phi->remove_incoming(pred);
+                phi->add_incoming(split, value);
+            }
+        }
+    }
+}
+
+void insert_loop_preheaders(Function &function) {
+    const auto cfg = build_cfg(function);
+    const auto loops = cfg.run<LoopFinder>();
+    for (const auto &loop : loops.loops()) {
+        auto *header = loop->header();
+        std::vector<BasicBlock *> outside_preds;
+        for (auto *pred : cfg.preds(header)) {
+            if (!loop->contains(pred)) {
+                outside_preds.push_back(pred);
+            }
+        }
+        if (loop->preheader() != nullptr || outside_preds.empty()) {
+            continue;
+        }
+
+        auto *preheader = function.insert_block(ListIterator<BasicBlock>(header));
+        for (auto *inst : *header) {
+            auto *phi = inst->as<PhiInst>();
+            if (phi == nullptr) {
+                break;
+            }
+            Value *value = phi->incoming_value(outside_preds[0]);
+            if (outside_preds.size() > 1) {
+                auto *merged = preheader->append<PhiInst>(phi->type());
+                for (auto *pred : outside_preds) {
+                    merged->add_incoming(pred, phi->incoming_value(pred));
+                }
+                value = merged;
+            }
+            for (auto *pred : outside_preds) {
+                phi->remove_incoming(pred);
+            }
+            phi->add_incoming(preheader, value);
+        }
+        preheader->append<BranchInst>(header);
+        for (auto *pred : outside_preds) {
+            pred->terminator()->replace_uses_of_with(header, preheader);
+        }
+    }
+}
+
+void remove_unreachable_blocks(Function &function) {
+    const auto cfg = build_cfg(function);
+    const auto reachable = cfg.run<DepthFirstSearch>().pre_order();
+    const std::unordered_set<const BasicBlock *> reachable_set(reachable.begin(), reachable.end());
+    std::vector<BasicBlock *> unreachable;
+    for (auto *block : function) {
+        if (!reachable_set.contains(block)) {
+            unreachable.push_back(block);
+        }
+    }
+
+    // Take the edges out of the unreachable blocks from any phis first. Everything else that uses the blocks or the
+    // values defined in them is unreachable too, so the uses can simply be dropped.
+    for (auto *block : unreachable) {
+        for (auto *succ : cfg.succs(block)) {
+            for (auto *inst : *succ) {
+                if (auto *phi = inst->as<PhiInst>(); phi != nullptr && phi->incoming_value(block) != nullptr) {
+                    phi->remove_incoming(block);
+                }
+            }
+        }
+    }
+    for (auto *block : unreachable) {
+        block->replace_all_uses_with(nullptr);
+        for (auto *inst : *block) {
+            inst->replace_all_uses_with(nullptr);
+        }
+    }
+    for (auto *block : unreachable) {
+        function.remove_block(block);
+    }
+}
+
+} // namespace coel::ir
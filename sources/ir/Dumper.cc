@@ -11,6 +11,7 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 
@@ -28,6 +29,7 @@ class Dumper final : public InstVisitor {
 public:
     explicit Dumper(const Function *function) : m_function(function) {}
 
+    void number_values();
     void dump(BasicBlock &block);
     void dump_stack_slots();
     void visit(BinaryInst *) override;
@@ -37,6 +39,7 @@ public:
     void visit(CondBranchInst *) override;
     void visit(CopyInst *) override;
     void visit(LoadInst *) override;
+    void visit(PhiInst *) override;
     void visit(RetInst *) override;
     void visit(StoreInst *) override;
 };
@@ -84,14 +87,24 @@ std::string Dumper::value_string(Value *value) {
     return fmt::format("{} %v{}", type_string(value->type()), m_value_map.at(value));
 }
 
+// Values are numbered up front since phis can refer to values defined further down.
+void Dumper::number_values() {
+    for (auto *block : *m_function) {
+        for (auto *inst : *block) {
+            if (!inst->is_terminator() && !inst->is<CopyInst>() && !inst->is<StoreInst>()) {
+                COEL_ASSERT(!m_value_map.contains(inst));
+                m_value_map.emplace(inst, m_value_map.size());
+            }
+        }
+    }
+}
+
 void Dumper::dump(BasicBlock &block) {
     fmt::print("  {} {{\n", value_string(&block));
     for (auto *inst : block) {
         fmt::print("    ");
-        if (!inst->is_terminator() && !inst->is<CopyInst>() && !inst->is<StoreInst>()) {
-            COEL_ASSERT(!m_value_map.contains(inst));
-            fmt::print("%v{} = ", m_value_map.size());
-            m_value_map.emplace(inst, m_value_map.size());
+        if (auto it = m_value_map.find(inst); it != m_value_map.end()) {
+            fmt::print("%v{} = ", it->second);
         }
         inst->accept(this);
         fmt::print("\n");
@@ -152,6 +165,14 @@ void Dumper::visit(CompareInst *compare) {
             return "cmp_le"sv;
         case CompareOp::Ge:
             return "cmp_ge"sv;
+        case CompareOp::ULt:
+            return "cmp_ult"sv;
+        case CompareOp::UGt:
+            return "cmp_ugt"sv;
+        case CompareOp::ULe:
+            return "cmp_ule"sv;
+        case CompareOp::UGe:
+            return "cmp_uge"sv;
         }
     };
     fmt::print("{} {}, {}", op_string(compare->op()), value_string(compare->lhs()), value_string(compare->rhs()));
@@ -170,6 +191,14 @@ void Dumper::visit(LoadInst *load) {
     fmt::print("load {}", value_string(load->ptr()));
 }
 
+void Dumper::visit(PhiInst *phi) {
+    fmt::print("phi");
+    for (bool first = true; auto [block, value] : phi->incoming()) {
+        fmt::print("{} [{}, {}]", first ? "" : ",", value_string(block), value_string(value));
+        first = false;
+    }
+}
+
 void Dumper::visit(RetInst *ret) {
     fmt::print("ret {}", value_string(ret->value()));
 }
@@ -190,8 +219,14 @@ void dump(Unit &unit) {
             }
             fmt::print("%a{}: {}", i, type_string(function->argument(i)->type()));
         }
-        fmt::print("): {} {{\n", type_string(function->type()));
+        fmt::print("): {}", type_string(function->type()));
+        if (function->is_external()) {
+            fmt::print(" = extern {}\n", function->address());
+            continue;
+        }
+        fmt::print(" {{\n");
         dumper.dump_stack_slots();
+        dumper.number_values();
         for (auto *block : *function) {
             dumper.dump(*block);
         }
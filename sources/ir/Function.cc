@@ -1,20 +1,39 @@
 #include <coel/ir/Function.hh>
 
+#include <coel/support/Assert.hh>
+
 namespace coel::ir {
 
-Function::Function(std::string &&name, const Type *return_type, std::span<const Type *> parameters)
-    : Value(ValueKind::Function, return_type), m_name(std::move(name)) {
+Function::Function(std::string &&name, const Type *return_type, std::span<const Type *> parameters,
+                   const void *address)
+    : Value(ValueKind::Function, return_type), m_name(std::move(name)), m_address(address) {
     for (const auto *parameter : parameters) {
         m_arguments.emplace_back(parameter);
     }
 }
 
 BasicBlock *Function::append_block() {
+    COEL_ASSERT(!is_external());
     return m_blocks.emplace<BasicBlock>(m_blocks.end());
 }
 
+BasicBlock *Function::insert_block(ListIterator<BasicBlock> position) {
+    COEL_ASSERT(!is_external());
+    return m_blocks.emplace<BasicBlock>(position);
+}
+
+void Function::remove_block(BasicBlock *block) {
+    COEL_ASSERT(block->users().empty());
+    m_blocks.erase(ListIterator<BasicBlock>(block));
+}
+
 StackSlot *Function::append_stack_slot(const Type *type) {
     return m_stack_slots.emplace<StackSlot>(m_stack_slots.end(), type);
 }
 
+void Function::remove_stack_slot(StackSlot *stack_slot) {
+    COEL_ASSERT(stack_slot->users().empty());
+    m_stack_slots.erase(ListIterator<StackSlot>(stack_slot));
+}
+
 } // namespace coel::ir
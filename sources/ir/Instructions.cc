@@ -5,19 +5,24 @@
 #include <coel/ir/Types.hh>
 #include <coel/support/Assert.hh>
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace coel::ir {
 
 BinaryInst::BinaryInst(BinaryOp op, Value *lhs, Value *rhs)
     : Instruction(Opcode::Binary, lhs->type()), m_op(op), m_lhs(lhs), m_rhs(rhs) {
     lhs->add_user(this);
-    rhs->add_user(this);
+    if (rhs != lhs) {
+        rhs->add_user(this);
+    }
 }
 
 BinaryInst::~BinaryInst() {
     if (m_lhs != nullptr) {
         m_lhs->remove_user(this);
     }
-    if (m_rhs != nullptr) {
+    if (m_rhs != nullptr && m_rhs != m_lhs) {
         m_rhs->remove_user(this);
     }
 }
@@ -26,28 +31,28 @@ void BinaryInst::accept(InstVisitor *visitor) {
     visitor->visit(this);
 }
 
+// Both operands can be the same value, in which case the instruction is only registered as a user of it once.
 void BinaryInst::replace_uses_of_with(Value *orig, Value *repl) {
-    if (m_lhs == orig) {
-        m_lhs->remove_user(this);
-        m_lhs = repl;
-        if (m_lhs != nullptr) {
-            m_lhs->add_user(this);
-        }
+    if (m_lhs != orig && m_rhs != orig) {
+        return;
     }
-    if (m_rhs == orig) {
-        m_rhs->remove_user(this);
-        m_rhs = repl;
-        if (m_rhs != nullptr) {
-            m_rhs->add_user(this);
-        }
+    orig->remove_user(this);
+    m_lhs = m_lhs == orig ? repl : m_lhs;
+    m_rhs = m_rhs == orig ? repl : m_rhs;
+    if (repl != nullptr && !repl->users().contains(this)) {
+        repl->add_user(this);
     }
 }
 
 void BinaryInst::set_lhs(Value *lhs) {
     COEL_ASSERT(lhs != nullptr);
-    m_lhs->remove_user(this);
+    if (m_lhs != m_rhs) {
+        m_lhs->remove_user(this);
+    }
     m_lhs = lhs;
-    m_lhs->add_user(this);
+    if (m_lhs != m_rhs) {
+        m_lhs->add_user(this);
+    }
 }
 
 BranchInst::BranchInst(BasicBlock *dst) : Instruction(Opcode::Branch, nullptr), m_dst(dst) {
@@ -67,7 +72,7 @@ void BranchInst::accept(InstVisitor *visitor) {
 void BranchInst::replace_uses_of_with(Value *orig, Value *repl) {
     if (m_dst == orig) {
         m_dst->remove_user(this);
-        m_dst = repl->as_non_null<BasicBlock>();
+        m_dst = repl != nullptr ? repl->as_non_null<BasicBlock>() : nullptr;
         if (m_dst != nullptr) {
             m_dst->add_user(this);
         }
@@ -78,18 +83,18 @@ CallInst::CallInst(Value *callee, std::vector<Value *> &&args)
     : Instruction(Opcode::Call, callee->type()), m_callee(callee), m_args(std::move(args)) {
     callee->add_user(this);
     for (auto *arg : m_args) {
-        arg->add_user(this);
+        if (!arg->users().contains(this)) {
+            arg->add_user(this);
+        }
     }
 }
 
 CallInst::~CallInst() {
-    if (m_callee != nullptr) {
-        m_callee->remove_user(this);
-    }
-    for (auto *arg : m_args) {
-        if (arg != nullptr) {
-            arg->remove_user(this);
-        }
+    std::unordered_set<Value *> used(m_args.begin(), m_args.end());
+    used.insert(m_callee);
+    used.erase(nullptr);
+    for (auto *value : used) {
+        value->remove_user(this);
     }
 }
 
@@ -105,28 +110,30 @@ void CallInst::replace_uses_of_with(Value *orig, Value *repl) {
             m_callee->add_user(this);
         }
     }
-    for (auto *&arg : m_args) {
-        if (arg == orig) {
-            arg->remove_user(this);
-            arg = repl;
-            if (arg != nullptr) {
-                arg->add_user(this);
-            }
-        }
+    if (std::find(m_args.begin(), m_args.end(), orig) == m_args.end()) {
+        return;
+    }
+    // The same value can be passed several times, but the call is only registered as a user of it once.
+    orig->remove_user(this);
+    std::replace(m_args.begin(), m_args.end(), orig, repl);
+    if (repl != nullptr && !repl->users().contains(this)) {
+        repl->add_user(this);
     }
 }
 
 CompareInst::CompareInst(CompareOp op, Value *lhs, Value *rhs)
     : Instruction(Opcode::Compare, BoolType::get()), m_op(op), m_lhs(lhs), m_rhs(rhs) {
     lhs->add_user(this);
-    rhs->add_user(this);
+    if (rhs != lhs) {
+        rhs->add_user(this);
+    }
 }
 
 CompareInst::~CompareInst() {
     if (m_lhs != nullptr) {
         m_lhs->remove_user(this);
     }
-    if (m_rhs != nullptr) {
+    if (m_rhs != nullptr && m_rhs != m_lhs) {
         m_rhs->remove_user(this);
     }
 }
@@ -135,28 +142,28 @@ void CompareInst::accept(InstVisitor *visitor) {
     visitor->visit(this);
 }
 
+// Both operands can be the same value, in which case the instruction is only registered as a user of it once.
 void CompareInst::replace_uses_of_with(Value *orig, Value *repl) {
-    if (m_lhs == orig) {
-        m_lhs->remove_user(this);
-        m_lhs = repl;
-        if (m_lhs != nullptr) {
-            m_lhs->add_user(this);
-        }
+    if (m_lhs != orig && m_rhs != orig) {
+        return;
     }
-    if (m_rhs == orig) {
-        m_rhs->remove_user(this);
-        m_rhs = repl;
-        if (m_rhs != nullptr) {
-            m_rhs->add_user(this);
-        }
+    orig->remove_user(this);
+    m_lhs = m_lhs == orig ? repl : m_lhs;
+    m_rhs = m_rhs == orig ? repl : m_rhs;
+    if (repl != nullptr && !repl->users().contains(this)) {
+        repl->add_user(this);
     }
 }
 
 void CompareInst::set_lhs(Value *lhs) {
     COEL_ASSERT(lhs != nullptr);
-    m_lhs->remove_user(this);
+    if (m_lhs != m_rhs) {
+        m_lhs->remove_user(this);
+    }
     m_lhs = lhs;
-    m_lhs->add_user(this);
+    if (m_lhs != m_rhs) {
+        m_lhs->add_user(this);
+    }
 }
 
 CondBranchInst::CondBranchInst(Value *cond, BasicBlock *true_dst, BasicBlock *false_dst)
@@ -170,8 +177,12 @@ CondBranchInst::~CondBranchInst() {
     if (m_cond != nullptr) {
         m_cond->remove_user(this);
     }
-    m_true_dst->remove_user(this);
-    m_false_dst->remove_user(this);
+    if (m_true_dst != nullptr) {
+        m_true_dst->remove_user(this);
+    }
+    if (m_false_dst != nullptr) {
+        m_false_dst->remove_user(this);
+    }
 }
 
 void CondBranchInst::accept(InstVisitor *visitor) {
@@ -179,8 +190,6 @@ void CondBranchInst::accept(InstVisitor *visitor) {
 }
 
 void CondBranchInst::replace_uses_of_with(Value *orig, Value *repl) {
-    COEL_ASSERT(orig != m_true_dst);
-    COEL_ASSERT(orig != m_false_dst);
     if (m_cond == orig) {
         m_cond->remove_user(this);
         m_cond = repl;
@@ -188,6 +197,20 @@ void CondBranchInst::replace_uses_of_with(Value *orig, Value *repl) {
             m_cond->add_user(this);
         }
     }
+    if (m_true_dst == orig) {
+        m_true_dst->remove_user(this);
+        m_true_dst = repl != nullptr ? repl->as_non_null<BasicBlock>() : nullptr;
+        if (m_true_dst != nullptr) {
+            m_true_dst->add_user(this);
+        }
+    }
+    if (m_false_dst == orig) {
+        m_false_dst->remove_user(this);
+        m_false_dst = repl != nullptr ? repl->as_non_null<BasicBlock>() : nullptr;
+        if (m_false_dst != nullptr) {
+            m_false_dst->add_user(this);
+        }
+    }
 }
 
 void CondBranchInst::set_cond(Value *cond) {
@@ -247,6 +270,82 @@ void LoadInst::replace_uses_of_with(Value *orig, Value *repl) {
     }
 }
 
+PhiInst::PhiInst(const Type *type) : Instruction(Opcode::Phi, type) {}
+
+PhiInst::~PhiInst() {
+    std::unordered_set<Value *> used;
+    for (auto [block, value] : m_incoming) {
+        used.insert(block);
+        used.insert(value);
+    }
+    used.erase(nullptr);
+    for (auto *value : used) {
+        value->remove_user(this);
+    }
+}
+
+// A value can come in from several predecessors, but the phi is only registered as a user of it once.
+bool PhiInst::uses(const Value *value) const {
+    return std::any_of(m_incoming.begin(), m_incoming.end(), [value](const auto &incoming) {
+        return incoming.first == value || incoming.second == value;
+    });
+}
+
+void PhiInst::accept(InstVisitor *visitor) {
+    visitor->visit(this);
+}
+
+void PhiInst::replace_uses_of_with(Value *orig, Value *repl) {
+    if (!uses(orig)) {
+        return;
+    }
+    for (auto &[block, value] : m_incoming) {
+        if (block == orig) {
+            block = repl != nullptr ? repl->as_non_null<BasicBlock>() : nullptr;
+        }
+        if (value == orig) {
+            value = repl;
+        }
+    }
+    orig->remove_user(this);
+    if (repl != nullptr && !repl->users().contains(this)) {
+        repl->add_user(this);
+    }
+}
+
+void PhiInst::add_incoming(BasicBlock *block, Value *value) {
+    COEL_ASSERT(incoming_value(block) == nullptr);
+    for (auto *used : {static_cast<Value *>(block), value}) {
+        if (!uses(used)) {
+            used->add_user(this);
+        }
+    }
+    m_incoming.emplace_back(block, value);
+}
+
+void PhiInst::remove_incoming(BasicBlock *block) {
+    auto it = std::find_if(m_incoming.begin(), m_incoming.end(), [block](const auto &incoming) {
+        return incoming.first == block;
+    });
+    COEL_ASSERT(it != m_incoming.end());
+    auto *value = it->second;
+    m_incoming.erase(it);
+    for (auto *used : {static_cast<Value *>(block), value}) {
+        if (!uses(used)) {
+            used->remove_user(this);
+        }
+    }
+}
+
+Value *PhiInst::incoming_value(const BasicBlock *block) const {
+    for (auto [incoming_block, value] : m_incoming) {
+        if (incoming_block == block) {
+            return value;
+        }
+    }
+    return nullptr;
+}
+
 RetInst::RetInst(Value *value) : Instruction(Opcode::Ret, nullptr), m_value(value) {
     value->add_user(this);
 }
@@ -1,9 +1,22 @@
 #include <coel/ir/StackSlot.hh>
 
+#include <coel/ir/Instructions.hh>
 #include <coel/ir/Types.hh>
 
+#include <algorithm>
+
 namespace coel::ir {
 
 StackSlot::StackSlot(const Type *type) : Value(ValueKind::StackSlot, PointerType::get(type)) {}
 
+bool StackSlot::is_address_taken() const {
+    return std::any_of(users().begin(), users().end(), [this](Value *user) {
+        if (user->is<LoadInst>()) {
+            return false;
+        }
+        auto *store = user->as<StoreInst>();
+        return store == nullptr || store->value() == this;
+    });
+}
+
 } // namespace coel::ir
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace coel::ir {
@@ -12,6 +13,7 @@ const IntegerType s_int8_type(8);
 const IntegerType s_int16_type(16);
 const IntegerType s_int32_type(32);
 const IntegerType s_int64_type(64);
+std::mutex s_pointer_types_mutex;
 std::vector<std::unique_ptr<ir::PointerType>> s_pointer_types;
 
 } // namespace
@@ -38,6 +40,7 @@ const IntegerType *IntegerType::get(unsigned int bit_width) {
 }
 
 const PointerType *PointerType::get(const Type *pointee_type) {
+    std::scoped_lock lock(s_pointer_types_mutex);
     return s_pointer_types.emplace_back(new PointerType(pointee_type)).get();
 }
 
@@ -0,0 +1,34 @@
+#include "CodeHeap.hh"
+
+#include <coel/support/Assert.hh>
+
+#include <sys/mman.h>
+
+namespace coel::jit {
+
+CodeHeap::CodeHeap(std::size_t capacity) : m_capacity(capacity) {
+    // Reserve the whole heap up front so that everything allocated from it stays within rel32 range of each other.
+    // NOLINTNEXTLINE
+    void *base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    COEL_ENSURE(base != MAP_FAILED, "Failed to map code heap");
+    m_base = static_cast<std::uint8_t *>(base);
+}
+
+CodeHeap::~CodeHeap() {
+    munmap(m_base, m_capacity);
+}
+
+std::uint8_t *CodeHeap::allocate(std::size_t size, std::size_t alignment) {
+    auto *allocation = next_allocation(alignment);
+    COEL_ENSURE(allocation + size <= m_base + m_capacity, "Code heap exhausted");
+    m_size = allocation + size - m_base;
+    return allocation;
+}
+
+std::uint8_t *CodeHeap::next_allocation(std::size_t alignment) const {
+    COEL_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    return m_base + ((m_size + alignment - 1) & ~(alignment - 1));
+}
+
+} // namespace coel::jit
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace coel::jit {
+
+class CodeHeap {
+    std::uint8_t *m_base{nullptr};
+    const std::size_t m_capacity;
+    std::size_t m_size{0};
+
+public:
+    explicit CodeHeap(std::size_t capacity);
+    CodeHeap(const CodeHeap &) = delete;
+    CodeHeap(CodeHeap &&) = delete;
+    ~CodeHeap();
+
+    CodeHeap &operator=(const CodeHeap &) = delete;
+    CodeHeap &operator=(CodeHeap &&) = delete;
+
+    std::uint8_t *allocate(std::size_t size, std::size_t alignment);
+    std::uint8_t *next_allocation(std::size_t alignment) const;
+
+    std::uint8_t *base() const { return m_base; }
+    std::size_t capacity() const { return m_capacity; }
+    std::size_t size() const { return m_size; }
+};
+
+} // namespace coel::jit
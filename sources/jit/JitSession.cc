@@ -0,0 +1,379 @@
+#include <coel/jit/JitSession.hh>
+
+#include "CodeHeap.hh"
+#include "Osr.hh"
+
+#include <coel/codegen/PhiLowering.hh>
+#include <coel/codegen/RegisterAllocator.hh>
+#include <coel/ir/Cloner.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/support/Assert.hh>
+#include <coel/x86/Backend.hh>
+#include <coel/x86/Builder.hh>
+#include <coel/x86/InstStream.hh>
+#include <coel/x86/Legaliser.hh>
+#include <coel/x86/MachineInst.hh>
+#include <coel/x86/Register.hh>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coel::jit {
+namespace {
+
+constexpr std::size_t k_code_heap_capacity = 64ul * 1024 * 1024;
+constexpr std::size_t k_code_alignment = 16;
+
+constexpr std::size_t k_counter_page_size = 4096;
+
+// movabs r11, imm64; jmp rel32; int3
+constexpr std::size_t k_stub_size = 16;
+
+// Registers which may hold arguments on entry to a stub and so must be preserved across compilation.
+constexpr std::array k_argument_registers{
+    x86::Register::rdi, x86::Register::rsi, x86::Register::rdx,
+    x86::Register::rcx, x86::Register::r8,  x86::Register::r9,
+};
+
+std::int32_t rel32(const std::uint8_t *target, const std::uint8_t *next_inst) {
+    auto offset = target - next_inst;
+    COEL_ASSERT(offset >= INT32_MIN && offset <= INT32_MAX);
+    return static_cast<std::int32_t>(offset);
+}
+
+// Replaces the (up to eight) bytes at the given address with a single store, so that a thread concurrently executing
+// the surrounding code sees either the old or the new instruction. The bytes must lie within one aligned qword.
+void patch_atomically(std::uint8_t *address, const void *bytes, std::size_t size) {
+    auto *qword = reinterpret_cast<std::uint64_t *>(reinterpret_cast<std::uintptr_t>(address) & ~std::uintptr_t(7));
+    const auto offset = static_cast<std::size_t>(address - reinterpret_cast<std::uint8_t *>(qword));
+    COEL_ASSERT(offset + size <= sizeof(std::uint64_t));
+    std::atomic_ref<std::uint64_t> ref(*qword);
+    auto value = ref.load(std::memory_order_relaxed);
+    std::memcpy(reinterpret_cast<std::uint8_t *>(&value) + offset, bytes, size);
+    ref.store(value, std::memory_order_release);
+}
+
+bool within_qword(const std::uint8_t *address, std::size_t size) {
+    return (reinterpret_cast<std::uintptr_t>(address) & 7u) + size <= 8;
+}
+
+void patch_jmp(std::uint8_t *address, const std::uint8_t *target) {
+    std::array<std::uint8_t, 5> jmp{0xe9}; // jmp rel32
+    const auto offset = rel32(target, address + jmp.size());
+    std::memcpy(jmp.data() + 1, &offset, sizeof(offset));
+    patch_atomically(address, jmp.data(), jmp.size());
+}
+
+} // namespace
+
+JitSession::JitSession(ir::Unit &unit, const JitOptions &options)
+    : m_options(options), m_context(unit), m_code_heap(std::make_unique<CodeHeap>(k_code_heap_capacity)),
+      m_tier_up_context(unit) {
+    // External functions resolve to their host address.
+    for (auto *function : unit) {
+        m_symbol_names.emplace(function->name(), function);
+        if (function->is_external()) {
+            m_symbols.emplace(function, reinterpret_cast<std::uintptr_t>(function->address()));
+        }
+    }
+
+    // Tiered compilation goes through stubs even when not lazy so that callers can be retargeted to the optimised code.
+    if (options.lazy || options.tiered) {
+        emit_trampoline();
+        for (auto *function : unit) {
+            if (!function->is_external()) {
+                emit_stub(function);
+            }
+        }
+        if (options.tiered) {
+            for (const auto *function : unit) {
+                if (!options.lazy && !function->is_external()) {
+                    compile_lazy(m_stubs.at(function).get());
+                }
+            }
+            m_tier_up_thread = std::thread(&JitSession::tier_up_loop, this);
+        }
+        return;
+    }
+
+    codegen::lower_phis(m_context);
+    x86::legalise(m_context);
+    codegen::register_allocate(m_context);
+    auto insts = x86::compile(unit);
+
+    // Encode against the address the code is going to be placed at so that calls to external functions can be
+    // resolved.
+    auto *code = m_code_heap->next_allocation(k_code_alignment);
+    auto encoding = x86::encode(insts, reinterpret_cast<std::uintptr_t>(code), m_symbols);
+    place(encoding.code);
+    for (const auto *function : unit) {
+        if (!function->is_external()) {
+            m_symbols.emplace(function, reinterpret_cast<std::uintptr_t>(code + encoding.label_offsets.at(function)));
+        }
+    }
+}
+
+JitSession::~JitSession() {
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopping = true;
+    }
+    m_tier_up_cv.notify_all();
+    if (m_tier_up_thread.joinable()) {
+        m_tier_up_thread.join();
+    }
+}
+
+std::uint8_t *JitSession::place(const std::vector<std::uint8_t> &code) {
+    auto *allocation = m_code_heap->allocate(code.size(), k_code_alignment);
+    std::copy(code.begin(), code.end(), allocation);
+    return allocation;
+}
+
+std::uint64_t *JitSession::allocate_counter() {
+    // Counters get pages of their own so that the stores to them aren't treated as self-modifying code, but are still
+    // allocated from the code heap to keep them within rip-relative range.
+    if (m_counters == nullptr || m_counter_count == k_counter_page_size / sizeof(std::uint64_t)) {
+        m_counters = reinterpret_cast<std::uint64_t *>(m_code_heap->allocate(k_counter_page_size, k_counter_page_size));
+        m_counter_count = 0;
+    }
+    return &m_counters[m_counter_count++];
+}
+
+void JitSession::emit_trampoline() {
+    // Entered from a stub with the stub's LazyStub in r11 and the arguments to the function still in place. Compiles
+    // the function and tail jumps to it. The stack is 16-byte aligned at the call after the six pushes and padding.
+    std::vector<x86::MachineInst> insts;
+    auto emit = [&](x86::Opcode opcode) {
+        auto &inst = insts.emplace_back();
+        inst.opcode = opcode;
+        return x86::Builder(&inst);
+    };
+    for (auto reg : k_argument_registers) {
+        emit(x86::Opcode::Push).reg(reg).width(64);
+    }
+    emit(x86::Opcode::Sub).reg(x86::Register::rsp).imm(8).width(64);
+    emit(x86::Opcode::Mov).reg(x86::Register::rdi).reg(x86::Register::r11).width(64);
+    emit(x86::Opcode::CallLbl).lbl(reinterpret_cast<const void *>(&resolve_stub));
+    emit(x86::Opcode::Mov).reg(x86::Register::r11).reg(x86::Register::rax).width(64);
+    emit(x86::Opcode::Add).reg(x86::Register::rsp).imm(8).width(64);
+    for (auto it = k_argument_registers.rbegin(); it != k_argument_registers.rend(); ++it) {
+        emit(x86::Opcode::Pop).reg(*it).width(64);
+    }
+    emit(x86::Opcode::Jmp).reg(x86::Register::r11).width(64);
+
+    auto *code = m_code_heap->next_allocation(k_code_alignment);
+    auto encoding = x86::encode(x86::InstStream(insts), reinterpret_cast<std::uintptr_t>(code),
+                                {{reinterpret_cast<const void *>(&resolve_stub),
+                                  reinterpret_cast<std::uintptr_t>(&resolve_stub)}});
+    m_trampoline = place(encoding.code);
+    COEL_ASSERT(m_trampoline == code);
+}
+
+void JitSession::emit_stub(ir::Function *function) {
+    auto &stub = m_stubs[function];
+    stub = std::make_unique<LazyStub>(LazyStub{this, function, nullptr, false, false});
+    auto *code = m_code_heap->allocate(k_stub_size, k_code_alignment);
+    const auto stub_address = reinterpret_cast<std::uintptr_t>(stub.get());
+    code[0] = 0x49; // REX.W + REX.B
+    code[1] = 0xbb; // mov r11, imm64
+    std::memcpy(code + 2, &stub_address, sizeof(stub_address));
+    code[10] = 0xe9; // jmp rel32
+    const auto offset = rel32(m_trampoline, code + 15);
+    std::memcpy(code + 11, &offset, sizeof(offset));
+    code[15] = 0xcc; // int3
+    stub->code = code;
+    m_symbols.emplace(function, reinterpret_cast<std::uintptr_t>(code));
+}
+
+std::uint8_t *JitSession::compile_function(ir::Function &function, std::uint64_t *counter) {
+    codegen::lower_phis(m_context, function);
+    x86::legalise(m_context, function);
+    codegen::register_allocate(m_context, function);
+    return install(x86::compile(function, counter), function);
+}
+
+std::uint8_t *JitSession::install(const x86::InstStream &insts, const ir::Function &function,
+                                  const std::unordered_map<const void *, const ir::Function *> &aliases) {
+    // Calls to an alias go to wherever the function it stands in for currently is.
+    std::unordered_map<const void *, std::uintptr_t> aliased_symbols;
+    if (!aliases.empty()) {
+        aliased_symbols = m_symbols;
+        for (auto [alias, original] : aliases) {
+            aliased_symbols.emplace(alias, m_symbols.at(original));
+        }
+    }
+    auto *code = m_code_heap->next_allocation(k_code_alignment);
+    auto encoding = x86::encode(insts, reinterpret_cast<std::uintptr_t>(code),
+                                aliases.empty() ? m_symbols : aliased_symbols);
+    place(encoding.code);
+
+    // Remember the calls which go to functions that are yet to be compiled (again) so that they can be pointed at the
+    // new code later on.
+    for (auto [offset, symbol] : encoding.external_calls) {
+        auto alias = aliases.find(symbol);
+        auto it = m_stubs.find(alias != aliases.end() ? alias->second : static_cast<const ir::Function *>(symbol));
+        if (it != m_stubs.end() && !it->second->final) {
+            m_call_sites[it->first].push_back(code + offset);
+        }
+    }
+    return code + encoding.label_offsets.at(&function);
+}
+
+void JitSession::retarget(LazyStub *stub, std::uint8_t *entry) {
+    // Redirect the stub to the new code by overwriting its first instruction with a jmp rel32, and then patch the calls
+    // that are known to go to the function. Call sites whose rel32 straddles a qword boundary can't be patched
+    // atomically and are left going through the stub or the previous code.
+    patch_jmp(stub->code, entry);
+    if (auto it = m_call_sites.find(stub->function); it != m_call_sites.end()) {
+        for (auto *call : it->second) {
+            const auto call_offset = rel32(entry, call + 5);
+            if (within_qword(call + 1, sizeof(call_offset))) {
+                patch_atomically(call + 1, &call_offset, sizeof(call_offset));
+            }
+        }
+        if (stub->final) {
+            m_call_sites.erase(it);
+        }
+    }
+    m_symbols[stub->function] = reinterpret_cast<std::uintptr_t>(entry);
+}
+
+std::uint8_t *JitSession::compile_lazy(LazyStub *stub) {
+    std::scoped_lock lock(m_mutex);
+    auto *function = stub->function;
+    const auto current = m_symbols.at(function);
+    if (current != reinterpret_cast<std::uintptr_t>(stub->code)) {
+        // Another thread got here first.
+        return reinterpret_cast<std::uint8_t *>(current);
+    }
+
+    if (stub->osr_variant) {
+        // Variants are only called from loops that are already hot, so they go straight to optimised code.
+        if (m_options.optimise) {
+            m_options.optimise(*function);
+        }
+        stub->final = true;
+        auto *entry = compile_function(*function, nullptr);
+        retarget(stub, entry);
+        return entry;
+    }
+
+    std::uint64_t *counter = nullptr;
+    if (m_options.tiered) {
+        auto &tier = m_tiers[function];
+        tier.original = ir::clone(*function);
+        tier.counter = counter = allocate_counter();
+        for (auto *block : *tier.original) {
+            for (auto *inst : *block) {
+                auto *call = inst->as<ir::CallInst>();
+                if (call == nullptr) {
+                    continue;
+                }
+                const auto *callee = call->callee()->as_non_null<ir::Function>();
+                auto &proxy = tier.callees[callee];
+                if (!proxy) {
+                    std::vector<const ir::Type *> parameters;
+                    for (const auto &argument : callee->arguments()) {
+                        parameters.push_back(argument.type());
+                    }
+                    proxy = std::make_unique<ir::Function>(std::string(callee->name()), callee->type(), parameters);
+                }
+                call->replace_uses_of_with(call->callee(), proxy.get());
+            }
+        }
+        if (m_options.osr) {
+            for (auto &variant : insert_osr_entries(*function, m_options.osr_threshold)) {
+                emit_stub(variant.get());
+                m_stubs.at(variant.get())->osr_variant = true;
+                m_osr_variants.push_back(std::move(variant));
+            }
+        }
+    }
+    stub->final = !m_options.tiered;
+    auto *entry = compile_function(*function, counter);
+    if (m_options.tiered) {
+        m_tiers.at(function).baseline = entry;
+    }
+    retarget(stub, entry);
+    return entry;
+}
+
+void JitSession::tier_up(const ir::Function *function, TierState &tier, const x86::InstStream &insts) {
+    auto *stub = m_stubs.at(function).get();
+    stub->final = true;
+    std::unordered_map<const void *, const ir::Function *> aliases;
+    for (const auto &[callee, proxy] : tier.callees) {
+        aliases.emplace(proxy.get(), callee);
+    }
+    auto *entry = install(insts, *tier.original, aliases);
+
+    // Threads already running the baseline code carry on there, but any new calls to it jump straight to the new code.
+    // The baseline code starts with the counter increment, so no thread can be midway through the patched bytes.
+    patch_jmp(tier.baseline, entry);
+    retarget(stub, entry);
+}
+
+void JitSession::tier_up_loop() {
+    std::unique_lock lock(m_mutex);
+    while (!m_tier_up_cv.wait_for(lock, m_options.tier_up_interval, [this] {
+        return m_stopping;
+    })) {
+        // Take the hot functions out of the session. Their copies share no values with the unit, so they can be
+        // optimised and compiled without the lock, which is only needed again to place and link the code.
+        std::vector<std::pair<const ir::Function *, TierState>> hot;
+        for (auto it = m_tiers.begin(); it != m_tiers.end();) {
+            if (std::atomic_ref(*it->second.counter).load(std::memory_order_relaxed) >= m_options.tier_up_threshold) {
+                hot.emplace_back(it->first, std::move(it->second));
+                it = m_tiers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (hot.empty()) {
+            continue;
+        }
+
+        lock.unlock();
+        std::vector<x86::InstStream> compiled;
+        for (auto &[function, tier] : hot) {
+            if (m_options.optimise) {
+                m_options.optimise(*tier.original);
+            }
+            codegen::lower_phis(m_tier_up_context, *tier.original);
+            x86::legalise(m_tier_up_context, *tier.original);
+            codegen::register_allocate(m_tier_up_context, *tier.original);
+            compiled.push_back(x86::compile(*tier.original));
+        }
+        lock.lock();
+        for (std::size_t i = 0; i < hot.size(); i++) {
+            tier_up(hot[i].first, hot[i].second, compiled[i]);
+        }
+    }
+}
+
+std::uint8_t *JitSession::resolve_stub(LazyStub *stub) {
+    return stub->session->compile_lazy(stub);
+}
+
+void *JitSession::lookup(const ir::Function *function) const {
+    std::scoped_lock lock(m_mutex);
+    auto it = m_symbols.find(function);
+    return it != m_symbols.end() ? reinterpret_cast<void *>(it->second) : nullptr;
+}
+
+void *JitSession::lookup(std::string_view name) const {
+    auto it = m_symbol_names.find(name);
+    return it != m_symbol_names.end() ? lookup(it->second) : nullptr;
+}
+
+} // namespace coel::jit
@@ -0,0 +1,250 @@
+#include "Osr.hh"
+
+#include <coel/graph/DepthFirstSearch.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Cloner.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Operands.hh>
+#include <coel/ir/Types.hh>
+#include <coel/support/Assert.hh>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace coel::jit {
+namespace {
+
+// TODO: Assuming target/ABI registers.
+constexpr std::size_t k_max_arguments = 6;
+
+struct Loop {
+    ir::BasicBlock *header;
+    // Sources of the back edges to the header.
+    std::vector<ir::BasicBlock *> latches{};
+    // Blocks reachable from the header, in layout order.
+    std::vector<const ir::BasicBlock *> blocks{};
+    // Values live into the header that get passed to the variant. Loads are done again in the variant instead, since
+    // the backend reads a load's stack slot at each of its uses anyway.
+    std::vector<ir::Value *> live_values{};
+    std::vector<ir::LoadInst *> live_loads{};
+    // The header's phis, whose values along the back edge get passed to the variant after the live values.
+    std::vector<ir::PhiInst *> header_phis{};
+};
+
+bool is_variable(const ir::Value *value) {
+    return value->is<ir::Argument>() || value->is<ir::Instruction>();
+}
+
+// Returns the instructions and arguments that are live on entry to the header, in the order they're defined in. A
+// phi uses its incoming values at the end of the blocks they come in from, so values merged in from outside of the
+// blocks aren't included.
+std::vector<ir::Value *> live_into(ir::Function &function, const Graph<ir::BasicBlock> &cfg,
+                                   const std::vector<ir::BasicBlock *> &blocks, const ir::BasicBlock *header) {
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<ir::Value *>> gen;
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<ir::Value *>> kill;
+    std::vector<std::pair<ir::BasicBlock *, ir::Value *>> phi_uses;
+    for (auto *block : blocks) {
+        for (auto *inst : *block) {
+            if (auto *phi = inst->as<ir::PhiInst>()) {
+                phi_uses.insert(phi_uses.end(), phi->incoming().begin(), phi->incoming().end());
+                kill[block].insert(inst);
+                continue;
+            }
+            ir::Operands operands(inst);
+            for (auto *value : operands.values()) {
+                if (is_variable(value) && !kill[block].contains(value)) {
+                    gen[block].insert(value);
+                }
+            }
+            kill[block].insert(inst);
+        }
+    }
+    for (auto [block, value] : phi_uses) {
+        if (kill.contains(block) && is_variable(value) && !kill.at(block).contains(value)) {
+            gen[block].insert(value);
+        }
+    }
+
+    // Every block reachable from the header is in blocks, so this doesn't need to look at any other block.
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<ir::Value *>> live_in;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+            auto live = gen[*it];
+            for (auto *succ : cfg.succs(*it)) {
+                for (auto *value : live_in[succ]) {
+                    if (!kill[*it].contains(value)) {
+                        live.insert(value);
+                    }
+                }
+            }
+            if (live.size() != live_in[*it].size()) {
+                live_in[*it] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+
+    const auto &header_live_in = live_in[header];
+    std::vector<ir::Value *> ret;
+    for (std::size_t i = 0; i < function.arguments().size(); i++) {
+        if (header_live_in.contains(function.argument(i))) {
+            ret.push_back(function.argument(i));
+        }
+    }
+    for (auto *block : function) {
+        for (auto *inst : *block) {
+            if (header_live_in.contains(inst)) {
+                ret.push_back(inst);
+            }
+        }
+    }
+    return ret;
+}
+
+// Builds a function that starts at the loop header, taking the live values, the values of the header's phis and then
+// the contents of the stack slots.
+std::unique_ptr<ir::Function> build_variant(const ir::Function &function, const Loop &loop,
+                                            const std::vector<ir::StackSlot *> &stack_slots, std::string &&name) {
+    std::vector<const ir::Type *> parameters;
+    for (auto *value : loop.live_values) {
+        parameters.push_back(value->type());
+    }
+    for (auto *phi : loop.header_phis) {
+        parameters.push_back(phi->type());
+    }
+    for (auto *stack_slot : stack_slots) {
+        parameters.push_back(stack_slot->type()->as_non_null<ir::PointerType>()->pointee_type());
+    }
+    auto variant = std::make_unique<ir::Function>(std::move(name), function.type(), parameters);
+    auto *entry = variant->append_block();
+    std::unordered_map<const ir::Value *, ir::Value *> value_map;
+    for (std::size_t i = 0; i < loop.live_values.size(); i++) {
+        value_map.emplace(loop.live_values[i], variant->argument(i));
+    }
+    const auto stack_slots_begin = loop.live_values.size() + loop.header_phis.size();
+    for (std::size_t i = 0; i < stack_slots.size(); i++) {
+        auto *stack_slot = variant->append_stack_slot(parameters[stack_slots_begin + i]);
+        value_map.emplace(stack_slots[i], stack_slot);
+        entry->append<ir::StoreInst>(stack_slot, variant->argument(stack_slots_begin + i));
+    }
+    for (auto *load : loop.live_loads) {
+        value_map.emplace(load, entry->append<ir::LoadInst>(value_map.at(load->ptr())));
+    }
+    ir::clone_into(function, loop.blocks, *variant, value_map);
+    for (std::size_t i = 0; i < loop.header_phis.size(); i++) {
+        auto *phi = value_map.at(loop.header_phis[i])->as_non_null<ir::PhiInst>();
+        phi->add_incoming(entry, variant->argument(loop.live_values.size() + i));
+    }
+    entry->append<ir::BranchInst>(value_map.at(loop.header)->as_non_null<ir::BasicBlock>());
+    return variant;
+}
+
+} // namespace
+
+std::vector<std::unique_ptr<ir::Function>> insert_osr_entries(ir::Function &function, std::uint32_t threshold) {
+    auto *entry = *function.begin();
+    auto cfg = ir::build_cfg(function);
+
+    // Find the loop headers from the back edges. A loop headed by the entry block is skipped since the counter is reset
+    // on entry.
+    std::vector<Loop> loops;
+    std::unordered_map<const ir::BasicBlock *, std::size_t> loop_indices;
+    const auto dfs = cfg.run<DepthFirstSearch>();
+    for (auto [latch, header] : dfs.back_edges()) {
+        if (header == entry) {
+            continue;
+        }
+        auto [it, inserted] = loop_indices.try_emplace(header, loops.size());
+        if (inserted) {
+            loops.push_back({header});
+        }
+        loops[it->second].latches.push_back(latch);
+    }
+
+    std::vector<ir::StackSlot *> stack_slots;
+    for (auto *stack_slot : function.stack_slots()) {
+        stack_slots.push_back(stack_slot);
+    }
+
+    // Build all of the variants before any of the back edges get redirected.
+    std::vector<Loop> osr_loops;
+    std::vector<std::unique_ptr<ir::Function>> variants;
+    for (auto &loop : loops) {
+        cfg.set_entry(loop.header);
+        const auto reachable = cfg.run<DepthFirstSearch>().pre_order();
+        const std::unordered_set<const ir::BasicBlock *> reachable_set(reachable.begin(), reachable.end());
+        for (const auto *block : function) {
+            if (reachable_set.contains(block)) {
+                loop.blocks.push_back(block);
+            }
+        }
+        for (auto *value : live_into(function, cfg, reachable, loop.header)) {
+            if (auto *load = value->as<ir::LoadInst>()) {
+                loop.live_loads.push_back(load);
+            } else {
+                loop.live_values.push_back(value);
+            }
+        }
+        for (auto *inst : *loop.header) {
+            if (auto *phi = inst->as<ir::PhiInst>()) {
+                loop.header_phis.push_back(phi);
+            }
+        }
+        if (loop.live_values.size() + loop.header_phis.size() + stack_slots.size() > k_max_arguments) {
+            continue;
+        }
+        auto name = function.name() + ".osr" + std::to_string(variants.size());
+        variants.push_back(build_variant(function, loop, stack_slots, std::move(name)));
+        osr_loops.push_back(std::move(loop));
+    }
+    if (variants.empty()) {
+        return variants;
+    }
+
+    const auto *counter_type = ir::IntegerType::get(32);
+    auto *counter = function.append_stack_slot(counter_type);
+    entry->prepend<ir::StoreInst>(counter, ir::Constant::get(counter_type, threshold));
+    for (std::size_t i = 0; i < osr_loops.size(); i++) {
+        const auto &loop = osr_loops[i];
+        auto *check = function.append_block();
+        auto *transfer = function.append_block();
+        // The back edges now go through the check, which merges the values the header's phis take on along them.
+        std::vector<ir::Value *> phi_values;
+        for (auto *phi : loop.header_phis) {
+            auto *merged = check->append<ir::PhiInst>(phi->type());
+            for (auto *latch : loop.latches) {
+                merged->add_incoming(latch, phi->incoming_value(latch));
+                phi->remove_incoming(latch);
+            }
+            phi->add_incoming(check, merged);
+            phi_values.push_back(merged);
+        }
+        auto *count = check->append<ir::BinaryInst>(ir::BinaryOp::Sub, check->append<ir::LoadInst>(counter),
+                                                   ir::Constant::get(counter_type, 1));
+        check->append<ir::StoreInst>(counter, count);
+        auto *hot = check->append<ir::CompareInst>(ir::CompareOp::Eq, count, ir::Constant::get(counter_type, 0));
+        check->append<ir::CondBranchInst>(hot, transfer, loop.header);
+
+        auto args = loop.live_values;
+        args.insert(args.end(), phi_values.begin(), phi_values.end());
+        for (auto *stack_slot : stack_slots) {
+            args.push_back(transfer->append<ir::LoadInst>(stack_slot));
+        }
+        transfer->append<ir::RetInst>(transfer->append<ir::CallInst>(variants[i].get(), std::move(args)));
+        for (auto *latch : loop.latches) {
+            (*--latch->end())->replace_uses_of_with(loop.header, check);
+        }
+    }
+    return variants;
+}
+
+} // namespace coel::jit
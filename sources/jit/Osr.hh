@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace coel::ir {
+
+class Function;
+
+} // namespace coel::ir
+
+namespace coel::jit {
+
+// Gives the loops of a function a way to carry on in a variant of the function that starts at the loop header. Each
+// call of the function counts down a counter of its own on every back edge, and once that reaches zero it calls the
+// loop's variant with the values live into the header, the values of the header's phis and the contents of its stack
+// slots, and returns what the variant returns. Loops with more values to pass than fit in argument registers are left
+// alone. Returns the variants, which aren't added to the function's unit.
+std::vector<std::unique_ptr<ir::Function>> insert_osr_entries(ir::Function &function, std::uint32_t threshold);
+
+} // namespace coel::jit
@@ -0,0 +1,164 @@
+#include <coel/opt/CommonSubexpressionElimination.hh>
+
+#include "Folding.hh"
+
+#include <coel/graph/DominanceComputer.hh>
+#include <coel/graph/DominatorTree.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+// An operand as far as numbering goes. Constants aren't shared, so they're told apart by their type and value rather
+// than by the constant itself.
+struct Operand {
+    std::uintptr_t id{0};
+    std::uint64_t constant{0};
+
+    auto operator<=>(const Operand &) const = default;
+};
+
+struct Expression {
+    ir::Opcode opcode;
+    unsigned op{0};
+    const ir::Type *type{nullptr};
+    std::array<Operand, 2> operands{};
+    // What memory held, which only matters to loads.
+    std::size_t generation{0};
+
+    bool operator==(const Expression &) const = default;
+};
+
+struct ExpressionHash {
+    std::size_t operator()(const Expression &expression) const {
+        std::size_t hash = 0;
+        auto combine = [&](std::size_t value) {
+            hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+        };
+        combine(static_cast<std::size_t>(expression.opcode));
+        combine(expression.op);
+        combine(std::hash<const ir::Type *>()(expression.type));
+        for (const auto &operand : expression.operands) {
+            combine(operand.id);
+            combine(operand.constant);
+        }
+        combine(expression.generation);
+        return hash;
+    }
+};
+
+Operand operand(const ir::Value *value) {
+    if (const auto *constant = value->as<ir::Constant>()) {
+        const auto width = bit_width(constant->type());
+        return {reinterpret_cast<std::uintptr_t>(constant->type()), truncate(constant->value(), width)};
+    }
+    return {reinterpret_cast<std::uintptr_t>(value)};
+}
+
+// Returns the expression an instruction computes, with the operands of commutative operations in a fixed order, or
+// nothing if it isn't one that can be reused.
+std::optional<Expression> expression_of(const ir::Instruction *inst, std::size_t generation) {
+    if (const auto *binary = inst->as<ir::BinaryInst>()) {
+        Expression expression{inst->opcode(), static_cast<unsigned>(binary->op()), inst->type(),
+                              {operand(binary->lhs()), operand(binary->rhs())}};
+        if (binary->op() == ir::BinaryOp::Add && expression.operands[1] < expression.operands[0]) {
+            std::swap(expression.operands[0], expression.operands[1]);
+        }
+        return expression;
+    }
+    if (const auto *compare = inst->as<ir::CompareInst>()) {
+        auto op = compare->op();
+        std::array operands{operand(compare->lhs()), operand(compare->rhs())};
+        if (operands[1] < operands[0]) {
+            std::swap(operands[0], operands[1]);
+            op = swap_operands(op);
+        }
+        return Expression{inst->opcode(), static_cast<unsigned>(op), inst->type(), operands};
+    }
+    if (const auto *load = inst->as<ir::LoadInst>()) {
+        return Expression{inst->opcode(), 0, inst->type(), {operand(load->ptr())}, generation};
+    }
+    return std::nullopt;
+}
+
+class SubexpressionEliminator {
+    const Graph<ir::BasicBlock> m_cfg;
+    const DominatorTree<ir::BasicBlock> m_tree;
+
+    // The instructions computing each expression in the blocks dominating the one being visited.
+    std::unordered_map<Expression, ir::Instruction *, ExpressionHash> m_available;
+    std::size_t m_generation{0};
+
+    void visit(ir::BasicBlock *block, std::size_t generation);
+
+public:
+    explicit SubexpressionEliminator(ir::Function &function)
+        : m_cfg(ir::build_cfg(function)), m_tree(m_cfg.run<DominanceComputer>()) {}
+
+    void run();
+};
+
+void SubexpressionEliminator::visit(ir::BasicBlock *block, std::size_t generation) {
+    // Memory is only known to be as the immediate dominator left it if that's the only way in. Otherwise, another path
+    // may have stored to it.
+    const auto &preds = m_cfg.preds(block);
+    if (preds.size() != 1 || preds[0] != m_tree.idom(block)) {
+        generation = ++m_generation;
+    }
+
+    std::vector<Expression> pushed;
+    for (auto it = block->begin(); it != block->end();) {
+        auto *inst = *it;
+        ++it;
+        if (inst->is<ir::StoreInst>() || inst->is<ir::CallInst>()) {
+            generation = ++m_generation;
+            continue;
+        }
+        auto expression = expression_of(inst, generation);
+        if (!expression) {
+            continue;
+        }
+        if (auto available = m_available.find(*expression); available != m_available.end()) {
+            inst->replace_all_uses_with(available->second);
+            block->remove(inst);
+            continue;
+        }
+        m_available.emplace(*expression, inst);
+        pushed.push_back(*expression);
+    }
+    for (auto *child : m_tree.succs(block)) {
+        visit(child, generation);
+    }
+    for (const auto &expression : pushed) {
+        m_available.erase(expression);
+    }
+}
+
+void SubexpressionEliminator::run() {
+    visit(m_cfg.entry(), 0);
+}
+
+} // namespace
+
+void eliminate_common_subexpressions(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    SubexpressionEliminator(function).run();
+}
+
+} // namespace coel::opt
@@ -0,0 +1,250 @@
+#include <coel/opt/ConstantPropagation.hh>
+
+#include "Folding.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/InstVisitor.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/support/Assert.hh>
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+// Where a value sits in the lattice. Values start off unknown (not yet seen to be defined) and can only move down to
+// a constant and then to overdefined.
+struct Lattice {
+    enum class Kind {
+        Unknown,
+        Constant,
+        Overdefined,
+    } kind{Kind::Unknown};
+    std::uint64_t value{0};
+
+    bool operator==(const Lattice &) const = default;
+};
+
+class ConstantPropagator final : public ir::InstVisitor {
+    ir::Function &m_function;
+    std::unordered_map<const ir::Instruction *, ir::BasicBlock *> m_parents;
+    std::unordered_map<const ir::Value *, Lattice> m_values;
+    std::unordered_set<const ir::BasicBlock *> m_executable_blocks;
+    // The predecessors of each block that it's known to be entered from.
+    std::unordered_map<const ir::BasicBlock *, std::unordered_set<const ir::BasicBlock *>> m_executable_edges;
+    std::vector<std::pair<ir::BasicBlock *, ir::BasicBlock *>> m_edge_worklist;
+    std::vector<ir::Instruction *> m_inst_worklist;
+
+    Lattice lattice(const ir::Value *value) const;
+    void update(ir::Instruction *inst, Lattice value);
+    void mark_edge(ir::BasicBlock *src, ir::BasicBlock *dst);
+    void rewrite();
+
+public:
+    explicit ConstantPropagator(ir::Function &function) : m_function(function) {}
+
+    void run();
+    void visit(ir::BinaryInst *) override;
+    void visit(ir::BranchInst *) override;
+    void visit(ir::CallInst *) override;
+    void visit(ir::CompareInst *) override;
+    void visit(ir::CondBranchInst *) override;
+    void visit(ir::CopyInst *) override {}
+    void visit(ir::LoadInst *) override;
+    void visit(ir::PhiInst *) override;
+    void visit(ir::RetInst *) override {}
+    void visit(ir::StoreInst *) override {}
+};
+
+Lattice ConstantPropagator::lattice(const ir::Value *value) const {
+    if (const auto *constant = value->as<ir::Constant>()) {
+        return {Lattice::Kind::Constant, truncate(constant->value(), bit_width(constant->type()))};
+    }
+    if (!value->is<ir::Instruction>()) {
+        return {Lattice::Kind::Overdefined};
+    }
+    auto it = m_values.find(value);
+    return it != m_values.end() ? it->second : Lattice{};
+}
+
+void ConstantPropagator::update(ir::Instruction *inst, Lattice value) {
+    auto &current = m_values[inst];
+    if (current == value) {
+        return;
+    }
+    COEL_ASSERT(current.kind < value.kind, "Lattice values can only move down");
+    current = value;
+    for (auto *user : inst->users()) {
+        m_inst_worklist.push_back(user->as_non_null<ir::Instruction>());
+    }
+}
+
+void ConstantPropagator::mark_edge(ir::BasicBlock *src, ir::BasicBlock *dst) {
+    if (m_executable_edges[dst].insert(src).second) {
+        m_edge_worklist.emplace_back(src, dst);
+    }
+}
+
+void ConstantPropagator::visit(ir::BinaryInst *binary) {
+    const auto lhs = lattice(binary->lhs());
+    const auto rhs = lattice(binary->rhs());
+    if (lhs.kind == Lattice::Kind::Overdefined || rhs.kind == Lattice::Kind::Overdefined) {
+        update(binary, {Lattice::Kind::Overdefined});
+        return;
+    }
+    if (lhs.kind == Lattice::Kind::Unknown || rhs.kind == Lattice::Kind::Unknown) {
+        return;
+    }
+    const auto value = fold_binary(binary->op(), lhs.value, rhs.value, bit_width(binary->type()));
+    update(binary, {Lattice::Kind::Constant, value});
+}
+
+void ConstantPropagator::visit(ir::BranchInst *branch) {
+    mark_edge(m_parents.at(branch), branch->dst());
+}
+
+void ConstantPropagator::visit(ir::CallInst *call) {
+    update(call, {Lattice::Kind::Overdefined});
+}
+
+void ConstantPropagator::visit(ir::CompareInst *compare) {
+    const auto lhs = lattice(compare->lhs());
+    const auto rhs = lattice(compare->rhs());
+    if (lhs.kind == Lattice::Kind::Overdefined || rhs.kind == Lattice::Kind::Overdefined) {
+        update(compare, {Lattice::Kind::Overdefined});
+        return;
+    }
+    if (lhs.kind == Lattice::Kind::Unknown || rhs.kind == Lattice::Kind::Unknown) {
+        return;
+    }
+    const bool value = fold_compare(compare->op(), lhs.value, rhs.value, bit_width(compare->lhs()->type()));
+    update(compare, {Lattice::Kind::Constant, value ? 1u : 0u});
+}
+
+void ConstantPropagator::visit(ir::CondBranchInst *cond_branch) {
+    auto *block = m_parents.at(cond_branch);
+    const auto cond = lattice(cond_branch->cond());
+    if (cond.kind == Lattice::Kind::Constant) {
+        mark_edge(block, cond.value != 0 ? cond_branch->true_dst() : cond_branch->false_dst());
+    } else if (cond.kind == Lattice::Kind::Overdefined) {
+        mark_edge(block, cond_branch->true_dst());
+        mark_edge(block, cond_branch->false_dst());
+    }
+}
+
+void ConstantPropagator::visit(ir::LoadInst *load) {
+    update(load, {Lattice::Kind::Overdefined});
+}
+
+void ConstantPropagator::visit(ir::PhiInst *phi) {
+    // Only the values coming in over edges known to be taken count.
+    const auto &executable_preds = m_executable_edges[m_parents.at(phi)];
+    Lattice result;
+    for (auto [pred, value] : phi->incoming()) {
+        if (!executable_preds.contains(pred)) {
+            continue;
+        }
+        const auto incoming = lattice(value);
+        if (incoming.kind == Lattice::Kind::Unknown) {
+            continue;
+        }
+        if (incoming.kind == Lattice::Kind::Overdefined ||
+            (result.kind == Lattice::Kind::Constant && result.value != incoming.value)) {
+            result = {Lattice::Kind::Overdefined};
+            break;
+        }
+        result = incoming;
+    }
+    if (result.kind != Lattice::Kind::Unknown) {
+        update(phi, result);
+    }
+}
+
+void ConstantPropagator::rewrite() {
+    for (auto *block : m_function) {
+        if (!m_executable_blocks.contains(block)) {
+            continue;
+        }
+        for (auto it = block->begin(); it != block->end();) {
+            auto *inst = *it;
+            ++it;
+            const auto value = lattice(inst);
+            if (value.kind == Lattice::Kind::Constant) {
+                inst->replace_all_uses_with(ir::Constant::get(inst->type(), value.value));
+                block->remove(inst);
+            }
+        }
+
+        // The condition of a branch that only ever goes one way has been replaced with a constant above. The phis of
+        // the block that isn't branched to no longer have the edge coming in.
+        auto *cond_branch = block->terminator()->as<ir::CondBranchInst>();
+        if (cond_branch == nullptr || !cond_branch->cond()->is<ir::Constant>()) {
+            continue;
+        }
+        const bool taken = cond_branch->cond()->as_non_null<ir::Constant>()->value() != 0;
+        auto *dst = taken ? cond_branch->true_dst() : cond_branch->false_dst();
+        auto *dead_dst = taken ? cond_branch->false_dst() : cond_branch->true_dst();
+        for (auto *inst : *dead_dst) {
+            if (auto *phi = inst->as<ir::PhiInst>(); phi != nullptr && phi->incoming_value(block) != nullptr) {
+                phi->remove_incoming(block);
+            }
+        }
+        block->remove(cond_branch);
+        block->append<ir::BranchInst>(dst);
+    }
+}
+
+void ConstantPropagator::run() {
+    for (auto *block : m_function) {
+        for (auto *inst : *block) {
+            m_parents.emplace(inst, block);
+        }
+    }
+
+    // Enter through a pseudo-edge with no source.
+    auto *entry = *m_function.begin();
+    m_edge_worklist.emplace_back(nullptr, entry);
+    while (!m_edge_worklist.empty() || !m_inst_worklist.empty()) {
+        while (!m_edge_worklist.empty()) {
+            auto [src, dst] = m_edge_worklist.back();
+            m_edge_worklist.pop_back();
+            if (!m_executable_blocks.insert(dst).second) {
+                // Already visited, but the phis have another edge to take into account.
+                for (auto *inst : *dst) {
+                    if (auto *phi = inst->as<ir::PhiInst>()) {
+                        phi->accept(this);
+                    }
+                }
+                continue;
+            }
+            for (auto *inst : *dst) {
+                inst->accept(this);
+            }
+        }
+        while (!m_inst_worklist.empty()) {
+            auto *inst = m_inst_worklist.back();
+            m_inst_worklist.pop_back();
+            if (m_executable_blocks.contains(m_parents.at(inst))) {
+                inst->accept(this);
+            }
+        }
+    }
+    rewrite();
+}
+
+} // namespace
+
+void propagate_constants(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    ConstantPropagator(function).run();
+}
+
+} // namespace coel::opt
@@ -0,0 +1,100 @@
+#include <coel/opt/DeadCodeElimination.hh>
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Operands.hh>
+#include <coel/ir/StackSlot.hh>
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+bool has_side_effects(const ir::Instruction *inst) {
+    return inst->is_terminator() || inst->is<ir::CallInst>() || inst->is<ir::CopyInst>() ||
+           inst->is<ir::StoreInst>();
+}
+
+// A slot that's never loaded from can't affect anything, so its stores are dead too.
+void remove_dead_stack_slots(ir::Function &function) {
+    std::vector<ir::StackSlot *> dead_slots;
+    for (auto *stack_slot : function.stack_slots()) {
+        const auto &users = stack_slot->users();
+        if (std::all_of(users.begin(), users.end(), [stack_slot](ir::Value *user) {
+                auto *store = user->as<ir::StoreInst>();
+                return store != nullptr && store->ptr() == stack_slot && store->value() != stack_slot;
+            })) {
+            dead_slots.push_back(stack_slot);
+        }
+    }
+    for (auto *block : function) {
+        for (auto it = block->begin(); it != block->end();) {
+            auto *store = (*it)->as<ir::StoreInst>();
+            ++it;
+            if (store != nullptr && std::find(dead_slots.begin(), dead_slots.end(), store->ptr()) != dead_slots.end()) {
+                block->remove(store);
+            }
+        }
+    }
+    for (auto *stack_slot : dead_slots) {
+        function.remove_stack_slot(stack_slot);
+    }
+}
+
+// Marks the instructions that side effects depend on, which unlike looking for instructions without users also catches
+// dead cycles through phis.
+void remove_dead_instructions(ir::Function &function) {
+    std::unordered_set<const ir::Instruction *> live;
+    std::vector<ir::Instruction *> worklist;
+    for (auto *block : function) {
+        for (auto *inst : *block) {
+            if (has_side_effects(inst)) {
+                live.insert(inst);
+                worklist.push_back(inst);
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        ir::Operands operands(worklist.back());
+        worklist.pop_back();
+        for (auto *value : operands.values()) {
+            auto *inst = value->as<ir::Instruction>();
+            if (inst != nullptr && live.insert(inst).second) {
+                worklist.push_back(inst);
+            }
+        }
+    }
+
+    std::vector<std::pair<ir::BasicBlock *, ir::Instruction *>> dead;
+    for (auto *block : function) {
+        for (auto *inst : *block) {
+            if (!live.contains(inst)) {
+                dead.emplace_back(block, inst);
+            }
+        }
+    }
+    for (auto [block, inst] : dead) {
+        inst->replace_all_uses_with(nullptr);
+    }
+    for (auto [block, inst] : dead) {
+        block->remove(inst);
+    }
+}
+
+} // namespace
+
+void eliminate_dead_code(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    ir::remove_unreachable_blocks(function);
+    remove_dead_stack_slots(function);
+    remove_dead_instructions(function);
+}
+
+} // namespace coel::opt
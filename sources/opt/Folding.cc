@@ -0,0 +1,92 @@
+#include "Folding.hh"
+
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/support/Assert.hh>
+
+namespace coel::opt {
+namespace {
+
+std::int64_t sign_extend(std::uint64_t value, unsigned width) {
+    const auto shift = 64 - width;
+    return static_cast<std::int64_t>(value << shift) >> shift;
+}
+
+} // namespace
+
+unsigned bit_width(const ir::Type *type) {
+    if (const auto *integer_type = type->as<ir::IntegerType>()) {
+        return integer_type->bit_width();
+    }
+    COEL_ASSERT(type->is<ir::BoolType>());
+    return 1;
+}
+
+std::uint64_t truncate(std::uint64_t value, unsigned width) {
+    return width < 64 ? value & ((std::uint64_t(1) << width) - 1) : value;
+}
+
+std::uint64_t fold_binary(ir::BinaryOp op, std::uint64_t lhs, std::uint64_t rhs, unsigned width) {
+    switch (op) {
+    case ir::BinaryOp::Add:
+        return truncate(lhs + rhs, width);
+    case ir::BinaryOp::Sub:
+        return truncate(lhs - rhs, width);
+    }
+    COEL_ENSURE_NOT_REACHED();
+}
+
+bool fold_compare(ir::CompareOp op, std::uint64_t lhs, std::uint64_t rhs, unsigned width) {
+    const auto signed_lhs = sign_extend(lhs, width);
+    const auto signed_rhs = sign_extend(rhs, width);
+    switch (op) {
+    case ir::CompareOp::Eq:
+        return lhs == rhs;
+    case ir::CompareOp::Ne:
+        return lhs != rhs;
+    case ir::CompareOp::Lt:
+        return signed_lhs < signed_rhs;
+    case ir::CompareOp::Gt:
+        return signed_lhs > signed_rhs;
+    case ir::CompareOp::Le:
+        return signed_lhs <= signed_rhs;
+    case ir::CompareOp::Ge:
+        return signed_lhs >= signed_rhs;
+    case ir::CompareOp::ULt:
+        return lhs < rhs;
+    case ir::CompareOp::UGt:
+        return lhs > rhs;
+    case ir::CompareOp::ULe:
+        return lhs <= rhs;
+    case ir::CompareOp::UGe:
+        return lhs >= rhs;
+    }
+    COEL_ENSURE_NOT_REACHED();
+}
+
+ir::CompareOp swap_operands(ir::CompareOp op) {
+    switch (op) {
+    case ir::CompareOp::Eq:
+    case ir::CompareOp::Ne:
+        return op;
+    case ir::CompareOp::Lt:
+        return ir::CompareOp::Gt;
+    case ir::CompareOp::Gt:
+        return ir::CompareOp::Lt;
+    case ir::CompareOp::Le:
+        return ir::CompareOp::Ge;
+    case ir::CompareOp::Ge:
+        return ir::CompareOp::Le;
+    case ir::CompareOp::ULt:
+        return ir::CompareOp::UGt;
+    case ir::CompareOp::UGt:
+        return ir::CompareOp::ULt;
+    case ir::CompareOp::ULe:
+        return ir::CompareOp::UGe;
+    case ir::CompareOp::UGe:
+        return ir::CompareOp::ULe;
+    }
+    COEL_ENSURE_NOT_REACHED();
+}
+
+} // namespace coel::opt
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace coel::ir {
+
+enum class BinaryOp;
+enum class CompareOp;
+class Type;
+
+} // namespace coel::ir
+
+namespace coel::opt {
+
+// Constant values are kept zero-extended to 64 bits, with any bits above the width of their type clear.
+unsigned bit_width(const ir::Type *type);
+std::uint64_t truncate(std::uint64_t value, unsigned width);
+std::uint64_t fold_binary(ir::BinaryOp op, std::uint64_t lhs, std::uint64_t rhs, unsigned width);
+bool fold_compare(ir::CompareOp op, std::uint64_t lhs, std::uint64_t rhs, unsigned width);
+
+// Returns the compare op that gives the same result with its operands the other way around.
+ir::CompareOp swap_operands(ir::CompareOp op);
+
+} // namespace coel::opt
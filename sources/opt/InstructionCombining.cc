@@ -0,0 +1,216 @@
+#include <coel/opt/InstructionCombining.hh>
+
+#include "Folding.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Operands.hh>
+#include <coel/ir/Types.hh>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+// An add or subtract of a constant, as the value added to and the amount added, wrapped to the width of the type.
+struct Offset {
+    ir::Value *base;
+    std::uint64_t amount;
+};
+
+std::optional<Offset> as_offset(ir::Value *value) {
+    auto *binary = value->as<ir::BinaryInst>();
+    if (binary == nullptr || !binary->rhs()->is<ir::Constant>()) {
+        return std::nullopt;
+    }
+    const auto width = bit_width(binary->type());
+    const auto amount = truncate(binary->rhs()->as_non_null<ir::Constant>()->value(), width);
+    return Offset{binary->lhs(), binary->op() == ir::BinaryOp::Add ? amount : truncate(-amount, width)};
+}
+
+// Adding a large amount is written as subtracting a small one, which keeps immediates short.
+bool is_subtract(std::uint64_t amount, unsigned width) {
+    return truncate(-amount, width) < amount;
+}
+
+bool is_pure(const ir::Instruction *inst) {
+    return inst->is<ir::BinaryInst>() || inst->is<ir::CompareInst>();
+}
+
+class InstCombiner {
+    std::unordered_map<const ir::Instruction *, ir::BasicBlock *> m_parents;
+    std::vector<ir::Instruction *> m_worklist;
+    // The instructions on the worklist. Anything removed while still on the worklist is skipped when it comes up.
+    std::unordered_set<const ir::Instruction *> m_queued;
+
+    void push(ir::Value *value);
+    void remove(ir::Instruction *inst);
+    template <typename Inst, typename... Args>
+    Inst *insert_before(ir::Instruction *position, Args &&...args);
+
+    ir::Value *combine(ir::BinaryInst *binary);
+    ir::Value *combine(ir::CompareInst *compare);
+
+public:
+    explicit InstCombiner(ir::Function &function);
+
+    void run();
+};
+
+InstCombiner::InstCombiner(ir::Function &function) {
+    std::vector<ir::Instruction *> insts;
+    for (auto *block : function) {
+        for (auto *inst : *block) {
+            m_parents.emplace(inst, block);
+            insts.push_back(inst);
+        }
+    }
+    // Start at the top of the function, since operands are best simplified before their users.
+    for (auto it = insts.rbegin(); it != insts.rend(); ++it) {
+        push(*it);
+    }
+}
+
+void InstCombiner::push(ir::Value *value) {
+    auto *inst = value->as<ir::Instruction>();
+    if (inst != nullptr && is_pure(inst) && m_queued.insert(inst).second) {
+        m_worklist.push_back(inst);
+    }
+}
+
+// Removes an instruction without users, whose operands might then be left without users themselves.
+void InstCombiner::remove(ir::Instruction *inst) {
+    const auto operands = ir::Operands(inst).values();
+    m_parents.at(inst)->remove(inst);
+    m_parents.erase(inst);
+    m_queued.erase(inst);
+    for (auto *operand : operands) {
+        push(operand);
+    }
+}
+
+template <typename Inst, typename... Args>
+Inst *InstCombiner::insert_before(ir::Instruction *position, Args &&...args) {
+    auto *block = m_parents.at(position);
+    auto *inst = block->insert<Inst>(position, std::forward<Args>(args)...);
+    m_parents.emplace(inst, block);
+    return inst;
+}
+
+ir::Value *InstCombiner::combine(ir::BinaryInst *binary) {
+    auto *lhs = binary->lhs();
+    auto *rhs = binary->rhs();
+    const auto *type = binary->type();
+    const auto width = bit_width(type);
+    auto *lhs_constant = lhs->as<ir::Constant>();
+    auto *rhs_constant = rhs->as<ir::Constant>();
+    if (lhs_constant != nullptr && rhs_constant != nullptr) {
+        return ir::Constant::get(type, fold_binary(binary->op(), lhs_constant->value(), rhs_constant->value(), width));
+    }
+    if (binary->op() == ir::BinaryOp::Sub && lhs == rhs) {
+        return ir::Constant::get(type, 0);
+    }
+    if (binary->op() == ir::BinaryOp::Add && lhs_constant != nullptr) {
+        return insert_before<ir::BinaryInst>(binary, ir::BinaryOp::Add, rhs, lhs);
+    }
+    if (rhs_constant == nullptr) {
+        return nullptr;
+    }
+
+    // (x + c1) - c2 becomes x + (c1 - c2), and so on.
+    auto offset = *as_offset(binary);
+    const bool reassociated = as_offset(offset.base).has_value();
+    if (reassociated) {
+        const auto inner = *as_offset(offset.base);
+        offset = {inner.base, truncate(inner.amount + offset.amount, width)};
+    }
+    if (offset.amount == 0) {
+        return offset.base;
+    }
+    const bool subtract = is_subtract(offset.amount, width);
+    if (!reassociated && subtract == (binary->op() == ir::BinaryOp::Sub)) {
+        return nullptr;
+    }
+    return insert_before<ir::BinaryInst>(binary, subtract ? ir::BinaryOp::Sub : ir::BinaryOp::Add, offset.base,
+                                         ir::Constant::get(type, subtract ? truncate(-offset.amount, width)
+                                                                          : offset.amount));
+}
+
+ir::Value *InstCombiner::combine(ir::CompareInst *compare) {
+    auto *lhs = compare->lhs();
+    auto *rhs = compare->rhs();
+    const auto width = bit_width(lhs->type());
+    auto *lhs_constant = lhs->as<ir::Constant>();
+    auto *rhs_constant = rhs->as<ir::Constant>();
+    if (lhs_constant != nullptr && rhs_constant != nullptr) {
+        const bool value = fold_compare(compare->op(), truncate(lhs_constant->value(), width),
+                                        truncate(rhs_constant->value(), width), width);
+        return ir::Constant::get(ir::BoolType::get(), value ? 1 : 0);
+    }
+    if (lhs == rhs) {
+        return ir::Constant::get(ir::BoolType::get(), fold_compare(compare->op(), 0, 0, width) ? 1 : 0);
+    }
+    if (lhs_constant != nullptr) {
+        return insert_before<ir::CompareInst>(compare, swap_operands(compare->op()), rhs, lhs);
+    }
+
+    // Equality doesn't care about wrapping, so x + c1 == c2 is the same as x == c2 - c1.
+    const bool is_equality = compare->op() == ir::CompareOp::Eq || compare->op() == ir::CompareOp::Ne;
+    if (rhs_constant == nullptr || !is_equality) {
+        return nullptr;
+    }
+    const auto offset = as_offset(lhs);
+    if (!offset) {
+        return nullptr;
+    }
+    const auto value = truncate(rhs_constant->value() - offset->amount, width);
+    return insert_before<ir::CompareInst>(compare, compare->op(), offset->base, ir::Constant::get(lhs->type(), value));
+}
+
+void InstCombiner::run() {
+    while (!m_worklist.empty()) {
+        auto *inst = m_worklist.back();
+        m_worklist.pop_back();
+        if (m_queued.erase(inst) == 0) {
+            continue;
+        }
+        if (inst->users().empty()) {
+            remove(inst);
+            continue;
+        }
+
+        ir::Value *replacement = nullptr;
+        if (auto *binary = inst->as<ir::BinaryInst>()) {
+            replacement = combine(binary);
+        } else if (auto *compare = inst->as<ir::CompareInst>()) {
+            replacement = combine(compare);
+        }
+        if (replacement == nullptr) {
+            continue;
+        }
+        for (auto *user : inst->users()) {
+            push(user);
+        }
+        push(replacement);
+        inst->replace_all_uses_with(replacement);
+        remove(inst);
+    }
+}
+
+} // namespace
+
+void combine_instructions(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    InstCombiner(function).run();
+}
+
+} // namespace coel::opt
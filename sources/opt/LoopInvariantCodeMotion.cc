@@ -0,0 +1,153 @@
+#include <coel/opt/LoopInvariantCodeMotion.hh>
+
+#include <coel/graph/DepthFirstSearch.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/graph/LoopFinder.hh>
+#include <coel/graph/LoopInfo.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/StackSlot.hh>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using Loop = coel::Loop<ir::BasicBlock>;
+
+class LoopInvariantMover {
+    const Graph<ir::BasicBlock> m_cfg;
+    const LoopInfo<ir::BasicBlock> m_loops;
+    std::vector<ir::BasicBlock *> m_reverse_post_order;
+
+    void hoist(const Loop *loop);
+    void sink_stores(const Loop *loop);
+
+public:
+    explicit LoopInvariantMover(ir::Function &function);
+
+    void run();
+};
+
+LoopInvariantMover::LoopInvariantMover(ir::Function &function)
+    : m_cfg(ir::build_cfg(function)), m_loops(m_cfg.run<LoopFinder>()) {
+    const auto dfs = m_cfg.run<DepthFirstSearch>();
+    m_reverse_post_order = dfs.post_order();
+    std::reverse(m_reverse_post_order.begin(), m_reverse_post_order.end());
+}
+
+void LoopInvariantMover::hoist(const Loop *loop) {
+    auto *preheader = loop->preheader();
+    if (preheader == nullptr) {
+        return;
+    }
+
+    std::unordered_set<const ir::Instruction *> loop_insts;
+    std::unordered_set<const ir::Value *> stored_slots;
+    // Whether the loop can write to memory other than through a known stack slot.
+    bool may_write_escaped = false;
+    for (auto *block : loop->nodes()) {
+        for (auto *inst : *block) {
+            loop_insts.insert(inst);
+            if (auto *store = inst->as<ir::StoreInst>()) {
+                stored_slots.insert(store->ptr());
+                may_write_escaped |= !store->ptr()->is<ir::StackSlot>();
+            }
+            may_write_escaped |= inst->is<ir::CallInst>();
+        }
+    }
+    auto is_invariant = [&](const ir::Value *value) {
+        const auto *inst = value->as<ir::Instruction>();
+        return inst == nullptr || !loop_insts.contains(inst);
+    };
+
+    // Blocks are visited in reverse post-order, so the operands of an instruction have been looked at before it.
+    for (auto *block : m_reverse_post_order) {
+        if (!loop->contains(block)) {
+            continue;
+        }
+        for (auto it = block->begin(); it != block->end();) {
+            auto *inst = *it;
+            ++it;
+            bool hoistable = false;
+            if (auto *binary = inst->as<ir::BinaryInst>()) {
+                hoistable = is_invariant(binary->lhs()) && is_invariant(binary->rhs());
+            } else if (auto *compare = inst->as<ir::CompareInst>()) {
+                hoistable = is_invariant(compare->lhs()) && is_invariant(compare->rhs());
+            } else if (auto *load = inst->as<ir::LoadInst>()) {
+                auto *stack_slot = load->ptr()->as<ir::StackSlot>();
+                hoistable = stack_slot != nullptr && !stored_slots.contains(stack_slot) &&
+                            (!may_write_escaped || !stack_slot->is_address_taken());
+            }
+            if (hoistable) {
+                block->transfer(inst, preheader, preheader->terminator());
+                loop_insts.erase(inst);
+            }
+        }
+    }
+}
+
+// A store in the block that the loop is left from is the last one made to its slot before leaving, so if nothing in the
+// loop reads the slot, storing once on the way out is enough. The stored value dominates the exit since the exiting
+// block is its only predecessor.
+void LoopInvariantMover::sink_stores(const Loop *loop) {
+    if (loop->exits().size() != 1 || m_cfg.preds(loop->exits()[0]).size() != 1) {
+        return;
+    }
+    auto *exit = loop->exits()[0];
+    auto *exiting = m_cfg.preds(exit)[0];
+
+    std::unordered_map<const ir::Value *, unsigned> store_counts;
+    std::unordered_set<const ir::Value *> loaded_slots;
+    for (auto *block : loop->nodes()) {
+        for (auto *inst : *block) {
+            if (auto *store = inst->as<ir::StoreInst>()) {
+                store_counts[store->ptr()]++;
+            } else if (auto *load = inst->as<ir::LoadInst>()) {
+                loaded_slots.insert(load->ptr());
+            }
+        }
+    }
+
+    auto position = exit->begin();
+    while ((*position)->is<ir::PhiInst>()) {
+        ++position;
+    }
+    for (auto it = exiting->begin(); it != exiting->end();) {
+        auto *store = (*it)->as<ir::StoreInst>();
+        ++it;
+        if (store == nullptr) {
+            continue;
+        }
+        auto *stack_slot = store->ptr()->as<ir::StackSlot>();
+        if (stack_slot != nullptr && store_counts.at(stack_slot) == 1 && !loaded_slots.contains(stack_slot) &&
+            !stack_slot->is_address_taken()) {
+            exiting->transfer(store, exit, *position);
+        }
+    }
+}
+
+void LoopInvariantMover::run() {
+    // Inner loops come first, so that what's hoisted out of them can be hoisted further out of the loops around them.
+    for (const auto &loop : m_loops.loops()) {
+        hoist(loop.get());
+        sink_stores(loop.get());
+    }
+}
+
+} // namespace
+
+void move_loop_invariant_code(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    ir::insert_loop_preheaders(function);
+    LoopInvariantMover(function).run();
+}
+
+} // namespace coel::opt
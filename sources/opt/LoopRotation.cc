@@ -0,0 +1,256 @@
+#include <coel/opt/LoopRotation.hh>
+
+#include <coel/graph/DominanceComputer.hh>
+#include <coel/graph/DominatorTree.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/graph/LoopFinder.hh>
+#include <coel/graph/LoopInfo.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using Loop = coel::Loop<ir::BasicBlock>;
+using ValueMap = std::unordered_map<const ir::Value *, ir::Value *>;
+
+// Copying the test is only worth it while it's small.
+constexpr std::size_t k_max_duplicated = 8;
+
+ir::Value *lookup(const ValueMap &map, ir::Value *value) {
+    auto it = map.find(value);
+    return it != map.end() ? it->second : value;
+}
+
+// Copies a binary instruction or compare to before the given position, with its operands looked up in a map.
+ir::Instruction *clone(ir::Instruction *inst, ir::BasicBlock *block, ir::Instruction *position, const ValueMap &map) {
+    if (auto *binary = inst->as<ir::BinaryInst>()) {
+        return block->insert<ir::BinaryInst>(position, binary->op(), lookup(map, binary->lhs()),
+                                             lookup(map, binary->rhs()));
+    }
+    auto *compare = inst->as_non_null<ir::CompareInst>();
+    return block->insert<ir::CompareInst>(position, compare->op(), lookup(map, compare->lhs()),
+                                          lookup(map, compare->rhs()));
+}
+
+class LoopRotator {
+    ir::Function &m_function;
+    const Graph<ir::BasicBlock> m_cfg;
+    const DominatorTree<ir::BasicBlock> m_tree;
+    const LoopInfo<ir::BasicBlock> m_loops;
+    std::unordered_map<const ir::Instruction *, ir::BasicBlock *> m_parents;
+
+    // Returns the blocks in which a use of a value in the header takes place, which for phis are the predecessors the
+    // value comes in from.
+    std::vector<ir::BasicBlock *> use_blocks(ir::Value *user, const ir::Value *value) const;
+    bool is_rotatable(const Loop *loop) const;
+    void rotate(const Loop *loop);
+
+public:
+    explicit LoopRotator(ir::Function &function);
+
+    bool run();
+};
+
+LoopRotator::LoopRotator(ir::Function &function)
+    : m_function(function), m_cfg(ir::build_cfg(function)), m_tree(m_cfg.run<DominanceComputer>()),
+      m_loops(m_cfg.run<LoopFinder>()) {
+    for (auto *block : function) {
+        for (auto *inst : *block) {
+            m_parents.emplace(inst, block);
+        }
+    }
+}
+
+std::vector<ir::BasicBlock *> LoopRotator::use_blocks(ir::Value *user, const ir::Value *value) const {
+    auto *phi = user->as<ir::PhiInst>();
+    if (phi == nullptr) {
+        return {m_parents.at(user->as_non_null<ir::Instruction>())};
+    }
+    std::vector<ir::BasicBlock *> blocks;
+    for (auto [block, incoming] : phi->incoming()) {
+        if (incoming == value) {
+            blocks.push_back(block);
+        }
+    }
+    return blocks;
+}
+
+// The loop needs to look like a while loop: a preheader, a header that either enters the body or leaves the loop, and a
+// single latch that branches straight back to the header. The body and the exit must only be entered from the header,
+// and anything defined in the header must only be used in one or the other.
+bool LoopRotator::is_rotatable(const Loop *loop) const {
+    auto *header = loop->header();
+    auto *cond_branch = header->terminator()->as<ir::CondBranchInst>();
+    if (loop->preheader() == nullptr || cond_branch == nullptr || loop->latches().size() != 1) {
+        return false;
+    }
+    auto *latch = loop->latches()[0];
+    if (latch == header || !latch->terminator()->is<ir::BranchInst>()) {
+        return false;
+    }
+    const bool exits_on_true = !loop->contains(cond_branch->true_dst());
+    auto *body = exits_on_true ? cond_branch->false_dst() : cond_branch->true_dst();
+    auto *exit = exits_on_true ? cond_branch->true_dst() : cond_branch->false_dst();
+    if (loop->contains(exit) == loop->contains(body) || m_cfg.preds(body).size() != 1 ||
+        m_cfg.preds(exit).size() != 1 || (*body->begin())->is<ir::PhiInst>()) {
+        return false;
+    }
+
+    std::size_t duplicated = 0;
+    for (auto *inst : *header) {
+        if (inst == cond_branch || inst->is<ir::PhiInst>()) {
+            continue;
+        }
+        if ((!inst->is<ir::BinaryInst>() && !inst->is<ir::CompareInst>()) || ++duplicated > k_max_duplicated) {
+            return false;
+        }
+    }
+    for (auto *inst : *header) {
+        for (auto *user : inst->users()) {
+            if (m_parents.at(user->as_non_null<ir::Instruction>()) == header) {
+                continue;
+            }
+            if (user->is<ir::PhiInst>() && m_parents.at(user->as_non_null<ir::Instruction>()) == exit) {
+                continue;
+            }
+            bool in_body = true;
+            bool in_exit = true;
+            for (auto *block : use_blocks(user, inst)) {
+                in_body &= m_tree.dominates(body, block);
+                in_exit &= m_tree.dominates(exit, block);
+            }
+            if (!in_body && !in_exit) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void LoopRotator::rotate(const Loop *loop) {
+    auto *preheader = loop->preheader();
+    auto *header = loop->header();
+    auto *latch = loop->latches()[0];
+    auto *cond_branch = header->terminator()->as_non_null<ir::CondBranchInst>();
+    const bool exits_on_true = !loop->contains(cond_branch->true_dst());
+    auto *body = exits_on_true ? cond_branch->false_dst() : cond_branch->true_dst();
+    auto *exit = exits_on_true ? cond_branch->true_dst() : cond_branch->false_dst();
+
+    // Every value defined in the header gets a phi at the start of the body holding its value for the current
+    // iteration. The copies of the test in the preheader and the latch work out the values for the next one.
+    std::vector<ir::Instruction *> defined;
+    ValueMap current;
+    auto *first = *body->begin();
+    for (auto *inst : *header) {
+        if (inst != cond_branch) {
+            defined.push_back(inst);
+            current.emplace(inst, body->insert<ir::PhiInst>(first, inst->type()));
+        }
+    }
+    ValueMap from_preheader;
+    ValueMap from_latch;
+    for (auto *inst : defined) {
+        if (auto *phi = inst->as<ir::PhiInst>()) {
+            from_preheader.emplace(phi, phi->incoming_value(preheader));
+            from_latch.emplace(phi, lookup(current, phi->incoming_value(latch)));
+            continue;
+        }
+        from_preheader.emplace(inst, clone(inst, preheader, preheader->terminator(), from_preheader));
+        from_latch.emplace(inst, clone(inst, latch, latch->terminator(), from_latch));
+    }
+    for (auto [block, values] : {std::make_pair(preheader, &from_preheader), std::make_pair(latch, &from_latch)}) {
+        block->remove(block->terminator());
+        block->append<ir::CondBranchInst>(lookup(*values, cond_branch->cond()), cond_branch->true_dst(),
+                                          cond_branch->false_dst());
+    }
+    for (auto *inst : defined) {
+        auto *phi = current.at(inst)->as_non_null<ir::PhiInst>();
+        phi->add_incoming(preheader, from_preheader.at(inst));
+        phi->add_incoming(latch, from_latch.at(inst));
+    }
+
+    // The exit is now entered from the preheader and the latch instead of the header.
+    for (auto *inst : *exit) {
+        auto *phi = inst->as<ir::PhiInst>();
+        if (phi == nullptr) {
+            break;
+        }
+        auto *value = phi->incoming_value(header);
+        phi->remove_incoming(header);
+        phi->add_incoming(preheader, lookup(from_preheader, value));
+        phi->add_incoming(latch, lookup(from_latch, value));
+    }
+
+    // Uses after the loop get a phi in the exit, and uses in the loop get the phi in the body.
+    for (auto *inst : defined) {
+        ir::PhiInst *exit_phi = nullptr;
+        const std::vector<ir::Value *> users(inst->users().begin(), inst->users().end());
+        for (auto *user : users) {
+            if (m_parents.at(user->as_non_null<ir::Instruction>()) == header) {
+                continue;
+            }
+            if (!m_tree.dominates(exit, use_blocks(user, inst)[0])) {
+                user->as_non_null<ir::Instruction>()->replace_uses_of_with(inst, current.at(inst));
+                continue;
+            }
+            if (exit_phi == nullptr) {
+                exit_phi = exit->prepend<ir::PhiInst>(inst->type());
+                exit_phi->add_incoming(preheader, from_preheader.at(inst));
+                exit_phi->add_incoming(latch, from_latch.at(inst));
+            }
+            user->as_non_null<ir::Instruction>()->replace_uses_of_with(inst, exit_phi);
+        }
+    }
+
+    // The header can't be reached anymore, and the phis in the body that turned out not to be needed can go.
+    ir::remove_unreachable_blocks(m_function);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = current.begin(); it != current.end();) {
+            auto *phi = it->second->as_non_null<ir::PhiInst>();
+            if (!phi->users().empty()) {
+                ++it;
+                continue;
+            }
+            body->remove(phi);
+            it = current.erase(it);
+            changed = true;
+        }
+    }
+}
+
+bool LoopRotator::run() {
+    for (const auto &loop : m_loops.loops()) {
+        if (is_rotatable(loop.get())) {
+            rotate(loop.get());
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void rotate_loops(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    // Each rotation changes the shape of the graph, so the analyses are redone for the next one. A rotated loop no
+    // longer has a latch ending in a plain branch, so this stops. Unreachable blocks have no place in the dominator
+    // tree, so uses in them can't be checked and they go first.
+    ir::remove_unreachable_blocks(function);
+    ir::insert_loop_preheaders(function);
+    while (LoopRotator(function).run()) {
+    }
+}
+
+} // namespace coel::opt
@@ -0,0 +1,328 @@
+#include <coel/opt/SimplifyCfg.hh>
+
+#include "Folding.hh"
+
+#include <coel/graph/Graph.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+
+#include <algorithm>
+#include <array>
+#include <unordered_set>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+std::vector<ir::PhiInst *> phis_of(const ir::BasicBlock *block) {
+    std::vector<ir::PhiInst *> phis;
+    for (auto *inst : *block) {
+        auto *phi = inst->as<ir::PhiInst>();
+        if (phi == nullptr) {
+            break;
+        }
+        phis.push_back(phi);
+    }
+    return phis;
+}
+
+// Returns the value that a value used in a block has when the block is entered from the given predecessor.
+ir::Value *value_from(ir::Value *value, const ir::BasicBlock *block, const ir::BasicBlock *pred) {
+    const auto phis = phis_of(block);
+    if (std::find(phis.begin(), phis.end(), value) != phis.end()) {
+        return value->as_non_null<ir::PhiInst>()->incoming_value(pred);
+    }
+    return value;
+}
+
+// Constants aren't shared, so two different constants can still be the same value.
+bool is_same_value(const ir::Value *lhs, const ir::Value *rhs) {
+    if (lhs == rhs) {
+        return true;
+    }
+    const auto *lhs_constant = lhs->as<ir::Constant>();
+    const auto *rhs_constant = rhs->as<ir::Constant>();
+    return lhs_constant != nullptr && rhs_constant != nullptr && lhs_constant->type() == rhs_constant->type() &&
+           lhs_constant->value() == rhs_constant->value();
+}
+
+class CfgSimplifier {
+    ir::Function &m_function;
+    Graph<ir::BasicBlock> m_cfg;
+    std::unordered_set<const ir::BasicBlock *> m_removed;
+
+    bool branches_to(const ir::BasicBlock *src, const ir::BasicBlock *dst) const;
+    void redirect(ir::BasicBlock *pred, ir::BasicBlock *block, ir::BasicBlock *dst);
+    void remove_block(ir::BasicBlock *block);
+    bool is_threadable(ir::BasicBlock *block) const;
+    ir::BasicBlock *known_target(ir::BasicBlock *block, ir::BasicBlock *pred) const;
+
+    bool merge_into_pred(ir::BasicBlock *block);
+    bool bypass(ir::BasicBlock *block);
+    bool fold_coinciding_arms(ir::BasicBlock *block);
+    bool thread_known_conditions(ir::BasicBlock *block);
+
+public:
+    explicit CfgSimplifier(ir::Function &function) : m_function(function), m_cfg(ir::build_cfg(function)) {}
+
+    bool run();
+};
+
+bool CfgSimplifier::branches_to(const ir::BasicBlock *src, const ir::BasicBlock *dst) const {
+    const auto &succs = m_cfg.succs(src);
+    return std::find(succs.begin(), succs.end(), dst) != succs.end();
+}
+
+// Makes a predecessor of a block branch to dst instead. The phis of dst are left to the caller.
+void CfgSimplifier::redirect(ir::BasicBlock *pred, ir::BasicBlock *block, ir::BasicBlock *dst) {
+    for (auto *phi : phis_of(block)) {
+        phi->remove_incoming(pred);
+    }
+    pred->terminator()->replace_uses_of_with(block, dst);
+    m_cfg.disconnect(pred, block);
+    m_cfg.connect(pred, dst);
+}
+
+void CfgSimplifier::remove_block(ir::BasicBlock *block) {
+    const auto succs = m_cfg.succs(block);
+    for (auto *succ : succs) {
+        m_cfg.disconnect(block, succ);
+    }
+    m_removed.insert(block);
+    m_function.remove_block(block);
+}
+
+// Appends a block to its only predecessor when that doesn't branch anywhere else.
+bool CfgSimplifier::merge_into_pred(ir::BasicBlock *block) {
+    const auto &preds = m_cfg.preds(block);
+    if (block == m_cfg.entry() || preds.size() != 1) {
+        return false;
+    }
+    auto *pred = preds[0];
+    if (pred == block || m_cfg.succs(pred).size() != 1) {
+        return false;
+    }
+
+    for (auto *phi : phis_of(block)) {
+        phi->replace_all_uses_with(phi->incoming_value(pred));
+        block->remove(phi);
+    }
+    pred->remove(pred->terminator());
+    pred->splice(block);
+    m_cfg.disconnect(pred, block);
+    const auto succs = m_cfg.succs(block);
+    for (auto *succ : succs) {
+        m_cfg.disconnect(block, succ);
+        m_cfg.connect(pred, succ);
+    }
+
+    // The only uses left are the incoming blocks of phis in the successors.
+    block->replace_all_uses_with(pred);
+    m_removed.insert(block);
+    m_function.remove_block(block);
+    return true;
+}
+
+// Sends the predecessors of a block that does nothing but branch on straight to its successor. This is skipped when one
+// of the predecessors already branches to the successor, since a conditional branch can't have the same block as both
+// of its targets and phis couldn't tell the two edges apart anyway.
+bool CfgSimplifier::bypass(ir::BasicBlock *block) {
+    auto *branch = (*block->begin())->as<ir::BranchInst>();
+    if (block == m_cfg.entry() || branch == nullptr || branch->dst() == block) {
+        return false;
+    }
+    auto *dst = branch->dst();
+    const auto preds = m_cfg.preds(block);
+    if (std::any_of(preds.begin(), preds.end(), [&](ir::BasicBlock *pred) {
+            return branches_to(pred, dst);
+        })) {
+        return false;
+    }
+
+    for (auto *phi : phis_of(dst)) {
+        auto *value = phi->incoming_value(block);
+        phi->remove_incoming(block);
+        for (auto *pred : preds) {
+            phi->add_incoming(pred, value);
+        }
+    }
+    for (auto *pred : preds) {
+        redirect(pred, block, dst);
+    }
+    remove_block(block);
+    return true;
+}
+
+// Turns a conditional branch into a plain branch when both arms end up at the same block, either directly or through a
+// block that only branches on, with the same values for its phis.
+bool CfgSimplifier::fold_coinciding_arms(ir::BasicBlock *block) {
+    auto *cond_branch = block->terminator()->as<ir::CondBranchInst>();
+    if (cond_branch == nullptr) {
+        return false;
+    }
+    const std::array arms{cond_branch->true_dst(), cond_branch->false_dst()};
+    auto forwarded_dst = [](ir::BasicBlock *arm) {
+        auto *branch = (*arm->begin())->as<ir::BranchInst>();
+        return branch != nullptr ? branch->dst() : nullptr;
+    };
+
+    // The block that an arm enters the common target from, if it gets there at all.
+    auto edge_into = [&](ir::BasicBlock *arm, ir::BasicBlock *target) -> ir::BasicBlock * {
+        if (arm == target) {
+            return block;
+        }
+        return forwarded_dst(arm) == target ? arm : nullptr;
+    };
+    ir::BasicBlock *target = nullptr;
+    for (auto *candidate : {arms[0], arms[1], forwarded_dst(arms[0]), forwarded_dst(arms[1])}) {
+        if (candidate != nullptr && edge_into(arms[0], candidate) != nullptr &&
+            edge_into(arms[1], candidate) != nullptr) {
+            target = candidate;
+            break;
+        }
+    }
+    if (target == nullptr) {
+        return false;
+    }
+
+    const auto phis = phis_of(target);
+    if (!std::all_of(phis.begin(), phis.end(), [&](ir::PhiInst *phi) {
+            return is_same_value(phi->incoming_value(edge_into(arms[0], target)),
+                                 phi->incoming_value(edge_into(arms[1], target)));
+        })) {
+        return false;
+    }
+    for (auto *phi : phis) {
+        if (phi->incoming_value(block) == nullptr) {
+            phi->add_incoming(block, phi->incoming_value(edge_into(arms[0], target)));
+        }
+    }
+    for (auto *arm : arms) {
+        m_cfg.disconnect(block, arm);
+    }
+    m_cfg.connect(block, target);
+    block->remove(cond_branch);
+    block->append<ir::BranchInst>(target);
+    return true;
+}
+
+// A block can be skipped by a predecessor that decides its condition when it does nothing other than work out the
+// condition from its phis, and nothing past it needs to know that it was passed through other than the phis of its
+// successors, which then take the values from the predecessor instead.
+bool CfgSimplifier::is_threadable(ir::BasicBlock *block) const {
+    auto *cond_branch = block->terminator()->as<ir::CondBranchInst>();
+    if (cond_branch == nullptr) {
+        return false;
+    }
+    std::unordered_set<const ir::Value *> local_users;
+    for (auto *inst : *block) {
+        local_users.insert(inst);
+    }
+    for (auto *succ : m_cfg.succs(block)) {
+        for (auto *phi : phis_of(succ)) {
+            local_users.insert(phi);
+        }
+    }
+    for (auto *inst : *block) {
+        if (inst == cond_branch) {
+            continue;
+        }
+        const bool is_condition = inst == cond_branch->cond() && inst->is<ir::CompareInst>();
+        if (!inst->is<ir::PhiInst>() && !is_condition) {
+            return false;
+        }
+        for (auto *user : inst->users()) {
+            if (!local_users.contains(user)) {
+                return false;
+            }
+            auto *phi = user->as<ir::PhiInst>();
+            if (phi == nullptr) {
+                continue;
+            }
+            if (is_condition || std::any_of(phi->incoming().begin(), phi->incoming().end(), [&](const auto &incoming) {
+                    return incoming.second == inst && incoming.first != block;
+                })) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Returns the block that a threadable block always goes on to when entered from the given predecessor, or null if that
+// isn't known.
+ir::BasicBlock *CfgSimplifier::known_target(ir::BasicBlock *block, ir::BasicBlock *pred) const {
+    auto *cond_branch = block->terminator()->as_non_null<ir::CondBranchInst>();
+    auto *cond = value_from(cond_branch->cond(), block, pred);
+    bool taken;
+    if (auto *compare = cond->as<ir::CompareInst>()) {
+        auto *lhs = value_from(compare->lhs(), block, pred)->as<ir::Constant>();
+        auto *rhs = value_from(compare->rhs(), block, pred)->as<ir::Constant>();
+        if (lhs == nullptr || rhs == nullptr) {
+            return nullptr;
+        }
+        const auto width = bit_width(lhs->type());
+        taken = fold_compare(compare->op(), truncate(lhs->value(), width), truncate(rhs->value(), width), width);
+    } else if (auto *constant = cond->as<ir::Constant>()) {
+        taken = truncate(constant->value(), 1) != 0;
+    } else {
+        return nullptr;
+    }
+    return taken ? cond_branch->true_dst() : cond_branch->false_dst();
+}
+
+bool CfgSimplifier::thread_known_conditions(ir::BasicBlock *block) {
+    if (!is_threadable(block)) {
+        return false;
+    }
+    bool changed = false;
+    const auto preds = m_cfg.preds(block);
+    for (auto *pred : preds) {
+        auto *dst = known_target(block, pred);
+        if (dst == nullptr || dst == block || branches_to(pred, dst)) {
+            continue;
+        }
+        for (auto *phi : phis_of(dst)) {
+            phi->add_incoming(pred, value_from(phi->incoming_value(block), block, pred));
+        }
+        redirect(pred, block, dst);
+        changed = true;
+    }
+    return changed;
+}
+
+bool CfgSimplifier::run() {
+    std::vector<ir::BasicBlock *> blocks;
+    for (auto *block : m_function) {
+        blocks.push_back(block);
+    }
+    bool changed = false;
+    for (auto *block : blocks) {
+        if (m_removed.contains(block)) {
+            continue;
+        }
+        if (merge_into_pred(block) || bypass(block) || fold_coinciding_arms(block) ||
+            thread_known_conditions(block)) {
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+void simplify_cfg(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    bool changed = true;
+    while (changed) {
+        ir::remove_unreachable_blocks(function);
+        changed = CfgSimplifier(function).run();
+    }
+}
+
+} // namespace coel::opt
@@ -0,0 +1,228 @@
+#include <coel/opt/StackPromotion.hh>
+
+#include <coel/graph/DominanceComputer.hh>
+#include <coel/graph/DominatorTree.hh>
+#include <coel/graph/Graph.hh>
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/StackSlot.hh>
+#include <coel/ir/Types.hh>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+const ir::Type *slot_type(const ir::StackSlot *stack_slot) {
+    return stack_slot->type()->as_non_null<ir::PointerType>()->pointee_type();
+}
+
+// A stack slot can be promoted if its address is only used to load from and store to it.
+bool is_promotable(const ir::StackSlot *stack_slot) {
+    return slot_type(stack_slot)->kind() != ir::TypeKind::Pointer && !stack_slot->is_address_taken();
+}
+
+class StackPromoter {
+    ir::Function &m_function;
+    const Graph<ir::BasicBlock> m_cfg;
+    const DominatorTree<ir::BasicBlock> m_tree;
+
+    // The values currently held by the promoted slots during renaming, innermost last.
+    std::unordered_map<const ir::Value *, std::vector<ir::Value *>> m_stacks;
+    std::unordered_map<ir::PhiInst *, std::pair<ir::BasicBlock *, ir::StackSlot *>> m_phis;
+
+    ir::Value *current_value(ir::StackSlot *stack_slot) const;
+    void insert_phis(const std::vector<ir::StackSlot *> &stack_slots);
+    void rename(ir::BasicBlock *block);
+    void remove_unreachable_accesses();
+    void simplify_phis();
+
+public:
+    explicit StackPromoter(ir::Function &function)
+        : m_function(function), m_cfg(ir::build_cfg(function)), m_tree(m_cfg.run<DominanceComputer>()) {}
+
+    void run();
+};
+
+ir::Value *StackPromoter::current_value(ir::StackSlot *stack_slot) const {
+    const auto &stack = m_stacks.at(stack_slot);
+    return !stack.empty() ? stack.back() : ir::Constant::get(slot_type(stack_slot), 0);
+}
+
+void StackPromoter::insert_phis(const std::vector<ir::StackSlot *> &stack_slots) {
+    std::unordered_map<const ir::StackSlot *, std::vector<ir::BasicBlock *>> def_blocks;
+    for (auto *block : m_function) {
+        if (!m_tree.contains(block)) {
+            continue;
+        }
+        for (auto *inst : *block) {
+            auto *store = inst->as<ir::StoreInst>();
+            if (store != nullptr && m_stacks.contains(store->ptr())) {
+                auto &blocks = def_blocks[store->ptr()->as_non_null<ir::StackSlot>()];
+                if (blocks.empty() || blocks.back() != block) {
+                    blocks.push_back(block);
+                }
+            }
+        }
+    }
+
+    const auto frontiers = m_tree.frontiers(m_cfg);
+    for (auto *stack_slot : stack_slots) {
+        auto worklist = def_blocks[stack_slot];
+        std::unordered_set<const ir::BasicBlock *> visited(worklist.begin(), worklist.end());
+        std::unordered_set<const ir::BasicBlock *> has_phi;
+        while (!worklist.empty()) {
+            auto *block = worklist.back();
+            worklist.pop_back();
+            auto it = frontiers.find(block);
+            if (it == frontiers.end()) {
+                continue;
+            }
+            for (auto *frontier : it->second) {
+                if (!has_phi.insert(frontier).second) {
+                    continue;
+                }
+                auto *phi = frontier->prepend<ir::PhiInst>(slot_type(stack_slot));
+                m_phis.emplace(phi, std::make_pair(frontier, stack_slot));
+                if (visited.insert(frontier).second) {
+                    worklist.push_back(frontier);
+                }
+            }
+        }
+    }
+}
+
+void StackPromoter::rename(ir::BasicBlock *block) {
+    std::vector<ir::StackSlot *> pushed;
+    for (auto it = block->begin(); it != block->end();) {
+        auto *inst = *it;
+        ++it;
+        if (auto *phi = inst->as<ir::PhiInst>()) {
+            if (auto phi_it = m_phis.find(phi); phi_it != m_phis.end()) {
+                m_stacks.at(phi_it->second.second).push_back(phi);
+                pushed.push_back(phi_it->second.second);
+            }
+        } else if (auto *load = inst->as<ir::LoadInst>(); load != nullptr && m_stacks.contains(load->ptr())) {
+            load->replace_all_uses_with(current_value(load->ptr()->as_non_null<ir::StackSlot>()));
+            block->remove(load);
+        } else if (auto *store = inst->as<ir::StoreInst>(); store != nullptr && m_stacks.contains(store->ptr())) {
+            auto *stack_slot = store->ptr()->as_non_null<ir::StackSlot>();
+            m_stacks.at(stack_slot).push_back(store->value());
+            pushed.push_back(stack_slot);
+            block->remove(store);
+        }
+    }
+
+    for (auto *succ : m_cfg.succs(block)) {
+        for (auto *inst : *succ) {
+            auto *phi = inst->as<ir::PhiInst>();
+            if (phi == nullptr) {
+                break;
+            }
+            if (auto it = m_phis.find(phi); it != m_phis.end()) {
+                phi->add_incoming(block, current_value(it->second.second));
+            }
+        }
+    }
+    for (auto *child : m_tree.succs(block)) {
+        rename(child);
+    }
+    for (auto *stack_slot : pushed) {
+        m_stacks.at(stack_slot).pop_back();
+    }
+}
+
+// Unreachable blocks aren't renamed, but their accesses still need to go before the slots can.
+void StackPromoter::remove_unreachable_accesses() {
+    for (auto *block : m_function) {
+        if (m_tree.contains(block)) {
+            continue;
+        }
+        for (auto it = block->begin(); it != block->end();) {
+            auto *inst = *it;
+            ++it;
+            if (auto *load = inst->as<ir::LoadInst>(); load != nullptr && m_stacks.contains(load->ptr())) {
+                load->replace_all_uses_with(ir::Constant::get(load->type(), 0));
+                block->remove(load);
+            } else if (auto *store = inst->as<ir::StoreInst>(); store != nullptr && m_stacks.contains(store->ptr())) {
+                block->remove(store);
+            }
+        }
+    }
+}
+
+// Phis are placed wherever a store might merge, so many of them end up unused or merging the same value from every
+// predecessor. Those get removed, which can in turn make others trivial.
+void StackPromoter::simplify_phis() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = m_phis.begin(); it != m_phis.end();) {
+            auto [phi, location] = *it;
+            ir::Value *unique = nullptr;
+            bool trivial = true;
+            for (auto [pred, value] : phi->incoming()) {
+                if (value != phi && value != unique) {
+                    trivial = unique == nullptr;
+                    unique = value;
+                }
+                if (!trivial) {
+                    break;
+                }
+            }
+            const bool unused = std::all_of(phi->users().begin(), phi->users().end(), [phi](ir::Value *user) {
+                return user == phi;
+            });
+            if (!trivial && !unused) {
+                ++it;
+                continue;
+            }
+            if (unused) {
+                phi->replace_all_uses_with(nullptr);
+            } else {
+                phi->replace_all_uses_with(unique != nullptr ? unique : ir::Constant::get(phi->type(), 0));
+            }
+            location.first->remove(phi);
+            it = m_phis.erase(it);
+            changed = true;
+        }
+    }
+}
+
+void StackPromoter::run() {
+    std::vector<ir::StackSlot *> stack_slots;
+    for (auto *stack_slot : m_function.stack_slots()) {
+        if (is_promotable(stack_slot)) {
+            stack_slots.push_back(stack_slot);
+            m_stacks[stack_slot];
+        }
+    }
+    if (stack_slots.empty()) {
+        return;
+    }
+
+    insert_phis(stack_slots);
+    rename(m_cfg.entry());
+    remove_unreachable_accesses();
+    simplify_phis();
+    for (auto *stack_slot : stack_slots) {
+        m_function.remove_stack_slot(stack_slot);
+    }
+}
+
+} // namespace
+
+void promote_stack_slots(ir::Function &function) {
+    if (function.is_external()) {
+        return;
+    }
+    StackPromoter(function).run();
+}
+
+} // namespace coel::opt
@@ -10,25 +10,48 @@
 #include <coel/ir/Unit.hh>
 #include <coel/support/Assert.hh>
 #include <coel/x86/Builder.hh>
+#include <coel/x86/InstStream.hh>
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachinePasses.hh>
 #include <coel/x86/Register.hh>
 
+#include <algorithm>
+#include <deque>
+#include <limits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace coel::x86 {
 namespace {
 
+std::size_t align_up(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 class Compiler final : public ir::InstVisitor {
     const ir::Function *m_function{nullptr};
-    const ir::BasicBlock *m_block{nullptr};
+    MachineFunction m_machine_function;
+    MachineBasicBlock *m_block{nullptr};
+    std::uint64_t *const m_counter;
+    bool m_has_frame{false};
+    std::unordered_set<const ir::BasicBlock *> m_emitted_blocks;
+    // Targets of conditional back edges, which branch to an out-of-line counter increment first. The addresses of the
+    // elements are used as labels.
+    std::deque<const ir::BasicBlock *> m_back_edges;
     std::unordered_map<const ir::StackSlot *, std::int32_t> m_stack_offsets;
-    std::vector<MachineInst> m_insts;
+    // Callee-saved registers used by the function and the frame offsets they're saved at.
+    std::vector<std::pair<Register, std::int32_t>> m_saved_registers;
 
     Builder emit(Opcode opcode);
+    void emit_counter_increment();
+    const void *cond_branch_target(const ir::BasicBlock *dst);
     void emit_rhs(Builder inst, ir::Value *rhs);
     std::uint8_t type_width(const ir::Type *type);
 
 public:
+    explicit Compiler(std::uint64_t *counter) : m_counter(counter) {}
+
     void run(const ir::Function *function);
     void visit(ir::BinaryInst *) override;
     void visit(ir::BranchInst *) override;
@@ -37,16 +60,28 @@ public:
     void visit(ir::CondBranchInst *) override;
     void visit(ir::CopyInst *) override;
     void visit(ir::LoadInst *) override {}
+    void visit(ir::PhiInst *) override { COEL_ENSURE_NOT_REACHED(); }
     void visit(ir::RetInst *) override;
     void visit(ir::StoreInst *) override;
 
-    std::vector<MachineInst> &insts() { return m_insts; }
+    MachineFunction &machine_function() { return m_machine_function; }
 };
 
 Builder Compiler::emit(Opcode opcode) {
-    auto &inst = m_insts.emplace_back();
-    inst.opcode = opcode;
-    return Builder(&inst);
+    return m_block->append(opcode);
+}
+
+void Compiler::emit_counter_increment() {
+    if (m_counter != nullptr) {
+        emit(Opcode::Add).abs(m_counter).imm(1).width(64);
+    }
+}
+
+const void *Compiler::cond_branch_target(const ir::BasicBlock *dst) {
+    if (m_counter == nullptr || !m_emitted_blocks.contains(dst)) {
+        return dst;
+    }
+    return &m_back_edges.emplace_back(dst);
 }
 
 void Compiler::emit_rhs(Builder inst, ir::Value *rhs) {
@@ -65,41 +100,81 @@ void Compiler::emit_rhs(Builder inst, ir::Value *rhs) {
 }
 
 std::uint8_t Compiler::type_width(const ir::Type *type) {
+    // Narrower values are computed on in 32-bit registers to avoid operand size prefixes and partial register writes.
+    // Bools are kept zero-extended, whereas the bits above the width of a narrow integer are undefined.
     if (const auto *bool_type = type->as<ir::BoolType>()) {
-        return 16;
+        return 32;
     }
     if (const auto *integer_type = type->as<ir::IntegerType>()) {
-        // TODO: Remove this once 8-bit is properly supported/most of it is legalised away anyway.
-        if (integer_type->bit_width() == 8) {
-            return 16;
-        }
-        return integer_type->bit_width();
+        return static_cast<std::uint8_t>(std::max(integer_type->bit_width(), 32u));
     }
     COEL_ENSURE_NOT_REACHED();
 }
 
 void Compiler::run(const ir::Function *function) {
     m_function = function;
-    emit(Opcode::Lbl).lbl(function);
-    if (!function->stack_slots().empty()) {
+    m_block = m_machine_function.append_block(function);
+
+    // The counter increment comes first so that the entry is a single instruction long enough to be overwritten with a
+    // jmp rel32 whilst other threads may be executing the function.
+    emit_counter_increment();
+
+    // Calls require the stack to be 16-byte aligned, so functions that make any need a frame even without stack slots.
+    m_has_frame = !function->stack_slots().empty();
+    std::vector<Register> callee_saved;
+    for (const auto *block : *function) {
+        for (auto *inst : *block) {
+            m_has_frame |= inst->is<ir::CallInst>();
+            if (const auto *copy = inst->as<ir::CopyInst>()) {
+                const auto reg = static_cast<Register>(copy->dst()->reg());
+                const bool is_callee_saved = reg == Register::rbx || reg == Register::r12 || reg == Register::r13 ||
+                                             reg == Register::r14 || reg == Register::r15;
+                if (is_callee_saved && std::find(callee_saved.begin(), callee_saved.end(), reg) == callee_saved.end()) {
+                    callee_saved.push_back(reg);
+                }
+            }
+        }
+    }
+    m_has_frame |= !callee_saved.empty();
+    m_saved_registers.clear();
+    if (m_has_frame) {
         std::size_t frame_size = 0;
-        for (std::int32_t offset = 0; const auto *stack_slot : function->stack_slots()) {
+        std::int32_t offset = 0;
+        for (const auto *stack_slot : function->stack_slots()) {
             const std::uint8_t size =
                 type_width(stack_slot->type()->as_non_null<ir::PointerType>()->pointee_type()) / 8;
             frame_size += size;
             offset -= size;
             m_stack_offsets.emplace(stack_slot, offset);
         }
+        for (auto reg : callee_saved) {
+            frame_size = align_up(frame_size, 8) + 8;
+            offset = -static_cast<std::int32_t>(frame_size);
+            m_saved_registers.emplace_back(reg, offset);
+        }
+        frame_size = align_up(frame_size, 16);
         emit(Opcode::Push).reg(Register::rbp).width(64);
         emit(Opcode::Mov).reg(Register::rbp).reg(Register::rsp).width(64);
-        emit(Opcode::Sub).reg(Register::rsp).imm(frame_size).width(64);
+        if (frame_size != 0) {
+            emit(Opcode::Sub).reg(Register::rsp).imm(frame_size).width(64);
+        }
+        for (auto [reg, reg_offset] : m_saved_registers) {
+            emit(Opcode::Mov).base_disp(Register::rbp, reg_offset).reg(reg).width(64);
+        }
     }
     for (auto *block : *function) {
-        emit(Opcode::Lbl).lbl(m_block = block);
+        m_block = m_machine_function.append_block(block);
+        m_emitted_blocks.insert(block);
         for (auto *inst : *block) {
             inst->accept(this);
         }
     }
+    for (const auto &dst : m_back_edges) {
+        m_block = m_machine_function.append_block(&dst);
+        emit_counter_increment();
+        emit(Opcode::JmpLbl).lbl(dst);
+    }
+    m_back_edges.clear();
 }
 
 void Compiler::visit(ir::BinaryInst *binary) {
@@ -118,9 +193,10 @@ void Compiler::visit(ir::BinaryInst *binary) {
 }
 
 void Compiler::visit(ir::BranchInst *branch) {
-    if (branch->dst() != m_block->next()) {
-        emit(Opcode::JmpLbl).lbl(branch->dst());
+    if (m_emitted_blocks.contains(branch->dst())) {
+        emit_counter_increment();
     }
+    emit(Opcode::JmpLbl).lbl(branch->dst());
 }
 
 void Compiler::visit(ir::CallInst *call) {
@@ -130,8 +206,37 @@ void Compiler::visit(ir::CallInst *call) {
 void Compiler::visit(ir::CompareInst *compare) {
     const auto *lhs = compare->lhs()->as_non_null<codegen::Register>();
     COEL_ASSERT(lhs->physical());
-    auto cmp = emit(Opcode::Cmp).reg(static_cast<Register>(lhs->reg())).width(type_width(lhs->type()));
-    emit_rhs(cmp, compare->rhs());
+    const auto lhs_reg = static_cast<Register>(lhs->reg());
+
+    // Narrow integers are extended to 32 bits in place first, which is fine since their upper bits are undefined.
+    const auto *integer_type = lhs->type()->as<ir::IntegerType>();
+    const auto narrow_width = integer_type != nullptr && integer_type->bit_width() < 32 ? integer_type->bit_width() : 0;
+    auto *constant = compare->rhs()->as<ir::Constant>();
+    const bool is_signed = compare->op() == ir::CompareOp::Lt || compare->op() == ir::CompareOp::Gt ||
+                           compare->op() == ir::CompareOp::Le || compare->op() == ir::CompareOp::Ge;
+    const auto extend = is_signed ? Opcode::Movsx : Opcode::Movzx;
+    if (narrow_width != 0) {
+        emit(extend).reg(lhs_reg).reg(lhs_reg).width(narrow_width);
+        if (const auto *rhs = compare->rhs()->as<codegen::Register>()) {
+            const auto rhs_reg = static_cast<Register>(rhs->reg());
+            emit(extend).reg(rhs_reg).reg(rhs_reg).width(narrow_width);
+        } else {
+            COEL_ASSERT(constant != nullptr, "Narrow compares are legalised to a register or constant rhs");
+        }
+    }
+    auto cmp = emit(Opcode::Cmp).reg(lhs_reg).width(type_width(lhs->type()));
+    if (narrow_width != 0 && constant != nullptr) {
+        const auto shift = 64u - narrow_width;
+        const auto value = static_cast<std::uint64_t>(constant->value()) << shift;
+        cmp.imm(is_signed ? static_cast<std::uint64_t>(static_cast<std::int64_t>(value) >> shift) : value >> shift);
+    } else {
+        emit_rhs(cmp, compare->rhs());
+    }
+
+    // Compares still used by their branch after legalisation are fused with it, so the flags are used directly.
+    if (!compare->users().empty()) {
+        return;
+    }
     auto opcode = [](ir::CompareOp op) -> Opcode {
         switch (op) {
         case ir::CompareOp::Eq:
@@ -146,23 +251,56 @@ void Compiler::visit(ir::CompareInst *compare) {
             return Opcode::Setle;
         case ir::CompareOp::Ge:
             return Opcode::Setge;
+        case ir::CompareOp::ULt:
+            return Opcode::Setb;
+        case ir::CompareOp::UGt:
+            return Opcode::Seta;
+        case ir::CompareOp::ULe:
+            return Opcode::Setbe;
+        case ir::CompareOp::UGe:
+            return Opcode::Setae;
         }
     };
-    emit(opcode(compare->op())).reg(static_cast<Register>(lhs->reg())).width(8);
+    emit(opcode(compare->op())).reg(lhs_reg).width(8);
+    emit(Opcode::Movzx).reg(lhs_reg).reg(lhs_reg).width(8);
 }
 
 void Compiler::visit(ir::CondBranchInst *cond_branch) {
+    if (const auto *compare = cond_branch->cond()->as<ir::CompareInst>()) {
+        auto opcode = [](ir::CompareOp op) -> Opcode {
+            switch (op) {
+            case ir::CompareOp::Eq:
+                return Opcode::JeLbl;
+            case ir::CompareOp::Ne:
+                return Opcode::JneLbl;
+            case ir::CompareOp::Lt:
+                return Opcode::JlLbl;
+            case ir::CompareOp::Gt:
+                return Opcode::JgLbl;
+            case ir::CompareOp::Le:
+                return Opcode::JleLbl;
+            case ir::CompareOp::Ge:
+                return Opcode::JgeLbl;
+            case ir::CompareOp::ULt:
+                return Opcode::JbLbl;
+            case ir::CompareOp::UGt:
+                return Opcode::JaLbl;
+            case ir::CompareOp::ULe:
+                return Opcode::JbeLbl;
+            case ir::CompareOp::UGe:
+                return Opcode::JaeLbl;
+            }
+            COEL_ENSURE_NOT_REACHED();
+        };
+        emit(opcode(compare->op())).lbl(cond_branch_target(cond_branch->true_dst()));
+        emit(Opcode::JmpLbl).lbl(cond_branch_target(cond_branch->false_dst()));
+        return;
+    }
     const auto *cond = cond_branch->cond()->as_non_null<codegen::Register>();
     COEL_ASSERT(cond->physical());
     emit(Opcode::Cmp).reg(static_cast<Register>(cond->reg())).imm(1).width(type_width(cond->type()));
-    if (cond_branch->true_dst() == m_block->next()) {
-        emit(Opcode::JneLbl).lbl(cond_branch->false_dst());
-    } else {
-        emit(Opcode::JeLbl).lbl(cond_branch->true_dst());
-        if (cond_branch->false_dst() != m_block->next()) {
-            emit(Opcode::JmpLbl).lbl(cond_branch->false_dst());
-        }
-    }
+    emit(Opcode::JeLbl).lbl(cond_branch_target(cond_branch->true_dst()));
+    emit(Opcode::JmpLbl).lbl(cond_branch_target(cond_branch->false_dst()));
 }
 
 void Compiler::visit(ir::CopyInst *copy) {
@@ -172,7 +310,10 @@ void Compiler::visit(ir::CopyInst *copy) {
 }
 
 void Compiler::visit(ir::RetInst *) {
-    if (!m_function->stack_slots().empty()) {
+    for (auto [reg, offset] : m_saved_registers) {
+        emit(Opcode::Mov).reg(reg).base_disp(Register::rbp, offset).width(64);
+    }
+    if (m_has_frame) {
         emit(Opcode::Leave);
     }
     emit(Opcode::Ret);
@@ -188,73 +329,199 @@ void Compiler::visit(ir::StoreInst *store) {
 
 } // namespace
 
-std::vector<MachineInst> compile(const ir::Unit &unit) {
-    Compiler compiler;
+MachineFunction select(const ir::Function &function, std::uint64_t *counter) {
+    Compiler compiler(counter);
+    compiler.run(&function);
+    return std::move(compiler.machine_function());
+}
+
+void run_machine_passes(MachineFunction &function, MachinePassStats &stats) {
+    peephole(function, stats);
+    fold_branches(function, stats);
+}
+
+void flatten(const MachineFunction &function, InstStream &insts) {
+    for (const auto &block : function.blocks()) {
+        MachineInst label{};
+        Builder(&label).lbl(block->label());
+        label.opcode = Opcode::Lbl;
+        insts.push_back(label);
+        for (const auto &inst : block->insts()) {
+            insts.push_back(inst);
+        }
+    }
+}
+
+InstStream compile(const ir::Unit &unit, MachinePassStats *stats) {
+    MachinePassStats local_stats;
+    InstStream insts;
     for (const auto *function : unit) {
-        compiler.run(function);
+        if (function->is_external()) {
+            continue;
+        }
+        auto machine_function = select(*function);
+        run_machine_passes(machine_function, stats != nullptr ? *stats : local_stats);
+        flatten(machine_function, insts);
     }
-    return std::move(compiler.insts());
+    return insts;
 }
 
-std::pair<std::size_t, std::vector<std::uint8_t>> encode(const std::vector<MachineInst> &insts,
-                                                         const ir::Function *entry) {
-    std::unordered_map<const void *, std::size_t> label_map;
-    for (std::size_t length = 0; auto inst : insts) {
+InstStream compile(const ir::Function &function, std::uint64_t *counter, MachinePassStats *stats) {
+    MachinePassStats local_stats;
+    auto machine_function = select(function, counter);
+    run_machine_passes(machine_function, stats != nullptr ? *stats : local_stats);
+    InstStream insts;
+    flatten(machine_function, insts);
+    return insts;
+}
+
+Encoding encode(const InstStream &insts, std::uintptr_t base,
+                const std::unordered_map<const void *, std::uintptr_t> &symbols) {
+    Encoding encoding;
+    auto &label_map = encoding.label_offsets;
+    // Calls to symbols outside of the encoded instructions are emitted as a call rel32 when the target is in range from
+    // anywhere in the code, and as an indirect call through a constant pool placed after the code otherwise.
+    std::unordered_map<const void *, std::size_t> pool_map;
+    for (const auto &inst : insts) {
+        if (inst.opcode == Opcode::Lbl) {
+            label_map.emplace(inst.operands[0].lbl, 0);
+        }
+    }
+    for (const auto &inst : insts) {
+        if (inst.opcode == Opcode::CallLbl && !label_map.contains(inst.operands[0].lbl)) {
+            pool_map.emplace(inst.operands[0].lbl, pool_map.size());
+        }
+    }
+
+    std::size_t code_size = 0;
+    auto pool_offset = [&](const void *symbol) {
+        return align_up(code_size, 8) + pool_map.at(symbol) * 8;
+    };
+    auto lower = [&](MachineInst &inst, std::size_t offset) {
+        auto relative = [offset](std::size_t target) {
+            return static_cast<std::int64_t>(target - offset);
+        };
+        const auto *label = inst.operands[0].lbl;
         switch (inst.opcode) {
-        case Opcode::Lbl:
-            label_map.emplace(inst.operands[0].lbl, length);
-            continue;
         case Opcode::CallLbl:
-            inst.opcode = Opcode::Call;
-            inst.operands[0].type = OperandType::Off;
-            inst.operands[0].off = 0;
-            break;
-        case Opcode::JeLbl:
-        case Opcode::JmpLbl:
-        case Opcode::JneLbl:
-            inst.opcode = Opcode::Jmp;
-            inst.operands[0].type = OperandType::Off;
-            inst.operands[0].off = 0;
+            if (label_map.contains(label)) {
+                inst.opcode = Opcode::Call;
+                inst.operands[0].off = relative(label_map.at(label));
+            } else if (pool_map.contains(label)) {
+                inst.opcode = Opcode::CallInd;
+                inst.operands[0].off = relative(pool_offset(label));
+            } else {
+                inst.opcode = Opcode::Call;
+                inst.operands[0].off = static_cast<std::int64_t>(symbols.at(label) - (base + offset));
+            }
             break;
         default:
-            break;
+            if (is_label_jump(inst.opcode)) {
+                inst.opcode = resolve_label_jump(inst.opcode);
+                inst.operands[0].off = relative(label_map.at(label));
+                break;
+            }
+            for (auto &operand : inst.operands) {
+                if (operand.type == OperandType::Abs) {
+                    const auto address = reinterpret_cast<std::uintptr_t>(operand.abs);
+                    const auto disp = static_cast<std::int64_t>(address - (base + offset));
+                    COEL_ASSERT(disp >= std::numeric_limits<std::int32_t>::min() &&
+                                disp <= std::numeric_limits<std::int32_t>::max());
+                    operand.type = OperandType::Off;
+                    operand.off = disp;
+                }
+            }
+            return;
         }
-        std::array<std::uint8_t, 16> encoded{};
-        length += encode(inst, encoded);
+        inst.operands[0].type = OperandType::Off;
+    };
+    // Jumps are encoded with a rel8 when their target is close enough and a rel32 otherwise. Every jump starts out
+    // assumed to be short, and the layout is redone with the label offsets from the previous round until they stop
+    // moving. An instruction never gets shorter between rounds so that this terminates; one that would is padded with
+    // nops instead.
+    std::vector<std::uint8_t> lengths;
+    auto layout = [&](bool assume_short) {
+        std::size_t length = 0;
+        for (std::size_t i = 0; auto inst : insts) {
+            const auto index = i++;
+            if (inst.opcode == Opcode::Lbl) {
+                label_map[inst.operands[0].lbl] = length;
+                continue;
+            }
+            lower(inst, length);
+            const bool jump = is_cond_jump(inst.opcode) || inst.opcode == Opcode::Jmp;
+            if (assume_short && jump && inst.operands[0].type == OperandType::Off) {
+                inst.operands[0].off = 0;
+            }
+            std::array<std::uint8_t, 16> encoded{};
+            lengths[index] = std::max(lengths[index], encode(inst, encoded));
+            length += lengths[index];
+        }
+        return length;
+    };
+    auto relax = [&] {
+        lengths.assign(insts.size(), 0);
+        layout(true);
+        std::unordered_map<const void *, std::size_t> previous;
+        do {
+            previous = label_map;
+            code_size = layout(false);
+        } while (label_map != previous);
+    };
+
+    // Lay out the code with every external call going through the pool to get an upper bound on the code size, then
+    // only keep the targets that aren't reachable with a rel32 from both ends of the code in the pool.
+    relax();
+    const std::uintptr_t end = base + align_up(code_size, 8) + pool_map.size() * 8;
+    auto in_range = [](std::uintptr_t target, std::uintptr_t from) {
+        const auto displacement = static_cast<std::int64_t>(target - from);
+        return displacement >= std::numeric_limits<std::int32_t>::min() &&
+               displacement <= std::numeric_limits<std::int32_t>::max();
+    };
+    std::erase_if(pool_map, [&](const auto &entry) {
+        const auto target = symbols.at(entry.first);
+        return in_range(target, base) && in_range(target, end);
+    });
+    for (std::size_t index = 0; auto &[symbol, slot] : pool_map) {
+        slot = index++;
     }
+    relax();
 
-    std::vector<std::uint8_t> ret;
-    for (auto inst : insts) {
-        bool is_control_flow = true;
-        switch (inst.opcode) {
-        case Opcode::Lbl:
+    auto &ret = encoding.code;
+    for (std::size_t i = 0; const auto &original : insts) {
+        const auto index = i++;
+        if (original.opcode == Opcode::Lbl) {
             continue;
-        case Opcode::CallLbl:
-            inst.opcode = Opcode::Call;
-            break;
-        case Opcode::JeLbl:
-            inst.opcode = Opcode::Je;
-            break;
-        case Opcode::JmpLbl:
-            inst.opcode = Opcode::Jmp;
-            break;
-        case Opcode::JneLbl:
-            inst.opcode = Opcode::Jne;
-            break;
-        default:
-            is_control_flow = false;
-            break;
         }
-        if (is_control_flow) {
-            inst.operands[0].type = OperandType::Off;
-            inst.operands[0].off = static_cast<std::int64_t>(label_map.at(inst.operands[0].lbl) - ret.size());
+        auto inst = original;
+        lower(inst, ret.size());
+        if (original.opcode == Opcode::CallLbl && inst.opcode == Opcode::Call &&
+            !label_map.contains(original.operands[0].lbl)) {
+            encoding.external_calls.emplace_back(ret.size(), original.operands[0].lbl);
         }
         std::array<std::uint8_t, 16> encoded{};
         const auto length = encode(inst, encoded);
-        ret.resize(ret.size() + length);
-        std::copy_n(encoded.begin(), length, ret.end() - length);
+        COEL_ASSERT(length <= lengths[index]);
+        std::fill(encoded.begin() + length, encoded.begin() + lengths[index], 0x90);
+        ret.resize(ret.size() + lengths[index]);
+        std::copy_n(encoded.begin(), lengths[index], ret.end() - lengths[index]);
     }
-    return std::make_pair(label_map.at(entry), std::move(ret));
+    COEL_ASSERT(ret.size() == code_size);
+    if (!pool_map.empty()) {
+        ret.resize(align_up(code_size, 8) + pool_map.size() * 8, 0xcc);
+        for (const auto &[symbol, slot] : pool_map) {
+            const auto target = symbols.at(symbol);
+            for (std::size_t i = 0; i < 8; i++) {
+                ret[pool_offset(symbol) + i] = (target >> (i * 8)) & 0xffu;
+            }
+        }
+    }
+    return encoding;
+}
+
+std::pair<std::size_t, std::vector<std::uint8_t>> encode(const InstStream &insts, const ir::Function *entry) {
+    auto encoding = encode(insts, 0, {});
+    return std::make_pair(encoding.label_offsets.at(entry), std::move(encoding.code));
 }
 
 } // namespace coel::x86
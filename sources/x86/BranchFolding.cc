@@ -0,0 +1,30 @@
+#include <coel/x86/MachinePasses.hh>
+
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachineInst.hh>
+
+namespace coel::x86 {
+
+void fold_branches(MachineFunction &function, MachinePassStats &stats) {
+    const auto &blocks = function.blocks();
+    for (std::size_t i = 0; i + 1 < blocks.size(); i++) {
+        const auto *next = blocks[i + 1]->label();
+        auto &insts = blocks[i]->insts();
+        while (!insts.empty() && is_label_jump(insts.back().opcode) && insts.back().operands[0].lbl == next) {
+            insts.pop_back();
+            stats.jumps_to_next++;
+        }
+        if (insts.size() < 2 || insts.back().opcode != Opcode::JmpLbl) {
+            continue;
+        }
+        auto &cond_jump = insts[insts.size() - 2];
+        if (is_cond_jump(cond_jump.opcode) && cond_jump.operands[0].lbl == next) {
+            cond_jump.opcode = invert_cond_jump(cond_jump.opcode);
+            cond_jump.operands[0].lbl = insts.back().operands[0].lbl;
+            insts.pop_back();
+            stats.inverted_jumps++;
+        }
+    }
+}
+
+} // namespace coel::x86
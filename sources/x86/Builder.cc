@@ -7,6 +7,12 @@
 
 namespace coel::x86 {
 
+Builder Builder::abs(const void *op) {
+    m_inst->operands[m_operand_count].type = OperandType::Abs;
+    m_inst->operands[m_operand_count++].abs = op;
+    return *this;
+}
+
 Builder Builder::base_disp(Register base, std::int32_t disp) {
     m_inst->operands[m_operand_count].type = OperandType::BaseDisp;
     m_inst->operands[m_operand_count].base = base;
@@ -14,6 +20,15 @@ Builder Builder::base_disp(Register base, std::int32_t disp) {
     return *this;
 }
 
+Builder Builder::base_index_disp(Register base, Register index, std::uint8_t scale, std::int32_t disp) {
+    m_inst->operands[m_operand_count].type = OperandType::BaseIndexDisp;
+    m_inst->operands[m_operand_count].base = base;
+    m_inst->operands[m_operand_count].index = index;
+    m_inst->operands[m_operand_count].scale = scale;
+    m_inst->operands[m_operand_count++].disp = disp;
+    return *this;
+}
+
 Builder Builder::imm(std::uint64_t op) {
     m_inst->operands[m_operand_count].type = OperandType::Imm;
     m_inst->operands[m_operand_count++].imm = op;
@@ -0,0 +1,171 @@
+#include <coel/x86/InstStream.hh>
+
+#include <coel/support/Assert.hh>
+
+#include <cstring>
+#include <limits>
+
+namespace coel::x86 {
+namespace {
+
+// Set in an operand's type byte when its value is in the side table rather than inline.
+constexpr std::uint8_t k_wide_flag = 1u << 7u;
+
+std::int32_t read_int32(const std::uint8_t *bytes) {
+    std::int32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+InstStream::InstStream(const std::vector<MachineInst> &insts) {
+    for (const auto &inst : insts) {
+        push_back(inst);
+    }
+}
+
+void InstStream::push_index(std::uint64_t value) {
+    COEL_ASSERT(m_wide.size() <= std::numeric_limits<std::int32_t>::max());
+    push_int32(static_cast<std::int32_t>(m_wide.size()));
+    m_wide.push_back(value);
+}
+
+void InstStream::push_int32(std::int32_t value) {
+    const auto position = m_bytes.size();
+    m_bytes.resize(position + sizeof(value));
+    std::memcpy(&m_bytes[position], &value, sizeof(value));
+}
+
+void InstStream::push_back(const MachineInst &inst) {
+    // Operands are always filled in from the first one, so only the ones before the first None need storing.
+    std::uint8_t operand_count = 0;
+    while (operand_count < inst.operands.size() && inst.operands[operand_count].type != OperandType::None) {
+        operand_count++;
+    }
+    m_bytes.push_back(static_cast<std::uint8_t>(inst.opcode));
+    m_bytes.push_back(inst.operand_width);
+    m_bytes.push_back(operand_count);
+    for (std::uint8_t i = 0; i < operand_count; i++) {
+        const auto &operand = inst.operands[i];
+        const auto type = static_cast<std::uint8_t>(operand.type);
+        switch (operand.type) {
+        case OperandType::Abs:
+        case OperandType::Lbl:
+            m_bytes.push_back(type);
+            push_index(reinterpret_cast<std::uintptr_t>(operand.type == OperandType::Abs ? operand.abs : operand.lbl));
+            break;
+        case OperandType::BaseIndexDisp:
+            m_bytes.push_back(type);
+            m_bytes.push_back(operand.base);
+            m_bytes.push_back(operand.index);
+            m_bytes.push_back(operand.scale);
+            push_int32(operand.disp);
+            break;
+        case OperandType::BaseDisp:
+            m_bytes.push_back(type);
+            m_bytes.push_back(operand.base);
+            push_int32(operand.disp);
+            break;
+        case OperandType::Imm:
+        case OperandType::Off: {
+            const auto value = operand.type == OperandType::Imm ? static_cast<std::int64_t>(operand.imm) : operand.off;
+            const bool fits = value >= std::numeric_limits<std::int32_t>::min() &&
+                              value <= std::numeric_limits<std::int32_t>::max();
+            if (fits) {
+                m_bytes.push_back(type);
+                push_int32(static_cast<std::int32_t>(value));
+            } else {
+                m_bytes.push_back(type | k_wide_flag);
+                push_index(static_cast<std::uint64_t>(value));
+            }
+            break;
+        }
+        case OperandType::Reg:
+            m_bytes.push_back(type);
+            m_bytes.push_back(operand.reg);
+            break;
+        case OperandType::None:
+            COEL_ENSURE_NOT_REACHED();
+        }
+    }
+    m_size++;
+}
+
+InstStream::iterator InstStream::begin() const {
+    return {this, 0};
+}
+
+InstStream::iterator InstStream::end() const {
+    return {this, m_bytes.size()};
+}
+
+InstStreamIterator::InstStreamIterator(const InstStream *stream, std::size_t position)
+    : m_stream(stream), m_position(position) {
+    unpack();
+}
+
+InstStreamIterator &InstStreamIterator::operator++() {
+    m_position = m_next;
+    unpack();
+    return *this;
+}
+
+void InstStreamIterator::unpack() {
+    const auto &bytes = m_stream->m_bytes;
+    if (m_position == bytes.size()) {
+        return;
+    }
+    const auto *data = &bytes[m_position];
+    m_inst = {};
+    m_inst.opcode = static_cast<Opcode>(*data++);
+    m_inst.operand_width = *data++;
+    const auto operand_count = *data++;
+    for (std::uint8_t i = 0; i < operand_count; i++) {
+        auto &operand = m_inst.operands[i];
+        const auto type = *data++;
+        operand.type = static_cast<OperandType>(type & ~k_wide_flag);
+        switch (operand.type) {
+        case OperandType::Abs:
+            operand.abs = reinterpret_cast<const void *>(m_stream->m_wide[read_int32(data)]);
+            data += 4;
+            break;
+        case OperandType::Lbl:
+            operand.lbl = reinterpret_cast<const void *>(m_stream->m_wide[read_int32(data)]);
+            data += 4;
+            break;
+        case OperandType::BaseIndexDisp:
+            operand.base = *data++;
+            operand.index = *data++;
+            operand.scale = *data++;
+            operand.disp = read_int32(data);
+            data += 4;
+            break;
+        case OperandType::BaseDisp:
+            operand.base = *data++;
+            operand.disp = read_int32(data);
+            data += 4;
+            break;
+        case OperandType::Imm:
+        case OperandType::Off: {
+            const auto value = (type & k_wide_flag) != 0 ? static_cast<std::int64_t>(m_stream->m_wide[read_int32(data)])
+                                                         : static_cast<std::int64_t>(read_int32(data));
+            data += 4;
+            if (operand.type == OperandType::Imm) {
+                operand.imm = static_cast<std::uint64_t>(value);
+            } else {
+                operand.off = value;
+            }
+            break;
+        }
+        case OperandType::Reg:
+            operand.reg = *data++;
+            break;
+        case OperandType::None:
+            COEL_ENSURE_NOT_REACHED();
+        }
+    }
+    m_next = data - bytes.data();
+}
+
+} // namespace coel::x86
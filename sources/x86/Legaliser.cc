@@ -6,9 +6,13 @@
 #include <coel/ir/Function.hh>
 #include <coel/ir/InstVisitor.hh>
 #include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
 #include <coel/ir/Unit.hh>
+#include <coel/support/Assert.hh>
 #include <coel/x86/Register.hh>
 
+#include <array>
+
 namespace coel::x86 {
 namespace {
 
@@ -27,11 +31,28 @@ public:
     void visit(ir::CondBranchInst *) override;
     void visit(ir::CopyInst *) override {}
     void visit(ir::LoadInst *) override {}
+    void visit(ir::PhiInst *) override;
     void visit(ir::RetInst *) override;
     void visit(ir::StoreInst *) override;
 };
 
 void Legaliser::run(ir::Function *function) {
+    if (function->is_external()) {
+        return;
+    }
+
+    // Copy the arguments out of their registers on entry so that the register allocator is free to place them anywhere.
+    // TODO: Assuming target/ABI registers.
+    std::array argument_registers{Register::rdi, Register::rsi, Register::rdx,
+                                  Register::rcx, Register::r8,  Register::r9};
+    auto *entry = *function->begin();
+    for (std::size_t i = function->arguments().size(); i-- > 0;) {
+        auto *argument = function->argument(i);
+        auto *copy = m_context.create_virtual(argument->type());
+        argument->replace_all_uses_with(copy);
+        entry->prepend<ir::CopyInst>(copy, m_context.create_physical(argument->type(), argument_registers[i]));
+    }
+
     for (auto *block : *function) {
         m_block = block;
         for (auto *inst : *block) {
@@ -62,10 +83,28 @@ void Legaliser::visit(ir::CallInst *call) {
 }
 
 void Legaliser::visit(ir::CompareInst *compare) {
-    if (compare->lhs()->is<codegen::Register>()) {
-        compare->replace_all_uses_with(compare->lhs());
+    // Narrow integers are extended before being compared, which can't be done to a memory operand in place.
+    const auto *integer_type = compare->rhs()->type()->as<ir::IntegerType>();
+    if (integer_type != nullptr && integer_type->bit_width() < 32 && compare->rhs()->is<ir::LoadInst>()) {
+        auto *rhs_copy = m_context.create_virtual(compare->rhs()->type());
+        m_block->insert<ir::CopyInst>(compare, rhs_copy, compare->rhs());
+        compare->replace_uses_of_with(compare->rhs(), rhs_copy);
+    }
+
+    // A compare that's only used by the branch right after it is fused into a cmp and jcc, which doesn't write back to
+    // the lhs, so the lhs only needs to be moved into a register.
+    const auto &users = compare->users();
+    auto next = ++m_block->iterator(compare);
+    if (users.size() == 1 && next != m_block->end() && *users.begin() == *next && (*next)->is<ir::CondBranchInst>()) {
+        if (!compare->lhs()->is<codegen::Register>()) {
+            auto *lhs_copy = m_context.create_virtual(compare->lhs()->type());
+            m_block->insert<ir::CopyInst>(compare, lhs_copy, compare->lhs());
+            compare->set_lhs(lhs_copy);
+        }
         return;
     }
+
+    // The result is written back to the lhs, so always compare a copy in case the lhs is needed afterwards.
     auto *lhs_copy = m_context.create_virtual(compare->lhs()->type());
     m_block->insert<ir::CopyInst>(compare, lhs_copy, compare->lhs());
     compare->set_lhs(lhs_copy);
@@ -73,7 +112,7 @@ void Legaliser::visit(ir::CompareInst *compare) {
 }
 
 void Legaliser::visit(ir::CondBranchInst *cond_branch) {
-    if (cond_branch->cond()->is<codegen::Register>()) {
+    if (cond_branch->cond()->is<codegen::Register>() || cond_branch->cond()->is<ir::CompareInst>()) {
         return;
     }
     auto *cond_copy = m_context.create_virtual(cond_branch->cond()->type());
@@ -81,6 +120,11 @@ void Legaliser::visit(ir::CondBranchInst *cond_branch) {
     cond_branch->set_cond(cond_copy);
 }
 
+void Legaliser::visit(ir::PhiInst *) {
+    // Phis are lowered to copies beforehand.
+    COEL_ENSURE_NOT_REACHED();
+}
+
 void Legaliser::visit(ir::RetInst *ret) {
     auto *value_copy = m_context.create_physical(ret->value()->type(), Register::rax);
     m_block->insert<ir::CopyInst>(ret, value_copy, ret->value());
@@ -99,10 +143,14 @@ void Legaliser::visit(ir::StoreInst *store) {
 } // namespace
 
 void legalise(codegen::Context &context) {
-    Legaliser legaliser(context);
     for (auto *function : context.unit()) {
-        legaliser.run(function);
+        legalise(context, *function);
     }
 }
 
+void legalise(codegen::Context &context, ir::Function &function) {
+    Legaliser legaliser(context);
+    legaliser.run(&function);
+}
+
 } // namespace coel::x86
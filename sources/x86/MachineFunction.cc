@@ -0,0 +1,15 @@
+#include <coel/x86/MachineFunction.hh>
+
+namespace coel::x86 {
+
+Builder MachineBasicBlock::append(Opcode opcode) {
+    auto &inst = m_insts.emplace_back();
+    inst.opcode = opcode;
+    return Builder(&inst);
+}
+
+MachineBasicBlock *MachineFunction::append_block(const void *label) {
+    return m_blocks.emplace_back(std::make_unique<MachineBasicBlock>(label)).get();
+}
+
+} // namespace coel::x86
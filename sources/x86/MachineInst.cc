@@ -1,329 +1,531 @@
 #include <coel/x86/MachineInst.hh>
 
 #include <coel/support/Assert.hh>
+#include <coel/x86/Register.hh>
 
 #include <array>
+#include <bit>
+#include <cstddef>
 #include <limits>
+#include <optional>
+#include <utility>
 
 namespace coel::x86 {
 namespace {
 
-std::uint8_t emit_mod_rm(std::uint8_t mod, std::uint8_t reg, std::uint8_t rm) {
+// Operand widths an instruction accepts. Instructions which accept more than one width select it with the operand size
+// override prefix and REX.W.
+constexpr std::uint8_t k_width_any = 0;
+constexpr std::uint8_t k_width_8 = 1u << 0u;
+constexpr std::uint8_t k_width_16 = 1u << 1u;
+constexpr std::uint8_t k_width_32 = 1u << 2u;
+constexpr std::uint8_t k_width_64 = 1u << 3u;
+constexpr std::uint8_t k_width_sized = k_width_16 | k_width_32 | k_width_64;
+
+constexpr std::uint8_t k_rex_w = 1u << 3u;
+constexpr std::uint8_t k_rex_r = 1u << 2u;
+constexpr std::uint8_t k_rex_x = 1u << 1u;
+constexpr std::uint8_t k_rex_b = 1u << 0u;
+
+// Index of the operand that goes in a field, or none.
+constexpr std::int8_t k_none = -1;
+
+enum class Imm : std::uint8_t {
+    None,
+    // Sign-extended imm8.
+    Byte,
+    // imm16 or imm32, sign-extended for 64-bit operands.
+    Sized,
+    // imm16, imm32 or imm64.
+    Full,
+    // imm32 written with a 32-bit operation, which zero-extends it to the 64-bit operand.
+    Zero,
+    // Offset of the first operand relative to the end of the instruction.
+    Rel8,
+    Rel32,
+};
+
+// How to encode an instruction with the given operand types. A memory operand (BaseDisp, which also stands for
+// BaseIndexDisp, or Off for [rip+disp32]) can only go in the r/m field. An instruction can have several forms with the
+// same operand types, which are tried in the order they're described in, so the shorter forms come first and are
+// skipped when the operands don't fit them.
+struct Description {
+    Opcode opcode;
+    std::array<OperandType, 2> operands{OperandType::None, OperandType::None};
+    std::array<std::uint8_t, 2> bytes{};
+    std::uint8_t byte_count{1};
+    std::uint8_t widths{k_width_any};
+    // Operand in the ModRM r/m field, and either the operand in the reg field or the opcode extension.
+    std::int8_t rm{k_none};
+    std::int8_t reg{k_none};
+    std::uint8_t ext{0};
+    // Operand added to the last opcode byte.
+    std::int8_t plus_reg{k_none};
+    Imm imm{Imm::None};
+    // Whether the first operand has to be the accumulator (al, ax, eax or rax), which is implied by the opcode.
+    bool accumulator{false};
+};
+
+constexpr auto R = OperandType::Reg;
+constexpr auto M = OperandType::BaseDisp;
+constexpr auto I = OperandType::Imm;
+constexpr auto O = OperandType::Off;
+
+// clang-format off
+constexpr std::array k_descriptions{
+    Description{.opcode = Opcode::Add, .operands = {R, R}, .bytes = {0x01}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Add, .operands = {R, M}, .bytes = {0x03}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Add, .operands = {R, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Add, .operands = {R, I}, .bytes = {0x05}, .widths = k_width_sized, .imm = Imm::Sized,
+                .accumulator = true},
+    Description{.opcode = Opcode::Add, .operands = {R, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Add, .operands = {O, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Add, .operands = {O, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Cmp, .operands = {R, R}, .bytes = {0x39}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Cmp, .operands = {R, M}, .bytes = {0x3b}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Cmp, .operands = {R, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 7,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Cmp, .operands = {R, I}, .bytes = {0x3d}, .widths = k_width_sized, .imm = Imm::Sized,
+                .accumulator = true},
+    Description{.opcode = Opcode::Cmp, .operands = {R, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 7,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Cmp, .operands = {O, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 7,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Cmp, .operands = {O, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 7,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Dec, .operands = {R}, .bytes = {0xff}, .widths = k_width_sized, .rm = 0, .ext = 1},
+    Description{.opcode = Opcode::Inc, .operands = {R}, .bytes = {0xff}, .widths = k_width_sized, .rm = 0, .ext = 0},
+    Description{.opcode = Opcode::Lea, .operands = {R, M}, .bytes = {0x8d}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Leave, .bytes = {0xc9}},
+    Description{.opcode = Opcode::Mov, .operands = {R, R}, .bytes = {0x89}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Mov, .operands = {M, R}, .bytes = {0x89}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Mov, .operands = {R, M}, .bytes = {0x8b}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Mov, .operands = {R, I}, .bytes = {0xb8}, .widths = k_width_16 | k_width_32,
+                .plus_reg = 0, .imm = Imm::Full},
+    Description{.opcode = Opcode::Mov, .operands = {R, I}, .bytes = {0xb8}, .widths = k_width_64, .plus_reg = 0,
+                .imm = Imm::Zero},
+    Description{.opcode = Opcode::Mov, .operands = {R, I}, .bytes = {0xc7}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Mov, .operands = {R, I}, .bytes = {0xb8}, .widths = k_width_sized, .plus_reg = 0,
+                .imm = Imm::Full},
+    Description{.opcode = Opcode::Mov, .operands = {M, I}, .bytes = {0xc7}, .widths = k_width_sized, .rm = 0, .ext = 0,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Movsx, .operands = {R, R}, .bytes = {0x0f, 0xbe}, .byte_count = 2,
+                .widths = k_width_8, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movsx, .operands = {R, R}, .bytes = {0x0f, 0xbf}, .byte_count = 2,
+                .widths = k_width_16, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movsx, .operands = {R, M}, .bytes = {0x0f, 0xbe}, .byte_count = 2,
+                .widths = k_width_8, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movsx, .operands = {R, M}, .bytes = {0x0f, 0xbf}, .byte_count = 2,
+                .widths = k_width_16, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movzx, .operands = {R, R}, .bytes = {0x0f, 0xb6}, .byte_count = 2,
+                .widths = k_width_8, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movzx, .operands = {R, R}, .bytes = {0x0f, 0xb7}, .byte_count = 2,
+                .widths = k_width_16, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movzx, .operands = {R, M}, .bytes = {0x0f, 0xb6}, .byte_count = 2,
+                .widths = k_width_8, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Movzx, .operands = {R, M}, .bytes = {0x0f, 0xb7}, .byte_count = 2,
+                .widths = k_width_16, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Pop, .operands = {R}, .bytes = {0x58}, .widths = k_width_64, .plus_reg = 0},
+    Description{.opcode = Opcode::Push, .operands = {R}, .bytes = {0x50}, .widths = k_width_64, .plus_reg = 0},
+    Description{.opcode = Opcode::Ret, .bytes = {0xc3}},
+    Description{.opcode = Opcode::Sub, .operands = {R, R}, .bytes = {0x29}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Sub, .operands = {R, M}, .bytes = {0x2b}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Sub, .operands = {R, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 5,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Sub, .operands = {R, I}, .bytes = {0x2d}, .widths = k_width_sized, .imm = Imm::Sized,
+                .accumulator = true},
+    Description{.opcode = Opcode::Sub, .operands = {R, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 5,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Sub, .operands = {O, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 5,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Sub, .operands = {O, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 5,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Xor, .operands = {R, R}, .bytes = {0x31}, .widths = k_width_sized, .rm = 0, .reg = 1},
+    Description{.opcode = Opcode::Xor, .operands = {R, M}, .bytes = {0x33}, .widths = k_width_sized, .rm = 1, .reg = 0},
+    Description{.opcode = Opcode::Xor, .operands = {R, I}, .bytes = {0x83}, .widths = k_width_sized, .rm = 0, .ext = 6,
+                .imm = Imm::Byte},
+    Description{.opcode = Opcode::Xor, .operands = {R, I}, .bytes = {0x35}, .widths = k_width_sized, .imm = Imm::Sized,
+                .accumulator = true},
+    Description{.opcode = Opcode::Xor, .operands = {R, I}, .bytes = {0x81}, .widths = k_width_sized, .rm = 0, .ext = 6,
+                .imm = Imm::Sized},
+    Description{.opcode = Opcode::Call, .operands = {O}, .bytes = {0xe8}, .imm = Imm::Rel32},
+    Description{.opcode = Opcode::CallInd, .operands = {O}, .bytes = {0xff}, .rm = 0, .ext = 2},
+    Description{.opcode = Opcode::Je, .operands = {O}, .bytes = {0x74}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Je, .operands = {O}, .bytes = {0x0f, 0x84}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jne, .operands = {O}, .bytes = {0x75}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jne, .operands = {O}, .bytes = {0x0f, 0x85}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jl, .operands = {O}, .bytes = {0x7c}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jl, .operands = {O}, .bytes = {0x0f, 0x8c}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jg, .operands = {O}, .bytes = {0x7f}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jg, .operands = {O}, .bytes = {0x0f, 0x8f}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jle, .operands = {O}, .bytes = {0x7e}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jle, .operands = {O}, .bytes = {0x0f, 0x8e}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jge, .operands = {O}, .bytes = {0x7d}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jge, .operands = {O}, .bytes = {0x0f, 0x8d}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jb, .operands = {O}, .bytes = {0x72}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jb, .operands = {O}, .bytes = {0x0f, 0x82}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Ja, .operands = {O}, .bytes = {0x77}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Ja, .operands = {O}, .bytes = {0x0f, 0x87}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jbe, .operands = {O}, .bytes = {0x76}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jbe, .operands = {O}, .bytes = {0x0f, 0x86}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jae, .operands = {O}, .bytes = {0x73}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jae, .operands = {O}, .bytes = {0x0f, 0x83}, .byte_count = 2,
+                .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jmp, .operands = {O}, .bytes = {0xeb}, .imm = Imm::Rel8},
+    Description{.opcode = Opcode::Jmp, .operands = {O}, .bytes = {0xe9}, .imm = Imm::Rel32},
+    Description{.opcode = Opcode::Jmp, .operands = {R}, .bytes = {0xff}, .widths = k_width_64, .rm = 0, .ext = 4},
+    Description{.opcode = Opcode::Sete, .operands = {R}, .bytes = {0x0f, 0x94}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setne, .operands = {R}, .bytes = {0x0f, 0x95}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setl, .operands = {R}, .bytes = {0x0f, 0x9c}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setg, .operands = {R}, .bytes = {0x0f, 0x9f}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setle, .operands = {R}, .bytes = {0x0f, 0x9e}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setge, .operands = {R}, .bytes = {0x0f, 0x9d}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setb, .operands = {R}, .bytes = {0x0f, 0x92}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Seta, .operands = {R}, .bytes = {0x0f, 0x97}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setbe, .operands = {R}, .bytes = {0x0f, 0x96}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+    Description{.opcode = Opcode::Setae, .operands = {R}, .bytes = {0x0f, 0x93}, .byte_count = 2, .widths = k_width_8,
+                .rm = 0},
+};
+// clang-format on
+
+constexpr std::uint8_t emit_mod_rm(std::uint8_t mod, std::uint8_t reg, std::uint8_t rm) {
     return ((mod & 0b11u) << 6u) | ((reg & 0b111u) << 3u) | (rm & 0b111u);
 }
 
-std::uint8_t encode_arith(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operand_width == 16 || inst.operand_width == 32 || inst.operand_width == 64);
-    COEL_ASSERT(inst.operands[0].type == OperandType::Reg);
-    auto lhs = static_cast<std::uint8_t>(inst.operands[0].reg);
-    std::uint8_t length = 0;
-    std::uint8_t rex = 0x40;
-    if (inst.operand_width == 16) {
-        encoded[length++] = 0x66; // operand size override
-    } else if (inst.operand_width == 64) {
-        rex |= (1u << 3u); // REX.W
+constexpr std::uint8_t emit_sib(std::uint8_t scale, std::uint8_t index, std::uint8_t base) {
+    return ((scale & 0b11u) << 6u) | ((index & 0b111u) << 3u) | (base & 0b111u);
+}
+
+constexpr std::uint8_t width_bit(std::uint8_t width) {
+    switch (width) {
+    case 8:
+        return k_width_8;
+    case 16:
+        return k_width_16;
+    case 32:
+        return k_width_32;
+    case 64:
+        return k_width_64;
+    default:
+        return k_width_any;
     }
-    if (lhs >= 8) {
-        rex |= (1u << 0u); // REX.B
+}
+
+template <typename T>
+constexpr bool fits(std::int64_t value) {
+    return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+}
+
+// Interprets the low width bits of an immediate as a signed value.
+constexpr std::int64_t sign_extend(std::uint64_t value, std::uint8_t width) {
+    const auto shift = 64u - width;
+    return static_cast<std::int64_t>(value << shift) >> shift;
+}
+
+void emit_bytes(std::span<std::uint8_t, 16> encoded, std::uint8_t &length, std::uint64_t value, std::uint8_t count) {
+    for (std::uint8_t i = 0; i < count; i++) {
+        encoded[length++] = (value >> (i * 8u)) & 0xffu;
     }
-    switch (inst.operands[1].type) {
-    case OperandType::BaseDisp: {
-        if ((rex & (1u << 0u)) != 0) {
-            rex &= ~(1u << 0u);
-            rex |= (1u << 2u); // REX.R
-        }
-        auto base = static_cast<std::uint8_t>(inst.operands[1].base);
-        if (base >= 8) {
-            rex |= (1u << 0u); // REX.B
-        }
-        if (rex != 0x40) {
-            encoded[length++] = rex;
-        }
-        if (inst.opcode == Opcode::Add) {
-            encoded[length++] = 0x03; // add reg, r/m
-        } else if (inst.opcode == Opcode::Sub) {
-            encoded[length++] = 0x2b; // sub reg, r/m
-        } else {
-            encoded[length++] = 0x3b; // cmp reg, r/m
+}
+
+// Encoder specialised for a single description, so that everything but the operand values is resolved at compile time.
+// Returns zero without writing anything when the operands don't fit the description.
+template <std::size_t Index>
+std::uint8_t encode_with(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
+    constexpr const Description &desc = k_descriptions[Index];
+    if constexpr (desc.widths != k_width_any) {
+        if ((width_bit(inst.operand_width) & desc.widths) == 0) {
+            return 0;
         }
-        encoded[length++] = emit_mod_rm(0b01, lhs, base);
-        encoded[length++] = inst.operands[1].disp;
-        return length;
     }
-    case OperandType::Imm: {
-        // TODO: Emit special encoding for opcode (al, ax, eax, rax), imm(8, 16, 32, 32).
-        auto rhs = static_cast<std::uint8_t>(inst.operands[1].imm & 0xffu);
-        COEL_ASSERT(rhs <= 0x7f);
-        if (rex != 0x40) {
-            encoded[length++] = rex;
+    if constexpr (desc.accumulator) {
+        if (inst.operands[0].reg != Register::rax) {
+            return 0;
         }
-        encoded[length++] = 0x83; // opcode r/m, imm8
-        encoded[length++] = emit_mod_rm(0b11, inst.opcode == Opcode::Cmp ? 7 : inst.opcode == Opcode::Sub ? 5 : 0, lhs);
-        encoded[length++] = rhs;
-        return length;
     }
-    case OperandType::Reg: {
-        auto rhs = static_cast<std::uint8_t>(inst.operands[1].reg);
-        if (rhs >= 8) {
-            rex |= (1u << 2u); // REX.R
+
+    const auto imm = inst.operands[1].imm;
+    if constexpr (desc.imm == Imm::Byte) {
+        if (!fits<std::int8_t>(sign_extend(imm, inst.operand_width))) {
+            return 0;
         }
-        if (rex != 0x40) {
-            encoded[length++] = rex;
+    } else if constexpr (desc.imm == Imm::Sized) {
+        if (inst.operand_width == 64 && !fits<std::int32_t>(static_cast<std::int64_t>(imm))) {
+            return 0;
         }
-        if (inst.opcode == Opcode::Add) {
-            encoded[length++] = 0x01; // add r/m, reg
-        } else if (inst.opcode == Opcode::Sub) {
-            encoded[length++] = 0x29; // sub r/m, reg
-        } else {
-            encoded[length++] = 0x39; // cmp r/m, reg
+    } else if constexpr (desc.imm == Imm::Zero) {
+        if (imm > std::numeric_limits<std::uint32_t>::max()) {
+            return 0;
+        }
+    } else if constexpr (desc.imm == Imm::Rel8) {
+        if (!fits<std::int8_t>(inst.operands[0].off - (desc.byte_count + 1))) {
+            return 0;
         }
-        encoded[length++] = emit_mod_rm(0b11, rhs, lhs);
-        return length;
     }
-    default:
-        COEL_ENSURE_NOT_REACHED();
+
+    std::uint8_t length = 0;
+    std::uint8_t rex = 0;
+    // Byte registers other than al, cl, dl and bl need a REX prefix to not be taken as ah, ch, dh and bh.
+    bool need_rex = false;
+    if constexpr (std::popcount(desc.widths) > 1) {
+        if (inst.operand_width == 16) {
+            encoded[length++] = 0x66; // operand size override
+        } else if (inst.operand_width == 64) {
+            rex |= k_rex_w;
+        }
     }
-}
 
-std::uint8_t encode_leave(const MachineInst &, std::span<std::uint8_t, 16> encoded) {
-    encoded[0] = 0xc9;
-    return 1;
-}
+    std::uint8_t reg_field = desc.ext;
+    if constexpr (desc.reg != k_none) {
+        const auto reg = inst.operands[desc.reg].reg;
+        rex |= reg >= 8 ? k_rex_r : 0;
+        reg_field = reg;
+    }
 
-std::uint8_t encode_mov(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operand_width == 16 || inst.operand_width == 32 || inst.operand_width == 64);
+    constexpr auto rm_type = desc.rm != k_none ? desc.operands[desc.rm] : OperandType::None;
     std::uint8_t mod = 0;
-    std::uint8_t dst = 0;
-    switch (inst.operands[0].type) {
-    case OperandType::BaseDisp: {
-        mod = 0b01;
-        dst = static_cast<std::uint8_t>(inst.operands[0].base);
-        break;
-    }
-    case OperandType::Reg: {
+    std::uint8_t rm = 0;
+    std::optional<std::uint8_t> sib;
+    if constexpr (rm_type == OperandType::Reg) {
+        const auto reg = inst.operands[desc.rm].reg;
+        rex |= reg >= 8 ? k_rex_b : 0;
+        need_rex = desc.widths == k_width_8 && reg >= 4;
         mod = 0b11;
-        dst = static_cast<std::uint8_t>(inst.operands[0].reg);
-        break;
-    }
-    default:
-        COEL_ENSURE_NOT_REACHED();
-    }
-
-    std::uint8_t length = 0;
-    std::uint8_t rex = 0x40;
-    if (inst.operand_width == 16) {
-        encoded[length++] = 0x66; // operand size override
-    } else if (inst.operand_width == 64) {
-        rex |= (1u << 3u); // REX.W
-    }
-    if (dst >= 8) {
-        rex |= (1u << 0u); // REX.B
-    }
-    switch (inst.operands[1].type) {
-    case OperandType::BaseDisp: {
-        // TODO: Use 32-bit displacement if needed.
-        COEL_ASSERT(inst.operands[1].disp > std::numeric_limits<std::int8_t>::min() &&
-                    inst.operands[1].disp < std::numeric_limits<std::int8_t>::max());
-        bool need_sib = inst.operands[1].base == Register::rsp || inst.operands[1].base == Register::r12;
-        COEL_ASSERT(!need_sib); // TODO: Support rsp and r12.
-        if ((rex & (1u << 0u)) != 0) {
-            rex &= ~(1u << 0u);
-            rex |= (1u << 2u); // REX.R
-        }
-        auto base = static_cast<std::uint8_t>(inst.operands[1].base);
-        if (base >= 8) {
-            rex |= (1u << 0u); // REX.B
+        rm = reg;
+    } else if constexpr (rm_type == OperandType::BaseDisp) {
+        const auto &operand = inst.operands[desc.rm];
+        rex |= operand.base >= 8 ? k_rex_b : 0;
+        // There's no [rbp] or [r13] without a displacement, since that encoding means [rip]+disp32 instead.
+        if (operand.disp == 0 && (operand.base & 0b111u) != 0b101u) {
+            mod = 0b00;
+        } else if (fits<std::int8_t>(operand.disp)) {
+            mod = 0b01;
+        } else {
+            mod = 0b10;
         }
-        if (rex != 0x40) {
-            encoded[length++] = rex;
+        rm = operand.base;
+
+        // An r/m of rsp or r12 means that a SIB byte follows, which is also needed for rsp or r12 as the base. An index
+        // of rsp means no index.
+        const bool has_index = operand.type == OperandType::BaseIndexDisp;
+        if (has_index || (operand.base & 0b111u) == 0b100u) {
+            std::uint8_t index = Register::rsp;
+            std::uint8_t scale = 0;
+            if (has_index) {
+                COEL_ASSERT(operand.index != Register::rsp, "rsp can't be used as an index");
+                COEL_ASSERT(std::has_single_bit(operand.scale) && operand.scale <= 8);
+                rex |= operand.index >= 8 ? k_rex_x : 0;
+                index = operand.index;
+                scale = std::countr_zero(operand.scale);
+            }
+            sib = emit_sib(scale, index, operand.base);
+            rm = 0b100;
         }
-        encoded[length++] = 0x8b; // mov reg, r/m
-        encoded[length++] = emit_mod_rm(0b01, dst, base);
-        encoded[length++] = inst.operands[1].disp;
-        break;
+    } else if constexpr (rm_type == OperandType::Off) {
+        COEL_ASSERT(fits<std::int32_t>(inst.operands[desc.rm].off));
+        mod = 0b00;
+        rm = 0b101; // [rip]+disp32
     }
-    case OperandType::Imm: {
-        if (dst >= 8) {
-            dst -= 8;
-        }
-        if (rex != 0x40) {
-            encoded[length++] = rex;
-        }
-        if (inst.operands[0].type == OperandType::Reg) {
-            encoded[length++] = 0xb8 + dst; // mov reg, imm
-        } else {
-            encoded[length++] = 0xc7; // mov r/m, imm
-            encoded[length++] = emit_mod_rm(mod, 0, dst);
-        }
-        break;
+
+    auto last_byte = desc.bytes[desc.byte_count - 1];
+    if constexpr (desc.plus_reg != k_none) {
+        const auto reg = inst.operands[desc.plus_reg].reg;
+        rex |= reg >= 8 ? k_rex_b : 0;
+        last_byte += reg & 0b111u;
     }
-    case OperandType::Reg: {
-        auto src = static_cast<std::uint8_t>(inst.operands[1].reg);
-        if (src >= 8) {
-            rex |= (1u << 2u); // REX.R
-        }
-        if (rex != 0x40) {
-            encoded[length++] = rex;
-        }
-        encoded[length++] = 0x89; // mov r/m, reg
-        encoded[length++] = emit_mod_rm(mod, src, dst);
-        break;
+
+    if (rex != 0 || need_rex) {
+        encoded[length++] = 0x40 | rex;
     }
-    default:
-        COEL_ENSURE_NOT_REACHED();
+    for (std::uint8_t i = 0; i < desc.byte_count - 1; i++) {
+        encoded[length++] = desc.bytes[i];
     }
+    encoded[length++] = last_byte;
 
-    if (inst.operands[0].type == OperandType::BaseDisp) {
-        encoded[length++] = inst.operands[0].disp;
+    std::uint8_t rip_disp_position = 0;
+    if constexpr (rm_type != OperandType::None) {
+        encoded[length++] = emit_mod_rm(mod, reg_field, rm);
     }
-    if (inst.operands[1].type == OperandType::Imm) {
-        auto imm = inst.operands[1].imm;
-        encoded[length++] = (imm >> 0u) & 0xffu;
-        encoded[length++] = (imm >> 8u) & 0xffu;
-        if (inst.operand_width >= 32) {
-            encoded[length++] = (imm >> 16u) & 0xffu;
-            encoded[length++] = (imm >> 24u) & 0xffu;
-        }
-        if (inst.operand_width >= 64) {
-            encoded[length++] = (imm >> 32u) & 0xffu;
-            encoded[length++] = (imm >> 40u) & 0xffu;
-            encoded[length++] = (imm >> 48u) & 0xffu;
-            encoded[length++] = (imm >> 56u) & 0xffu;
-        }
+    if (sib) {
+        encoded[length++] = *sib;
+    }
+    if constexpr (rm_type == OperandType::BaseDisp) {
+        const auto disp = static_cast<std::uint32_t>(inst.operands[desc.rm].disp);
+        emit_bytes(encoded, length, disp, mod == 0b00 ? 0 : mod == 0b01 ? 1 : 4);
+    } else if constexpr (rm_type == OperandType::Off) {
+        rip_disp_position = length;
+        length += 4;
     }
-    return length;
-}
 
-std::uint8_t encode_pop(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operand_width == 64);
-    COEL_ASSERT(inst.operands[0].type == OperandType::Reg);
-    std::uint8_t length = 0;
-    auto reg = static_cast<std::uint8_t>(inst.operands[0].reg);
-    if (reg >= 8) {
-        encoded[length++] = 0x41; // REX.B
-        reg -= 8;
+    if constexpr (desc.imm == Imm::Byte) {
+        encoded[length++] = imm & 0xffu;
+    } else if constexpr (desc.imm == Imm::Sized) {
+        emit_bytes(encoded, length, imm, inst.operand_width == 16 ? 2 : 4);
+    } else if constexpr (desc.imm == Imm::Full) {
+        emit_bytes(encoded, length, imm, inst.operand_width / 8);
+    } else if constexpr (desc.imm == Imm::Zero) {
+        emit_bytes(encoded, length, imm, 4);
+    } else if constexpr (desc.imm == Imm::Rel8) {
+        encoded[length] = inst.operands[0].off - (length + 1);
+        length++;
+    } else if constexpr (desc.imm == Imm::Rel32) {
+        const auto rel = static_cast<std::uint64_t>(inst.operands[0].off - (length + 4));
+        emit_bytes(encoded, length, rel, 4);
     }
-    encoded[length++] = 0x58 + reg; // pop reg
-    return length;
-}
 
-std::uint8_t encode_push(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operand_width == 64);
-    COEL_ASSERT(inst.operands[0].type == OperandType::Reg);
-    std::uint8_t length = 0;
-    auto reg = static_cast<std::uint8_t>(inst.operands[0].reg);
-    if (reg >= 8) {
-        encoded[length++] = 0x41; // REX.B
-        reg -= 8;
+    // rip-relative displacements are relative to the end of the instruction, which is only known now.
+    if constexpr (rm_type == OperandType::Off) {
+        const auto disp = static_cast<std::uint64_t>(inst.operands[desc.rm].off - length);
+        emit_bytes(encoded, rip_disp_position, disp, 4);
     }
-    encoded[length++] = 0x50 + reg; // push reg
     return length;
 }
 
-std::uint8_t encode_ret(const MachineInst &, std::span<std::uint8_t, 16> encoded) {
-    encoded[0] = 0xc3; // ret
-    return 1;
-}
+using EncodeFunction = std::uint8_t (*)(const MachineInst &, std::span<std::uint8_t, 16>);
+
+// Pseudo instructions come after Lbl and have no encoding.
+constexpr std::size_t k_opcode_count = static_cast<std::size_t>(Opcode::Lbl);
+constexpr std::size_t k_operand_type_count = static_cast<std::size_t>(OperandType::Reg) + 1;
+constexpr std::size_t k_no_description = k_descriptions.size();
 
-std::uint8_t encode_call(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operands[0].type == OperandType::Off);
-    auto off = (static_cast<std::uint64_t>(inst.operands[0].off) & 0xffffffffu) - 5;
-    encoded[0] = 0xe8; // call off32
-    encoded[1] = (off >> 0u) & 0xffu;
-    encoded[2] = (off >> 8u) & 0xffu;
-    encoded[3] = (off >> 16u) & 0xffu;
-    encoded[4] = (off >> 24u) & 0xffu;
-    return 5;
+// Both kinds of memory operand are encoded with the same descriptions.
+constexpr OperandType description_type(OperandType type) {
+    return type == OperandType::BaseIndexDisp ? OperandType::BaseDisp : type;
 }
 
-std::uint8_t encode_je(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operands[0].type == OperandType::Off);
-    encoded[0] = 0x74;
-    encoded[1] = inst.operands[0].off - 2;
-    return 2;
+constexpr std::size_t dispatch_index(Opcode opcode, OperandType lhs, OperandType rhs) {
+    lhs = description_type(lhs);
+    rhs = description_type(rhs);
+    return (static_cast<std::size_t>(opcode) * k_operand_type_count + static_cast<std::size_t>(lhs)) *
+               k_operand_type_count +
+           static_cast<std::size_t>(rhs);
 }
 
-std::uint8_t encode_jmp(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operands[0].type == OperandType::Off);
-    encoded[0] = 0xeb;
-    encoded[1] = inst.operands[0].off - 2;
-    return 2;
+constexpr std::size_t dispatch_index(const Description &desc) {
+    return dispatch_index(desc.opcode, desc.operands[0], desc.operands[1]);
 }
 
-std::uint8_t encode_jne(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operands[0].type == OperandType::Off);
-    encoded[0] = 0x75;
-    encoded[1] = inst.operands[0].off - 2;
-    return 2;
+template <std::size_t... Indices>
+constexpr auto build_encoders(std::index_sequence<Indices...>) {
+    return std::array<EncodeFunction, sizeof...(Indices)>{&encode_with<Indices>...};
 }
 
-std::uint8_t encode_setcc(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    COEL_ASSERT(inst.operand_width == 8);
-    COEL_ASSERT(inst.operands[0].type == OperandType::Reg);
-    auto reg = static_cast<std::uint8_t>(inst.operands[0].reg);
-    std::uint8_t length = 0;
-    if (reg >= 4) {
-        encoded[length++] = reg >= 8 ? 0x41 : 0x40;
-    }
-    if (reg >= 8) {
-        reg -= 8;
+// The first description of each opcode and operand types.
+constexpr auto build_dispatch_table() {
+    std::array<std::size_t, k_opcode_count * k_operand_type_count * k_operand_type_count> table{};
+    table.fill(k_no_description);
+    for (std::size_t i = k_descriptions.size(); i-- > 0;) {
+        table[dispatch_index(k_descriptions[i])] = i;
     }
-    encoded[length++] = 0x0f;
-    switch (inst.opcode) {
-    case Opcode::Sete:
-        encoded[length++] = 0x94;
-        break;
-    case Opcode::Setne:
-        encoded[length++] = 0x95;
-        break;
-    case Opcode::Setl:
-        encoded[length++] = 0x9c;
-        break;
-    case Opcode::Setg:
-        encoded[length++] = 0x9f;
-        break;
-    case Opcode::Setle:
-        encoded[length++] = 0x9e;
-        break;
-    case Opcode::Setge:
-        encoded[length++] = 0x9d;
-        break;
-    default:
-        COEL_ENSURE_NOT_REACHED();
+    return table;
+}
+
+// The next description with the same opcode and operand types as each description.
+constexpr auto build_next_forms() {
+    std::array<std::size_t, k_descriptions.size()> next{};
+    next.fill(k_no_description);
+    for (std::size_t i = 0; i < k_descriptions.size(); i++) {
+        for (std::size_t j = i + 1; j < k_descriptions.size(); j++) {
+            if (dispatch_index(k_descriptions[i]) == dispatch_index(k_descriptions[j])) {
+                next[i] = j;
+                break;
+            }
+        }
     }
-    encoded[length++] = emit_mod_rm(0b11, 0, reg);
-    return length;
+    return next;
 }
 
-// clang-format off
-const std::array s_functions{
-    &encode_arith,
-    &encode_arith,
-    &encode_leave,
-    &encode_mov,
-    &encode_pop,
-    &encode_push,
-    &encode_ret,
-    &encode_arith,
-    &encode_call,
-    &encode_je,
-    &encode_jmp,
-    &encode_jne,
-    &encode_setcc,
-    &encode_setcc,
-    &encode_setcc,
-    &encode_setcc,
-    &encode_setcc,
-    &encode_setcc,
-};
-// clang-format on
+constexpr auto k_encoders = build_encoders(std::make_index_sequence<k_descriptions.size()>());
+constexpr auto k_dispatch_table = build_dispatch_table();
+constexpr auto k_next_forms = build_next_forms();
 
 } // namespace
 
 std::uint8_t encode(const MachineInst &inst, std::span<std::uint8_t, 16> encoded) {
-    auto opcode = static_cast<std::size_t>(inst.opcode);
-    COEL_ASSERT(opcode < s_functions.size());
-    return s_functions[opcode](inst, encoded);
+    COEL_ASSERT(static_cast<std::size_t>(inst.opcode) < k_opcode_count);
+    auto index = k_dispatch_table[dispatch_index(inst.opcode, inst.operands[0].type, inst.operands[1].type)];
+    COEL_ASSERT(index != k_no_description, "No encoding for operand types");
+    for (; index != k_no_description; index = k_next_forms[index]) {
+        if (const auto length = k_encoders[index](inst, encoded)) {
+            return length;
+        }
+    }
+    COEL_ENSURE_NOT_REACHED("No encoding for operands");
+}
+
+bool is_cond_jump(Opcode opcode) {
+    return (opcode >= Opcode::Je && opcode <= Opcode::Jae) || (opcode >= Opcode::JeLbl && opcode <= Opcode::JaeLbl);
+}
+
+bool is_label_jump(Opcode opcode) {
+    return opcode >= Opcode::JeLbl && opcode <= Opcode::JmpLbl;
+}
+
+Opcode invert_cond_jump(Opcode opcode) {
+    COEL_ASSERT(is_cond_jump(opcode));
+    const bool label = opcode >= Opcode::JeLbl;
+    const auto first = label ? Opcode::JeLbl : Opcode::Je;
+    auto inverse = [](Opcode cond) {
+        switch (cond) {
+        case Opcode::Je:
+            return Opcode::Jne;
+        case Opcode::Jne:
+            return Opcode::Je;
+        case Opcode::Jl:
+            return Opcode::Jge;
+        case Opcode::Jge:
+            return Opcode::Jl;
+        case Opcode::Jg:
+            return Opcode::Jle;
+        case Opcode::Jle:
+            return Opcode::Jg;
+        case Opcode::Jb:
+            return Opcode::Jae;
+        case Opcode::Jae:
+            return Opcode::Jb;
+        case Opcode::Ja:
+            return Opcode::Jbe;
+        case Opcode::Jbe:
+            return Opcode::Ja;
+        default:
+            COEL_ENSURE_NOT_REACHED();
+        }
+    };
+    const auto offset = static_cast<int>(opcode) - static_cast<int>(first);
+    const auto inverted = inverse(static_cast<Opcode>(static_cast<int>(Opcode::Je) + offset));
+    return static_cast<Opcode>(static_cast<int>(first) + static_cast<int>(inverted) - static_cast<int>(Opcode::Je));
+}
+
+Opcode resolve_label_jump(Opcode opcode) {
+    COEL_ASSERT(is_label_jump(opcode));
+    if (opcode == Opcode::JmpLbl) {
+        return Opcode::Jmp;
+    }
+    const auto offset = static_cast<int>(opcode) - static_cast<int>(Opcode::JeLbl);
+    return static_cast<Opcode>(static_cast<int>(Opcode::Je) + offset);
 }
 
 } // namespace coel::x86
@@ -0,0 +1,270 @@
+#include <coel/x86/MachinePasses.hh>
+
+#include <coel/x86/Builder.hh>
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachineInst.hh>
+#include <coel/x86/Register.hh>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace coel::x86 {
+namespace {
+
+// The carry flag is tracked separately from the rest since inc and dec leave it alone, and the zero flag since it's the
+// only one that means the same after any arithmetic instruction as after a cmp of its result against zero.
+constexpr std::uint8_t k_flag_carry = 1u << 0u;
+constexpr std::uint8_t k_flag_zero = 1u << 1u;
+constexpr std::uint8_t k_flag_other = 1u << 2u;
+constexpr std::uint8_t k_flags_all = k_flag_carry | k_flag_zero | k_flag_other;
+
+struct FlagEffect {
+    std::uint8_t reads{0};
+    std::uint8_t writes{0};
+};
+
+FlagEffect flag_effect(const MachineInst &inst) {
+    switch (inst.opcode) {
+    case Opcode::Add:
+    case Opcode::Cmp:
+    case Opcode::Sub:
+    case Opcode::Xor:
+        return {.writes = k_flags_all};
+    case Opcode::Dec:
+    case Opcode::Inc:
+        return {.writes = k_flag_zero | k_flag_other};
+    // The flags aren't preserved across calls.
+    case Opcode::Call:
+    case Opcode::CallInd:
+    case Opcode::CallLbl:
+        return {.writes = k_flags_all};
+    case Opcode::Je:
+    case Opcode::JeLbl:
+    case Opcode::Jne:
+    case Opcode::JneLbl:
+    case Opcode::Sete:
+    case Opcode::Setne:
+        return {.reads = k_flag_zero};
+    case Opcode::Jl:
+    case Opcode::JlLbl:
+    case Opcode::Jg:
+    case Opcode::JgLbl:
+    case Opcode::Jle:
+    case Opcode::JleLbl:
+    case Opcode::Jge:
+    case Opcode::JgeLbl:
+    case Opcode::Setl:
+    case Opcode::Setg:
+    case Opcode::Setle:
+    case Opcode::Setge:
+        return {.reads = k_flag_zero | k_flag_other};
+    // Unsigned conditions are the ones that read the carry flag.
+    case Opcode::Jb:
+    case Opcode::JbLbl:
+    case Opcode::Jae:
+    case Opcode::JaeLbl:
+    case Opcode::Setb:
+    case Opcode::Setae:
+        return {.reads = k_flag_carry};
+    case Opcode::Ja:
+    case Opcode::JaLbl:
+    case Opcode::Jbe:
+    case Opcode::JbeLbl:
+    case Opcode::Seta:
+    case Opcode::Setbe:
+        return {.reads = k_flag_carry | k_flag_zero};
+    default:
+        return {};
+    }
+}
+
+std::uint8_t apply(const FlagEffect &effect, std::uint8_t live) {
+    return (live & ~effect.writes) | effect.reads;
+}
+
+// Computes the flags that are live on exit from each block.
+std::unordered_map<const MachineBasicBlock *, std::uint8_t> flags_live_out(const MachineFunction &function) {
+    const auto &blocks = function.blocks();
+    std::unordered_map<const void *, const MachineBasicBlock *> block_map;
+    for (const auto &block : blocks) {
+        block_map.emplace(block->label(), block.get());
+    }
+
+    // Blocks that control continues to, or null for a jump out of the function, whose flags are assumed to be read.
+    std::unordered_map<const MachineBasicBlock *, std::vector<const MachineBasicBlock *>> succs;
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        auto &block_succs = succs[blocks[i].get()];
+        bool falls_through = true;
+        for (const auto &inst : blocks[i]->insts()) {
+            if (is_label_jump(inst.opcode)) {
+                auto it = block_map.find(inst.operands[0].lbl);
+                block_succs.push_back(it != block_map.end() ? it->second : nullptr);
+            }
+            falls_through = inst.opcode != Opcode::JmpLbl && inst.opcode != Opcode::Ret;
+        }
+        if (falls_through && i + 1 < blocks.size()) {
+            block_succs.push_back(blocks[i + 1].get());
+        }
+    }
+
+    std::unordered_map<const MachineBasicBlock *, std::uint8_t> live_in;
+    std::unordered_map<const MachineBasicBlock *, std::uint8_t> live_out;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+            const auto *block = it->get();
+            std::uint8_t live = 0;
+            for (const auto *succ : succs[block]) {
+                live |= succ != nullptr ? live_in[succ] : k_flags_all;
+            }
+            live_out[block] = live;
+            for (auto inst = block->insts().rbegin(); inst != block->insts().rend(); ++inst) {
+                live = apply(flag_effect(*inst), live);
+            }
+            if (live != live_in[block]) {
+                live_in[block] = live;
+                changed = true;
+            }
+        }
+    }
+    return live_out;
+}
+
+bool is_imm(const MachineInst &inst, std::uint64_t value) {
+    if (inst.operands[1].type != OperandType::Imm) {
+        return false;
+    }
+    const auto mask = inst.operand_width == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << inst.operand_width) - 1;
+    return (inst.operands[1].imm & mask) == (value & mask);
+}
+
+// Whether the instructions before index in a block leave the flags as a cmp of reg against zero would, as far as the
+// zero flag goes. That's the case when the last instruction to write the flags is an arithmetic one on reg at the same
+// width, and nothing writes reg after it.
+bool zero_flag_set_for(const std::vector<MachineInst> &insts, std::size_t index, std::uint8_t reg, std::uint8_t width) {
+    while (index-- > 0) {
+        const auto &inst = insts[index];
+        const bool writes_reg = inst.operands[0].type == OperandType::Reg && inst.operands[0].reg == reg &&
+                                inst.opcode != Opcode::Cmp && inst.opcode != Opcode::Push;
+        if ((flag_effect(inst).writes & k_flag_zero) == 0) {
+            if (writes_reg) {
+                return false;
+            }
+            continue;
+        }
+        switch (inst.opcode) {
+        case Opcode::Add:
+        case Opcode::Dec:
+        case Opcode::Inc:
+        case Opcode::Sub:
+        case Opcode::Xor:
+            return writes_reg && inst.operand_width == width;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// Turns a mov d, a followed by an add d, b or an add/sub d, imm into a single lea d, [a + b] or lea d, [a + imm].
+std::optional<MachineInst> three_operand_add(const MachineInst &mov, const MachineInst &arith) {
+    const auto &dst = arith.operands[0];
+    const auto &rhs = arith.operands[1];
+    if (mov.opcode != Opcode::Mov || mov.operands[0].type != OperandType::Reg ||
+        mov.operands[1].type != OperandType::Reg || mov.operands[0].reg != dst.reg ||
+        mov.operand_width != arith.operand_width) {
+        return std::nullopt;
+    }
+    const auto base = static_cast<Register>(mov.operands[1].reg);
+    MachineInst lea{};
+    lea.opcode = Opcode::Lea;
+    Builder builder(&lea);
+    builder.reg(static_cast<Register>(dst.reg)).width(arith.operand_width);
+    if (rhs.type == OperandType::Reg && arith.opcode == Opcode::Add) {
+        // The mov already wrote d, so d as the rhs is a.
+        auto index = rhs.reg == dst.reg ? base : static_cast<Register>(rhs.reg);
+        if (index == Register::rsp) {
+            return std::nullopt;
+        }
+        builder.base_index_disp(base, index, 1, 0);
+        return lea;
+    }
+    if (rhs.type == OperandType::Imm) {
+        const auto shift = 64u - arith.operand_width;
+        auto disp = static_cast<std::int64_t>(rhs.imm << shift) >> shift;
+        disp = arith.opcode == Opcode::Sub ? -disp : disp;
+        if (disp < std::numeric_limits<std::int32_t>::min() || disp > std::numeric_limits<std::int32_t>::max()) {
+            return std::nullopt;
+        }
+        builder.base_disp(base, static_cast<std::int32_t>(disp));
+        return lea;
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+void peephole(MachineFunction &function, MachinePassStats &stats) {
+    const auto live_out = flags_live_out(function);
+    for (const auto &block : function.blocks()) {
+        // Walk backwards so that the flags live after each instruction are known.
+        auto &insts = block->insts();
+        auto live = live_out.at(block.get());
+        for (std::size_t i = insts.size(); i-- > 0;) {
+            auto &inst = insts[i];
+            const auto &lhs = inst.operands[0];
+            const bool reg_lhs = lhs.type == OperandType::Reg;
+            if (inst.opcode == Opcode::Mov && reg_lhs && inst.operands[1].type == OperandType::Reg &&
+                inst.operands[1].reg == lhs.reg) {
+                // Values are only ever read at the width they're written at, so the zero extension of a 32-bit move
+                // isn't needed either.
+                insts.erase(insts.begin() + static_cast<std::ptrdiff_t>(i));
+                stats.self_moves++;
+                continue;
+            }
+            if (inst.opcode == Opcode::Cmp && reg_lhs && is_imm(inst, 0) && (live & ~k_flag_zero) == 0 &&
+                zero_flag_set_for(insts, i, lhs.reg, inst.operand_width)) {
+                insts.erase(insts.begin() + static_cast<std::ptrdiff_t>(i));
+                stats.redundant_compares++;
+                continue;
+            }
+            // The lea leaves the flags alone, which is only the same as the add when nothing reads them.
+            if ((inst.opcode == Opcode::Add || inst.opcode == Opcode::Sub) && reg_lhs && live == 0 && i > 0) {
+                if (auto lea = three_operand_add(insts[i - 1], inst)) {
+                    insts[i - 1] = *lea;
+                    insts.erase(insts.begin() + static_cast<std::ptrdiff_t>(i));
+                    stats.three_operand_adds++;
+                    continue;
+                }
+            }
+            if (inst.opcode == Opcode::Mov && reg_lhs && is_imm(inst, 0) && live == 0) {
+                const auto reg = lhs.reg;
+                inst = {};
+                Builder(&inst).reg(reg).reg(reg).width(32);
+                inst.opcode = Opcode::Xor;
+                stats.zero_moves++;
+            } else if ((inst.opcode == Opcode::Add || inst.opcode == Opcode::Sub) && reg_lhs &&
+                       (live & k_flag_carry) == 0 && (is_imm(inst, 1) || is_imm(inst, -1))) {
+                const bool increment = (inst.opcode == Opcode::Add) == is_imm(inst, 1);
+                const auto reg = lhs.reg;
+                const auto width = inst.operand_width;
+                inst = {};
+                Builder(&inst).reg(reg).width(width);
+                if (increment) {
+                    inst.opcode = Opcode::Inc;
+                    stats.increments++;
+                } else {
+                    inst.opcode = Opcode::Dec;
+                    stats.decrements++;
+                }
+            }
+            live = apply(flag_effect(inst), live);
+        }
+    }
+}
+
+} // namespace coel::x86
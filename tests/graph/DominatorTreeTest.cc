@@ -0,0 +1,66 @@
+#include <coel/graph/DominanceComputer.hh>
+#include <coel/graph/DominatorTree.hh>
+#include <coel/graph/Graph.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+namespace coel {
+namespace {
+
+struct Node {};
+
+TEST(DominatorTreeTest, Loop) {
+    // 0 -> 1 -> (2 | 3) -> 4 -> (1 | 5), with 6 unreachable but branching into 4.
+    std::array<Node, 7> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[1], &nodes[3]);
+    graph.connect(&nodes[2], &nodes[4]);
+    graph.connect(&nodes[3], &nodes[4]);
+    graph.connect(&nodes[4], &nodes[1]);
+    graph.connect(&nodes[4], &nodes[5]);
+    graph.connect(&nodes[6], &nodes[4]);
+
+    const auto tree = graph.run<DominanceComputer>();
+    EXPECT_EQ(tree.idom(&nodes[0]), nullptr);
+    EXPECT_EQ(tree.idom(&nodes[1]), &nodes[0]);
+    EXPECT_EQ(tree.idom(&nodes[2]), &nodes[1]);
+    EXPECT_EQ(tree.idom(&nodes[3]), &nodes[1]);
+    EXPECT_EQ(tree.idom(&nodes[4]), &nodes[1]);
+    EXPECT_EQ(tree.idom(&nodes[5]), &nodes[4]);
+    EXPECT_FALSE(tree.contains(&nodes[6]));
+    EXPECT_TRUE(tree.dominates(&nodes[1], &nodes[5]));
+    EXPECT_TRUE(tree.dominates(&nodes[4], &nodes[4]));
+    EXPECT_FALSE(tree.dominates(&nodes[2], &nodes[4]));
+
+    const auto frontiers = tree.frontiers(graph);
+    EXPECT_FALSE(frontiers.contains(&nodes[0]));
+    EXPECT_EQ(frontiers.at(&nodes[1]), std::vector<Node *>{&nodes[1]});
+    EXPECT_EQ(frontiers.at(&nodes[2]), std::vector<Node *>{&nodes[4]});
+    EXPECT_EQ(frontiers.at(&nodes[3]), std::vector<Node *>{&nodes[4]});
+    EXPECT_EQ(frontiers.at(&nodes[4]), std::vector<Node *>{&nodes[1]});
+    EXPECT_FALSE(frontiers.contains(&nodes[5]));
+}
+
+TEST(DominatorTreeTest, Irreducible) {
+    // 0 -> (1 | 2), 1 <-> 2, 2 -> 3. Neither of 1 and 2 dominates the other.
+    std::array<Node, 4> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[0], &nodes[2]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[2], &nodes[1]);
+    graph.connect(&nodes[2], &nodes[3]);
+
+    const auto tree = graph.run<DominanceComputer>();
+    EXPECT_EQ(tree.idom(&nodes[1]), &nodes[0]);
+    EXPECT_EQ(tree.idom(&nodes[2]), &nodes[0]);
+    EXPECT_EQ(tree.idom(&nodes[3]), &nodes[2]);
+}
+
+} // namespace
+} // namespace coel
@@ -0,0 +1,120 @@
+#include <coel/graph/Graph.hh>
+#include <coel/graph/LoopFinder.hh>
+#include <coel/graph/LoopInfo.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+namespace coel {
+namespace {
+
+struct Node {};
+
+TEST(LoopInfoTest, Nested) {
+    // 0 -> 1 -> 2 -> 3 -> (2 | 4) -> (1 | 5), where 1 heads the outer loop and 2 the inner one.
+    std::array<Node, 6> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[2], &nodes[3]);
+    graph.connect(&nodes[3], &nodes[2]);
+    graph.connect(&nodes[3], &nodes[4]);
+    graph.connect(&nodes[4], &nodes[1]);
+    graph.connect(&nodes[4], &nodes[5]);
+
+    const auto info = graph.run<LoopFinder>();
+    ASSERT_EQ(info.loops().size(), 2);
+    ASSERT_EQ(info.top_level().size(), 1);
+    auto *outer = info.top_level()[0];
+    auto *inner = info.loop_of(&nodes[3]);
+    ASSERT_NE(inner, nullptr);
+    EXPECT_EQ(info.loops()[0].get(), inner);
+    EXPECT_EQ(outer->header(), &nodes[1]);
+    EXPECT_EQ(inner->header(), &nodes[2]);
+    EXPECT_EQ(inner->parent(), outer);
+    EXPECT_EQ(outer->children(), std::vector<Loop<Node> *>{inner});
+
+    EXPECT_EQ(outer->nodes(), (std::vector<Node *>{&nodes[1], &nodes[4], &nodes[2], &nodes[3]}));
+    EXPECT_EQ(inner->nodes(), (std::vector<Node *>{&nodes[2], &nodes[3]}));
+    EXPECT_EQ(outer->latches(), std::vector<Node *>{&nodes[4]});
+    EXPECT_EQ(inner->latches(), std::vector<Node *>{&nodes[3]});
+    EXPECT_EQ(outer->exits(), std::vector<Node *>{&nodes[5]});
+    EXPECT_EQ(inner->exits(), std::vector<Node *>{&nodes[4]});
+    EXPECT_EQ(outer->preheader(), &nodes[0]);
+    EXPECT_EQ(inner->preheader(), &nodes[1]);
+
+    EXPECT_EQ(info.loop_of(&nodes[4]), outer);
+    EXPECT_EQ(info.loop_of(&nodes[5]), nullptr);
+    EXPECT_EQ(info.depth(&nodes[0]), 0);
+    EXPECT_EQ(info.depth(&nodes[1]), 1);
+    EXPECT_EQ(info.depth(&nodes[2]), 2);
+    EXPECT_EQ(info.depth(&nodes[3]), 2);
+    EXPECT_EQ(info.depth(&nodes[4]), 1);
+    EXPECT_TRUE(info.is_header(&nodes[2]));
+    EXPECT_FALSE(info.is_header(&nodes[3]));
+    EXPECT_TRUE(outer->contains(&nodes[3]));
+    EXPECT_FALSE(inner->contains(&nodes[4]));
+}
+
+TEST(LoopInfoTest, SharedHeader) {
+    // 0 -> (1 | 2), 1 -> 2, 2 -> 3 -> (2 | 4) -> (2 | 5). Both 3 and 4 branch back to 2, which is entered from two
+    // places.
+    std::array<Node, 6> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[0], &nodes[2]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[2], &nodes[3]);
+    graph.connect(&nodes[3], &nodes[2]);
+    graph.connect(&nodes[3], &nodes[4]);
+    graph.connect(&nodes[4], &nodes[2]);
+    graph.connect(&nodes[4], &nodes[5]);
+
+    const auto info = graph.run<LoopFinder>();
+    ASSERT_EQ(info.loops().size(), 1);
+    auto *loop = info.loops()[0].get();
+    EXPECT_EQ(loop->header(), &nodes[2]);
+    EXPECT_EQ(loop->nodes().size(), 3);
+    EXPECT_EQ(loop->latches(), (std::vector<Node *>{&nodes[3], &nodes[4]}));
+    EXPECT_EQ(loop->exits(), std::vector<Node *>{&nodes[5]});
+    EXPECT_EQ(loop->preheader(), nullptr);
+    EXPECT_EQ(loop->depth(), 1);
+}
+
+TEST(LoopInfoTest, SelfLoop) {
+    // 0 -> 1 -> (1 | 2), with 3 unreachable but branching into 1.
+    std::array<Node, 4> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[1], &nodes[1]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[3], &nodes[1]);
+
+    const auto info = graph.run<LoopFinder>();
+    ASSERT_EQ(info.loops().size(), 1);
+    auto *loop = info.loop_of(&nodes[1]);
+    EXPECT_EQ(loop->nodes(), std::vector<Node *>{&nodes[1]});
+    EXPECT_EQ(loop->latches(), std::vector<Node *>{&nodes[1]});
+    EXPECT_EQ(loop->exits(), std::vector<Node *>{&nodes[2]});
+    EXPECT_EQ(info.loop_of(&nodes[3]), nullptr);
+}
+
+TEST(LoopInfoTest, Irreducible) {
+    // 0 -> (1 | 2), 1 <-> 2, 2 -> 3. The cycle can be entered at either node, so neither is a header.
+    std::array<Node, 4> nodes;
+    Graph<Node> graph(&nodes[0]);
+    graph.connect(&nodes[0], &nodes[1]);
+    graph.connect(&nodes[0], &nodes[2]);
+    graph.connect(&nodes[1], &nodes[2]);
+    graph.connect(&nodes[2], &nodes[1]);
+    graph.connect(&nodes[2], &nodes[3]);
+
+    const auto info = graph.run<LoopFinder>();
+    EXPECT_TRUE(info.loops().empty());
+    EXPECT_EQ(info.depth(&nodes[1]), 0);
+}
+
+} // namespace
+} // namespace coel
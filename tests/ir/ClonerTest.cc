@@ -0,0 +1,95 @@
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Cloner.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <iterator>
+#include <vector>
+
+namespace coel::ir {
+namespace {
+
+const Type *u32() {
+    return IntegerType::get(32);
+}
+
+TEST(ClonerTest, Clone) {
+    Unit unit;
+    std::array<const Type *, 1> params{u32()};
+    auto *callee = unit.append_function("callee", u32(), params);
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *exit = function->append_block();
+    auto *loop = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    entry->append<StoreInst>(var, function->argument(0));
+    entry->append<BranchInst>(loop);
+    // Uses a value defined in a later block.
+    exit->append<RetInst>(loop->append<CallInst>(callee, std::vector<Value *>{loop->append<LoadInst>(var)}));
+    loop->append<BranchInst>(exit);
+
+    auto copy = clone(*function);
+    EXPECT_EQ(copy->name(), "function");
+    EXPECT_EQ(copy->type(), u32());
+    ASSERT_EQ(copy->arguments().size(), 1);
+    ASSERT_EQ(copy->stack_slots().size(), 1);
+    auto *clone_var = *copy->stack_slots().begin();
+    EXPECT_NE(clone_var, var);
+
+    std::vector<BasicBlock *> blocks;
+    for (auto *block : *copy) {
+        blocks.push_back(block);
+    }
+    ASSERT_EQ(blocks.size(), 3);
+    auto *clone_store = (*blocks[0]->begin())->as_non_null<StoreInst>();
+    EXPECT_EQ(clone_store->ptr(), clone_var);
+    EXPECT_EQ(clone_store->value(), copy->argument(0));
+    EXPECT_EQ((*std::next(blocks[0]->begin()))->as_non_null<BranchInst>()->dst(), blocks[2]);
+
+    auto *clone_load = (*blocks[2]->begin())->as_non_null<LoadInst>();
+    auto *clone_call = (*std::next(blocks[2]->begin()))->as_non_null<CallInst>();
+    EXPECT_EQ(clone_load->ptr(), clone_var);
+    EXPECT_EQ(clone_call->callee(), callee);
+    EXPECT_EQ(clone_call->args(), std::vector<Value *>{clone_load});
+    EXPECT_EQ((*blocks[1]->begin())->as_non_null<RetInst>()->value(), clone_call);
+}
+
+TEST(ClonerTest, ClonePhi) {
+    Unit unit;
+    std::array<const Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *loop = function->append_block();
+    auto *exit = function->append_block();
+    auto *phi = loop->append<PhiInst>(u32());
+    auto *next = loop->append<BinaryInst>(BinaryOp::Sub, phi, Constant::get(u32(), 1));
+    phi->add_incoming(entry, function->argument(0));
+    phi->add_incoming(loop, next);
+    entry->append<BranchInst>(loop);
+    loop->append<CondBranchInst>(loop->append<CompareInst>(CompareOp::Eq, next, Constant::get(u32(), 0)), exit, loop);
+    exit->append<RetInst>(next);
+
+    auto copy = clone(*function);
+    std::vector<BasicBlock *> blocks;
+    for (auto *block : *copy) {
+        blocks.push_back(block);
+    }
+    ASSERT_EQ(blocks.size(), 3);
+    auto *clone_phi = (*blocks[1]->begin())->as_non_null<PhiInst>();
+    auto *clone_next = (*std::next(blocks[1]->begin()))->as_non_null<BinaryInst>();
+    EXPECT_EQ(clone_next->lhs(), clone_phi);
+    ASSERT_EQ(clone_phi->incoming().size(), 2);
+    EXPECT_EQ(clone_phi->incoming_value(blocks[0]), copy->argument(0));
+    EXPECT_EQ(clone_phi->incoming_value(blocks[1]), clone_next);
+    EXPECT_TRUE(clone_next->users().contains(clone_phi));
+    EXPECT_FALSE(next->users().contains(clone_phi));
+}
+
+} // namespace
+} // namespace coel::ir
@@ -0,0 +1,196 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/ControlFlow.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace coel::ir {
+namespace {
+
+using namespace coel::test;
+
+TEST(ControlFlowTest, Successors) {
+    Unit unit;
+    std::array<const Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    auto *cond = entry->append<CompareInst>(CompareOp::Eq, function->argument(0), Constant::get(u32(), 0));
+    entry->append<CondBranchInst>(cond, exit, body);
+    body->append<BranchInst>(exit);
+    exit->append<RetInst>(function->argument(0));
+
+    EXPECT_EQ(successors(entry), (std::vector<BasicBlock *>{exit, body}));
+    EXPECT_EQ(successors(body), std::vector<BasicBlock *>{exit});
+    EXPECT_TRUE(successors(exit).empty());
+    const auto cfg = build_cfg(*function);
+    EXPECT_EQ(cfg.entry(), entry);
+    EXPECT_EQ(cfg.preds(exit), (std::vector<BasicBlock *>{entry, body}));
+}
+
+TEST(ControlFlowTest, SplitCriticalEdges) {
+    // Both entry and loop branch to either loop or exit, so all four edges are critical.
+    Unit unit;
+    std::array<const Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *loop = function->append_block();
+    auto *exit = function->append_block();
+    auto *zero = Constant::get(u32(), 0);
+    auto *phi = loop->append<PhiInst>(u32());
+    auto *next = loop->append<BinaryInst>(BinaryOp::Sub, phi, Constant::get(u32(), 1));
+    phi->add_incoming(entry, function->argument(0));
+    phi->add_incoming(loop, next);
+    auto *result = exit->append<PhiInst>(u32());
+    result->add_incoming(entry, zero);
+    result->add_incoming(loop, next);
+    entry->append<CondBranchInst>(entry->append<CompareInst>(CompareOp::Eq, function->argument(0), zero), exit, loop);
+    loop->append<CondBranchInst>(loop->append<CompareInst>(CompareOp::Eq, next, zero), exit, loop);
+    exit->append<RetInst>(result);
+
+    split_critical_edges(*function);
+    const auto blocks = blocks_of(*function);
+    ASSERT_EQ(blocks.size(), 7);
+    EXPECT_EQ(blocks[0], entry);
+    EXPECT_EQ(blocks[3], loop);
+    EXPECT_EQ(blocks[6], exit);
+
+    // Each split block goes straight after its predecessor and only branches on.
+    auto *entry_branch = entry->terminator()->as_non_null<CondBranchInst>();
+    EXPECT_EQ(entry_branch->true_dst(), blocks[2]);
+    EXPECT_EQ(entry_branch->false_dst(), blocks[1]);
+    auto *loop_branch = loop->terminator()->as_non_null<CondBranchInst>();
+    EXPECT_EQ(loop_branch->true_dst(), blocks[5]);
+    EXPECT_EQ(loop_branch->false_dst(), blocks[4]);
+    for (std::size_t i : {1, 2, 4, 5}) {
+        ASSERT_EQ(std::distance(blocks[i]->begin(), blocks[i]->end()), 1);
+    }
+    EXPECT_EQ(blocks[1]->terminator()->as_non_null<BranchInst>()->dst(), loop);
+    EXPECT_EQ(blocks[2]->terminator()->as_non_null<BranchInst>()->dst(), exit);
+    EXPECT_EQ(blocks[4]->terminator()->as_non_null<BranchInst>()->dst(), loop);
+    EXPECT_EQ(blocks[5]->terminator()->as_non_null<BranchInst>()->dst(), exit);
+
+    EXPECT_EQ(phi->incoming_value(entry), nullptr);
+    EXPECT_EQ(phi->incoming_value(blocks[1]), function->argument(0));
+    EXPECT_EQ(phi->incoming_value(blocks[4]), next);
+    EXPECT_EQ(result->incoming_value(blocks[2]), zero);
+    EXPECT_EQ(result->incoming_value(blocks[5]), next);
+}
+
+TEST(ControlFlowTest, PhiUsers) {
+    Unit unit;
+    std::array<const Type *, 2> params{u32(), u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *lhs = function->append_block();
+    auto *rhs = function->append_block();
+    auto *exit = function->append_block();
+    auto *phi = exit->append<PhiInst>(u32());
+    phi->add_incoming(lhs, function->argument(0));
+    phi->add_incoming(rhs, function->argument(0));
+    EXPECT_TRUE(function->argument(0)->users().contains(phi));
+
+    // The value is still used from the other predecessor.
+    phi->remove_incoming(lhs);
+    EXPECT_TRUE(function->argument(0)->users().contains(phi));
+    phi->replace_uses_of_with(function->argument(0), function->argument(1));
+    EXPECT_FALSE(function->argument(0)->users().contains(phi));
+    EXPECT_TRUE(function->argument(1)->users().contains(phi));
+    EXPECT_EQ(phi->incoming_value(rhs), function->argument(1));
+    phi->replace_uses_of_with(rhs, lhs);
+    EXPECT_EQ(phi->incoming(), (std::vector<std::pair<BasicBlock *, Value *>>{{lhs, function->argument(1)}}));
+
+    exit->remove(phi);
+    EXPECT_TRUE(function->argument(1)->users().empty());
+    entry->append<BranchInst>(exit);
+    exit->append<RetInst>(function->argument(1));
+}
+
+TEST(ControlFlowTest, RepeatedOperands) {
+    Unit unit;
+    std::array<const Type *, 2> params{u32(), u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *lhs = function->argument(0);
+    auto *rhs = function->argument(1);
+    auto *sum = entry->append<BinaryInst>(BinaryOp::Add, lhs, rhs);
+    auto *call = entry->append<CallInst>(function, std::vector<Value *>{sum, sum});
+    auto *ret = entry->append<RetInst>(call);
+
+    // Replacing one operand with the other leaves the add using the same value twice.
+    sum->replace_uses_of_with(rhs, lhs);
+    EXPECT_EQ(sum->rhs(), lhs);
+    EXPECT_TRUE(lhs->users().contains(sum));
+    EXPECT_TRUE(rhs->users().empty());
+    sum->set_lhs(rhs);
+    EXPECT_TRUE(lhs->users().contains(sum));
+    EXPECT_TRUE(rhs->users().contains(sum));
+    sum->replace_uses_of_with(rhs, lhs);
+
+    call->replace_uses_of_with(sum, lhs);
+    EXPECT_EQ(call->args(), (std::vector<Value *>{lhs, lhs}));
+    EXPECT_FALSE(sum->users().contains(call));
+    entry->remove(sum);
+    EXPECT_EQ(lhs->users().size(), 1);
+    ret->replace_uses_of_with(call, lhs);
+    entry->remove(call);
+    EXPECT_EQ(lhs->users().size(), 1);
+}
+
+TEST(ControlFlowTest, InsertLoopPreheaders) {
+    // entry -> (left | right) -> header -> (header | exit). The values coming into the header's phi from either side
+    // are merged in the new preheader.
+    Unit unit;
+    std::array<const Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *left = function->append_block();
+    auto *right = function->append_block();
+    auto *header = function->append_block();
+    auto *exit = function->append_block();
+    auto *cond = entry->append<CompareInst>(CompareOp::Eq, function->argument(0), Constant::get(u32(), 0));
+    entry->append<CondBranchInst>(cond, left, right);
+    left->append<BranchInst>(header);
+    right->append<BranchInst>(header);
+    auto *phi = header->append<PhiInst>(u32());
+    auto *next = header->append<BinaryInst>(BinaryOp::Sub, phi, Constant::get(u32(), 1));
+    auto *done = header->append<CompareInst>(CompareOp::Eq, next, Constant::get(u32(), 0));
+    header->append<CondBranchInst>(done, exit, header);
+    auto *one = Constant::get(u32(), 1);
+    phi->add_incoming(left, one);
+    phi->add_incoming(right, function->argument(0));
+    phi->add_incoming(header, next);
+    exit->append<RetInst>(next);
+
+    insert_loop_preheaders(*function);
+    auto blocks = blocks_of(*function);
+    ASSERT_EQ(blocks.size(), 6);
+    auto *preheader = blocks[3];
+    EXPECT_EQ(blocks[4], header);
+    EXPECT_EQ(left->terminator()->as_non_null<BranchInst>()->dst(), preheader);
+    EXPECT_EQ(right->terminator()->as_non_null<BranchInst>()->dst(), preheader);
+    EXPECT_EQ(successors(preheader), std::vector<BasicBlock *>{header});
+    auto *merged = (*preheader->begin())->as_non_null<PhiInst>();
+    EXPECT_EQ(merged->incoming(),
+              (std::vector<std::pair<BasicBlock *, Value *>>{{left, one}, {right, function->argument(0)}}));
+    EXPECT_EQ(phi->incoming(), (std::vector<std::pair<BasicBlock *, Value *>>{{header, next}, {preheader, merged}}));
+
+    // Now that the loop has a preheader, nothing changes.
+    insert_loop_preheaders(*function);
+    EXPECT_EQ(blocks_of(*function).size(), 6);
+}
+
+} // namespace
+} // namespace coel::ir
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+
+#include <cstddef>
+#include <vector>
+
+// Helpers for building and inspecting IR in tests.
+namespace coel::test {
+
+inline const ir::Type *u32() {
+    return ir::IntegerType::get(32);
+}
+
+inline ir::Constant *constant(std::size_t value) {
+    return ir::Constant::get(u32(), value);
+}
+
+inline std::size_t constant_value(const ir::Value *value) {
+    return value->as_non_null<ir::Constant>()->value();
+}
+
+inline std::vector<ir::BasicBlock *> blocks_of(const ir::Function &function) {
+    std::vector<ir::BasicBlock *> blocks;
+    for (auto *block : function) {
+        blocks.push_back(block);
+    }
+    return blocks;
+}
+
+// Returns the instructions of a block of the given kind, or all of them, in order.
+template <typename Inst = ir::Instruction>
+std::vector<Inst *> instructions_of(const ir::BasicBlock *block) {
+    std::vector<Inst *> insts;
+    for (auto *inst : *block) {
+        if (auto *match = inst->as<Inst>()) {
+            insts.push_back(match);
+        }
+    }
+    return insts;
+}
+
+} // namespace coel::test
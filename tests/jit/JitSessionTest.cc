@@ -0,0 +1,577 @@
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/support/Assert.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace coel::jit {
+namespace {
+
+const ir::Type *u32() {
+    return ir::IntegerType::get(32);
+}
+
+ir::Constant *constant(std::size_t value) {
+    return ir::Constant::get(u32(), value);
+}
+
+std::uintptr_t s_frame_alignment = 0;
+
+std::uint32_t multiply_add(std::uint32_t lhs, std::uint32_t rhs) {
+    s_frame_alignment = reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0)) % 16;
+    return lhs * 3 + rhs;
+}
+
+// Overwrites every caller-saved register that isn't used for the arguments or the return value.
+std::uint32_t clobbering_multiply_add(std::uint32_t lhs, std::uint32_t rhs) {
+    asm volatile("mov $-1, %%rsi\n"
+                 "mov $-1, %%rdi\n"
+                 "mov $-1, %%rcx\n"
+                 "mov $-1, %%rdx\n"
+                 "mov $-1, %%r8\n"
+                 "mov $-1, %%r9\n"
+                 "mov $-1, %%r10\n"
+                 "mov $-1, %%r11\n"
+                 :
+                 :
+                 : "rsi", "rdi", "rcx", "rdx", "r8", "r9", "r10", "r11");
+    return lhs * 3 + rhs;
+}
+
+TEST(JitSessionTest, Arguments) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *sub = unit.append_function("sub", u32(), params);
+    auto *entry = sub->append_block();
+    entry->append<ir::RetInst>(entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, sub->argument(0), sub->argument(1)));
+
+    JitSession session(unit);
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>("sub");
+    ASSERT_NE(function, nullptr);
+    EXPECT_EQ(function(50, 8), 42);
+    EXPECT_EQ(function(7, 7), 0);
+}
+
+TEST(JitSessionTest, CompareBranch) {
+    auto expected = [](ir::CompareOp op, std::uint32_t lhs, std::uint32_t rhs) {
+        const auto signed_lhs = static_cast<std::int32_t>(lhs);
+        const auto signed_rhs = static_cast<std::int32_t>(rhs);
+        switch (op) {
+        case ir::CompareOp::Eq:
+            return lhs == rhs;
+        case ir::CompareOp::Ne:
+            return lhs != rhs;
+        case ir::CompareOp::Lt:
+            return signed_lhs < signed_rhs;
+        case ir::CompareOp::Gt:
+            return signed_lhs > signed_rhs;
+        case ir::CompareOp::Le:
+            return signed_lhs <= signed_rhs;
+        case ir::CompareOp::Ge:
+            return signed_lhs >= signed_rhs;
+        case ir::CompareOp::ULt:
+            return lhs < rhs;
+        case ir::CompareOp::UGt:
+            return lhs > rhs;
+        case ir::CompareOp::ULe:
+            return lhs <= rhs;
+        case ir::CompareOp::UGe:
+            return lhs >= rhs;
+        }
+        COEL_ENSURE_NOT_REACHED();
+    };
+    std::array ops{ir::CompareOp::Eq, ir::CompareOp::Ne,  ir::CompareOp::Lt,  ir::CompareOp::Gt,  ir::CompareOp::Le,
+                   ir::CompareOp::Ge, ir::CompareOp::ULt, ir::CompareOp::UGt, ir::CompareOp::ULe, ir::CompareOp::UGe};
+    std::array<std::pair<std::uint32_t, std::uint32_t>, 5> values{
+        {{1, 2}, {2, 1}, {7, 7}, {0xffffffff, 1}, {1, 0xffffffff}}};
+    for (auto op : ops) {
+        ir::Unit unit;
+        std::array<const ir::Type *, 2> params{u32(), u32()};
+        auto *test = unit.append_function("test", u32(), params);
+        auto *entry = test->append_block();
+        auto *true_dst = test->append_block();
+        auto *false_dst = test->append_block();
+        auto *cond = entry->append<ir::CompareInst>(op, test->argument(0), test->argument(1));
+        entry->append<ir::CondBranchInst>(cond, true_dst, false_dst);
+        true_dst->append<ir::RetInst>(constant(1));
+        false_dst->append<ir::RetInst>(constant(0));
+
+        JitSession session(unit);
+        auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>("test");
+        for (auto [lhs, rhs] : values) {
+            EXPECT_EQ(function(lhs, rhs), expected(op, lhs, rhs) ? 1 : 0)
+                << static_cast<int>(op) << ": " << lhs << ", " << rhs;
+        }
+    }
+}
+
+TEST(JitSessionTest, CountDown) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *count = unit.append_function("count", u32(), params);
+    auto *entry = count->append_block();
+    auto *body = count->append_block();
+    auto *exit = count->append_block();
+    auto *remaining = count->append_stack_slot(u32());
+    auto *total = count->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(remaining, count->argument(0));
+    entry->append<ir::StoreInst>(total, constant(0));
+    entry->append<ir::BranchInst>(body);
+    auto *sum = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(total), constant(3));
+    body->append<ir::StoreInst>(total, sum);
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Sub, body->append<ir::LoadInst>(remaining), constant(1));
+    body->append<ir::StoreInst>(remaining, next);
+    auto *cond = body->append<ir::CompareInst>(ir::CompareOp::Ne, next, constant(0));
+    body->append<ir::CondBranchInst>(cond, body, exit);
+    exit->append<ir::RetInst>(exit->append<ir::LoadInst>(total));
+
+    JitSession session(unit);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>("count");
+    EXPECT_EQ(function(1), 3);
+    EXPECT_EQ(function(14), 42);
+}
+
+TEST(JitSessionTest, NarrowCompare) {
+    ir::Unit unit;
+    const auto *u8 = ir::IntegerType::get(8);
+    const auto *u16 = ir::IntegerType::get(16);
+
+    // Whether adding two bytes overflows, which needs the sum compared at 8 bits.
+    std::array<const ir::Type *, 2> carry_params{u8, u8};
+    auto *carry = unit.append_function("carry", u32(), carry_params);
+    auto *entry = carry->append_block();
+    auto *true_dst = carry->append_block();
+    auto *false_dst = carry->append_block();
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, carry->argument(0), carry->argument(1));
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::ULt, sum, carry->argument(0));
+    entry->append<ir::CondBranchInst>(cond, true_dst, false_dst);
+    true_dst->append<ir::RetInst>(constant(1));
+    false_dst->append<ir::RetInst>(constant(0));
+
+    // Whether a 16-bit value is negative, returning the setcc result.
+    std::array<const ir::Type *, 1> negative_params{u16};
+    auto *negative = unit.append_function("negative", ir::BoolType::get(), negative_params);
+    auto *negative_entry = negative->append_block();
+    negative_entry->append<ir::RetInst>(negative_entry->append<ir::CompareInst>(
+        ir::CompareOp::Lt, negative->argument(0), ir::Constant::get(u16, 0)));
+
+    JitSession session(unit);
+    auto *carry_function = session.function<std::uint32_t(std::uint8_t, std::uint8_t)>("carry");
+    EXPECT_EQ(carry_function(200, 100), 1);
+    EXPECT_EQ(carry_function(100, 100), 0);
+    EXPECT_EQ(carry_function(255, 1), 1);
+    auto *negative_function = session.function<bool(std::uint16_t)>("negative");
+    EXPECT_TRUE(negative_function(0x8000));
+    EXPECT_TRUE(negative_function(0xffff));
+    EXPECT_FALSE(negative_function(0x7fff));
+    EXPECT_FALSE(negative_function(0));
+}
+
+TEST(JitSessionTest, PhiLoop) {
+    // Sums 1 to n with the induction variable and the total carried around the loop in phis. The loop can be left
+    // before the first iteration, making both the entry and back edges critical.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *sum = unit.append_function("sum", u32(), params);
+    auto *entry = sum->append_block();
+    auto *body = sum->append_block();
+    auto *exit = sum->append_block();
+    auto *index = body->append<ir::PhiInst>(u32());
+    auto *total = body->append<ir::PhiInst>(u32());
+    auto *next_total = body->append<ir::BinaryInst>(ir::BinaryOp::Add, total, index);
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Sub, index, constant(1));
+    index->add_incoming(entry, sum->argument(0));
+    index->add_incoming(body, next_index);
+    total->add_incoming(entry, constant(0));
+    total->add_incoming(body, next_total);
+    auto *result = exit->append<ir::PhiInst>(u32());
+    result->add_incoming(entry, constant(0));
+    result->add_incoming(body, next_total);
+    auto *empty = entry->append<ir::CompareInst>(ir::CompareOp::Eq, sum->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(empty, exit, body);
+    auto *done = body->append<ir::CompareInst>(ir::CompareOp::Eq, next_index, constant(0));
+    body->append<ir::CondBranchInst>(done, exit, body);
+    exit->append<ir::RetInst>(result);
+
+    JitSession session(unit);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>("sum");
+    EXPECT_EQ(function(0), 0);
+    EXPECT_EQ(function(1), 1);
+    EXPECT_EQ(function(10), 55);
+    EXPECT_EQ(function(100), 5050);
+}
+
+TEST(JitSessionTest, PhiSwap) {
+    // Swaps two values on every iteration, which only works if the phis read each other's old values.
+    ir::Unit unit;
+    std::array<const ir::Type *, 3> params{u32(), u32(), u32()};
+    auto *swap = unit.append_function("swap", u32(), params);
+    auto *entry = swap->append_block();
+    auto *body = swap->append_block();
+    auto *exit = swap->append_block();
+    auto *a = body->append<ir::PhiInst>(u32());
+    auto *b = body->append<ir::PhiInst>(u32());
+    auto *count = body->append<ir::PhiInst>(u32());
+    auto *next_count = body->append<ir::BinaryInst>(ir::BinaryOp::Sub, count, constant(1));
+    a->add_incoming(entry, swap->argument(0));
+    a->add_incoming(body, b);
+    b->add_incoming(entry, swap->argument(1));
+    b->add_incoming(body, a);
+    count->add_incoming(entry, swap->argument(2));
+    count->add_incoming(body, next_count);
+    entry->append<ir::BranchInst>(body);
+    auto *done = body->append<ir::CompareInst>(ir::CompareOp::Eq, next_count, constant(0));
+    body->append<ir::CondBranchInst>(done, exit, body);
+    exit->append<ir::RetInst>(exit->append<ir::BinaryInst>(ir::BinaryOp::Sub, a, b));
+
+    JitSession session(unit);
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t, std::uint32_t)>("swap");
+    EXPECT_EQ(function(10, 3, 1), 7);
+    EXPECT_EQ(function(10, 3, 2), static_cast<std::uint32_t>(-7));
+    EXPECT_EQ(function(10, 3, 5), 7);
+}
+
+TEST(JitSessionTest, Call) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> callee_params{u32(), u32()};
+    auto *main = unit.append_function("main", u32(), {});
+    auto *callee = unit.append_function("foo", u32(), callee_params);
+
+    auto *main_entry = main->append_block();
+    auto *var = main->append_stack_slot(u32());
+    main_entry->append<ir::StoreInst>(var, constant(10));
+    auto *call = main_entry->append<ir::CallInst>(
+        callee, std::vector<ir::Value *>{main_entry->append<ir::LoadInst>(var), constant(20)});
+    main_entry->append<ir::RetInst>(call);
+
+    auto *callee_entry = callee->append_block();
+    auto *true_dst = callee->append_block();
+    auto *false_dst = callee->append_block();
+    auto *add = callee_entry->append<ir::BinaryInst>(ir::BinaryOp::Add, constant(5), callee->argument(0));
+    callee_entry->append<ir::CondBranchInst>(ir::Constant::get(ir::BoolType::get(), 1), true_dst, false_dst);
+    true_dst->append<ir::RetInst>(true_dst->append<ir::BinaryInst>(ir::BinaryOp::Add, add, callee->argument(1)));
+    false_dst->append<ir::RetInst>(false_dst->append<ir::BinaryInst>(ir::BinaryOp::Add, add, constant(40)));
+
+    JitSession session(unit);
+    EXPECT_EQ(session.function<std::uint32_t()>(main)(), 35);
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(callee)(1, 2), 8);
+}
+
+TEST(JitSessionTest, ExternalCall) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> helper_params{u32(), u32()};
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *helper = unit.declare_function("multiply_add", u32(), helper_params, reinterpret_cast<void *>(&multiply_add));
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *call = entry->append<ir::CallInst>(helper, std::vector<ir::Value *>{function->argument(0), constant(7)});
+    entry->append<ir::RetInst>(call);
+
+    JitSession session(unit);
+    EXPECT_EQ(session.lookup(helper), reinterpret_cast<void *>(&multiply_add));
+    s_frame_alignment = 1;
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t)>(function)(5), 22);
+    EXPECT_EQ(s_frame_alignment, 0);
+}
+
+TEST(JitSessionTest, ExternalCallPreservesLiveValues) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> helper_params{u32(), u32()};
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *helper = unit.declare_function("clobbering_multiply_add", u32(), helper_params,
+                                         reinterpret_cast<void *>(&clobbering_multiply_add));
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *add = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(100));
+    auto *call = entry->append<ir::CallInst>(helper, std::vector<ir::Value *>{function->argument(0), constant(7)});
+    entry->append<ir::RetInst>(entry->append<ir::BinaryInst>(ir::BinaryOp::Add, add, call));
+
+    JitSession session(unit);
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t)>(function)(5), 127);
+}
+
+TEST(JitSessionTest, Lookup) {
+    ir::Unit unit;
+    auto *function = unit.append_function("answer", u32(), {});
+    function->append_block()->append<ir::RetInst>(constant(42));
+
+    JitSession session(unit);
+    EXPECT_NE(session.lookup(function), nullptr);
+    EXPECT_EQ(session.lookup(function), session.lookup("answer"));
+    EXPECT_EQ(session.lookup("missing"), nullptr);
+    EXPECT_EQ(session.function<std::uint32_t()>("answer")(), 42);
+}
+
+TEST(JitSessionTest, LazyCompilesOnFirstCall) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *sub = unit.append_function("sub", u32(), params);
+    auto *sub_entry = sub->append_block();
+    sub_entry->append<ir::RetInst>(
+        sub_entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, sub->argument(0), sub->argument(1)));
+    auto *unused = unit.append_function("unused", u32(), {});
+    unused->append_block()->append<ir::RetInst>(constant(1));
+
+    JitSession session(unit, {.lazy = true});
+    auto *stub = session.lookup(sub);
+    auto *unused_stub = session.lookup(unused);
+    ASSERT_NE(stub, nullptr);
+    ASSERT_NE(unused_stub, nullptr);
+
+    // The stub stays callable after the function has been compiled.
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sub);
+    EXPECT_EQ(function(50, 8), 42);
+    EXPECT_NE(session.lookup(sub), stub);
+    EXPECT_EQ(session.lookup(unused), unused_stub);
+    EXPECT_EQ(function(7, 7), 0);
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sub)(9, 4), 5);
+}
+
+TEST(JitSessionTest, LazyCall) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> helper_params{u32(), u32()};
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *helper = unit.declare_function("multiply_add", u32(), helper_params, reinterpret_cast<void *>(&multiply_add));
+    auto *main = unit.append_function("main", u32(), params);
+    auto *callee = unit.append_function("callee", u32(), params);
+
+    auto *main_entry = main->append_block();
+    auto *first = main_entry->append<ir::CallInst>(callee, std::vector<ir::Value *>{main->argument(0)});
+    auto *second = main_entry->append<ir::CallInst>(callee, std::vector<ir::Value *>{first});
+    main_entry->append<ir::RetInst>(second);
+
+    auto *callee_entry = callee->append_block();
+    callee_entry->append<ir::RetInst>(
+        callee_entry->append<ir::CallInst>(helper, std::vector<ir::Value *>{callee->argument(0), constant(1)}));
+
+    JitSession session(unit, {.lazy = true});
+    auto *callee_stub = session.lookup(callee);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>(main);
+    EXPECT_EQ(function(2), 22);
+    EXPECT_NE(session.lookup(callee), callee_stub);
+    EXPECT_EQ(function(1), 13);
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t)>("callee")(3), 10);
+}
+
+// Waits for the background thread to recompile the function, returning its new address.
+void *wait_for_tier_up(const JitSession &session, const ir::Function *function, void *baseline) {
+    for (int i = 0; i < 5000 && session.lookup(function) == baseline; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return session.lookup(function);
+}
+
+TEST(JitSessionTest, TieredEntryCounter) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *sub = unit.append_function("sub", u32(), params);
+    auto *entry = sub->append_block();
+    entry->append<ir::RetInst>(entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, sub->argument(0), sub->argument(1)));
+
+    std::atomic<int> optimised = 0;
+    JitOptions options{.tiered = true, .tier_up_threshold = 10, .tier_up_interval = std::chrono::milliseconds(1)};
+    options.optimise = [&](ir::Function &function) {
+        EXPECT_NE(&function, sub);
+        optimised++;
+    };
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sub);
+    auto *baseline = session.lookup(sub);
+    for (std::uint32_t i = 0; i < 10; i++) {
+        EXPECT_EQ(function(50, i), 50 - i);
+    }
+    EXPECT_NE(wait_for_tier_up(session, sub, baseline), baseline);
+    EXPECT_EQ(optimised, 1);
+
+    // Both the stub and the old entry point now lead to the optimised code.
+    EXPECT_EQ(function(50, 8), 42);
+    EXPECT_EQ(reinterpret_cast<std::uint32_t (*)(std::uint32_t, std::uint32_t)>(baseline)(7, 7), 0);
+    EXPECT_EQ(session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sub)(9, 4), 5);
+}
+
+TEST(JitSessionTest, TieredBackEdgeCounter) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *count = unit.append_function("count", u32(), params);
+    auto *entry = count->append_block();
+    auto *header = count->append_block();
+    auto *body = count->append_block();
+    auto *exit = count->append_block();
+    auto *var = count->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(var, constant(0));
+    entry->append<ir::BranchInst>(header);
+    auto *value = header->append<ir::LoadInst>(var);
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::Lt, value, count->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(var), constant(1));
+    body->append<ir::StoreInst>(var, next);
+    body->append<ir::BranchInst>(header);
+    exit->append<ir::RetInst>(exit->append<ir::LoadInst>(var));
+
+    JitOptions options{.tiered = true, .tier_up_threshold = 100, .tier_up_interval = std::chrono::milliseconds(1)};
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>(count);
+    auto *baseline = session.lookup(count);
+
+    // A single call that loops enough is hot.
+    EXPECT_EQ(function(200), 200);
+    EXPECT_NE(wait_for_tier_up(session, count, baseline), baseline);
+    EXPECT_EQ(function(5), 5);
+}
+
+TEST(JitSessionTest, TieredCondBranchBackEdge) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *count = unit.append_function("count", u32(), params);
+    auto *entry = count->append_block();
+    auto *body = count->append_block();
+    auto *exit = count->append_block();
+    auto *var = count->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(var, constant(0));
+    entry->append<ir::BranchInst>(body);
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(var), constant(1));
+    body->append<ir::StoreInst>(var, next);
+    auto *cond = body->append<ir::CompareInst>(ir::CompareOp::Lt, body->append<ir::LoadInst>(var), count->argument(0));
+    body->append<ir::CondBranchInst>(cond, body, exit);
+    exit->append<ir::RetInst>(exit->append<ir::LoadInst>(var));
+
+    JitOptions options{.tiered = true, .tier_up_threshold = 100, .tier_up_interval = std::chrono::milliseconds(1)};
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>(count);
+    auto *baseline = session.lookup(count);
+    EXPECT_EQ(function(200), 200);
+    EXPECT_NE(wait_for_tier_up(session, count, baseline), baseline);
+    EXPECT_EQ(function(5), 5);
+}
+
+TEST(JitSessionTest, TieredCall) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *main = unit.append_function("main", u32(), params);
+    auto *callee = unit.append_function("callee", u32(), params);
+    auto *main_entry = main->append_block();
+    main_entry->append<ir::RetInst>(
+        main_entry->append<ir::CallInst>(callee, std::vector<ir::Value *>{main->argument(0)}));
+    auto *callee_entry = callee->append_block();
+    callee_entry->append<ir::RetInst>(
+        callee_entry->append<ir::BinaryInst>(ir::BinaryOp::Add, callee->argument(0), constant(1)));
+
+    JitOptions options{.tiered = true, .tier_up_threshold = 10, .tier_up_interval = std::chrono::milliseconds(1)};
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>(main);
+    auto *callee_baseline = session.lookup(callee);
+    for (std::uint32_t i = 0; i < 10; i++) {
+        EXPECT_EQ(function(i), i + 1);
+    }
+    EXPECT_NE(wait_for_tier_up(session, callee, callee_baseline), callee_baseline);
+    EXPECT_EQ(function(41), 42);
+}
+
+TEST(JitSessionTest, OnStackReplacement) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *sum = unit.append_function("sum", u32(), params);
+    auto *entry = sum->append_block();
+    auto *header = sum->append_block();
+    auto *body = sum->append_block();
+    auto *exit = sum->append_block();
+    auto *total = sum->append_stack_slot(u32());
+    auto *index = sum->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(total, constant(0));
+    entry->append<ir::StoreInst>(index, constant(0));
+    auto *step = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, sum->argument(1), constant(1));
+    entry->append<ir::BranchInst>(header);
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::Lt, header->append<ir::LoadInst>(index),
+                                                 sum->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next_total = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(total), step);
+    body->append<ir::StoreInst>(total, next_total);
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(index), constant(1));
+    body->append<ir::StoreInst>(index, next_index);
+    body->append<ir::BranchInst>(header);
+    exit->append<ir::RetInst>(exit->append<ir::LoadInst>(total));
+
+    std::vector<std::string> optimised;
+    JitOptions options{.tiered = true, .tier_up_threshold = UINT64_MAX, .osr = true, .osr_threshold = 50};
+    options.optimise = [&](ir::Function &function) {
+        optimised.push_back(function.name());
+    };
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sum);
+
+    // The loop stays in the baseline code until the variant is entered part way through.
+    EXPECT_EQ(function(20, 1), 40);
+    EXPECT_TRUE(optimised.empty());
+    EXPECT_EQ(function(200, 3), 800);
+    EXPECT_EQ(optimised, std::vector<std::string>{"sum.osr0"});
+    EXPECT_EQ(function(100, 2), 300);
+    EXPECT_EQ(optimised.size(), 1);
+}
+
+TEST(JitSessionTest, OnStackReplacementPhis) {
+    // The header's phis are passed to the variant with the values they take on along whichever back edge got hot, and
+    // the phi in the exit merges in a value from before the loop.
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *sum = unit.append_function("sum", u32(), params);
+    auto *entry = sum->append_block();
+    auto *header = sum->append_block();
+    auto *body = sum->append_block();
+    auto *small = sum->append_block();
+    auto *large = sum->append_block();
+    auto *exit = sum->append_block();
+    auto *empty = entry->append<ir::CompareInst>(ir::CompareOp::Eq, sum->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(empty, exit, header);
+    auto *index = header->append<ir::PhiInst>(u32());
+    auto *total = header->append<ir::PhiInst>(u32());
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::ULt, index, sum->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    auto *is_small = body->append<ir::CompareInst>(ir::CompareOp::ULt, index, constant(10));
+    body->append<ir::CondBranchInst>(is_small, small, large);
+    auto *small_total = small->append<ir::BinaryInst>(ir::BinaryOp::Add, total, constant(1));
+    small->append<ir::BranchInst>(header);
+    auto *large_total = large->append<ir::BinaryInst>(ir::BinaryOp::Add, total, sum->argument(1));
+    large->append<ir::BranchInst>(header);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(small, next_index);
+    index->add_incoming(large, next_index);
+    total->add_incoming(entry, constant(0));
+    total->add_incoming(small, small_total);
+    total->add_incoming(large, large_total);
+    auto *result = exit->append<ir::PhiInst>(u32());
+    result->add_incoming(entry, constant(7));
+    result->add_incoming(header, total);
+    exit->append<ir::RetInst>(result);
+
+    std::vector<std::string> optimised;
+    JitOptions options{.tiered = true, .tier_up_threshold = UINT64_MAX, .osr = true, .osr_threshold = 50};
+    options.optimise = [&](ir::Function &function) {
+        optimised.push_back(function.name());
+    };
+    JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>(sum);
+    EXPECT_EQ(function(0, 5), 7);
+    EXPECT_EQ(function(20, 1), 20);
+    EXPECT_TRUE(optimised.empty());
+    EXPECT_EQ(function(200, 3), 580);
+    EXPECT_EQ(optimised, std::vector<std::string>{"sum.osr0"});
+    EXPECT_EQ(function(100, 2), 190);
+}
+
+} // namespace
+} // namespace coel::jit
@@ -0,0 +1,151 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/CommonSubexpressionElimination.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(CommonSubexpressionEliminationTest, SameBlock) {
+    // The second add has its operands the other way around and a different constant object for the same value.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *first = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    auto *second = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, constant(1), function->argument(0));
+    auto *other = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(2));
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, first, second);
+    auto *difference = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, sum, other);
+    auto *ret = entry->append<ir::RetInst>(difference);
+
+    eliminate_common_subexpressions(*function);
+    EXPECT_EQ(sum->lhs(), first);
+    EXPECT_EQ(sum->rhs(), first);
+    EXPECT_EQ(difference->rhs(), other);
+    EXPECT_EQ(ret->value(), difference);
+    EXPECT_EQ(std::distance(entry->begin(), entry->end()), 5);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(5), 5);
+}
+
+TEST(CommonSubexpressionEliminationTest, SwappedCompare) {
+    // a < b is the same as b > a, but not the same as a > b. Subtraction doesn't commute.
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *function = unit.append_function("function", ir::BoolType::get(), params);
+    auto *entry = function->append_block();
+    auto *lhs = function->argument(0);
+    auto *rhs = function->argument(1);
+    auto *less = entry->append<ir::CompareInst>(ir::CompareOp::Lt, lhs, rhs);
+    auto *greater = entry->append<ir::CompareInst>(ir::CompareOp::Gt, rhs, lhs);
+    auto *opposite = entry->append<ir::CompareInst>(ir::CompareOp::Gt, lhs, rhs);
+    auto *forwards = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, lhs, rhs);
+    auto *backwards = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, rhs, lhs);
+    auto *first = entry->append<ir::RetInst>(greater);
+    auto *second = entry->append<ir::RetInst>(opposite);
+    auto *third = entry->append<ir::CompareInst>(ir::CompareOp::Eq, forwards, backwards);
+
+    eliminate_common_subexpressions(*function);
+    EXPECT_EQ(first->value(), less);
+    EXPECT_EQ(second->value(), opposite);
+    EXPECT_EQ(third->lhs(), forwards);
+    EXPECT_EQ(third->rhs(), backwards);
+}
+
+TEST(CommonSubexpressionEliminationTest, Dominated) {
+    // The add in the entry is reused in both arms, but an add only in one arm isn't available in the other or in the
+    // join.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *left = function->append_block();
+    auto *right = function->append_block();
+    auto *join = function->append_block();
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, sum, constant(0));
+    entry->append<ir::CondBranchInst>(cond, left, right);
+    auto *left_sum = left->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    auto *left_difference = left->append<ir::BinaryInst>(ir::BinaryOp::Sub, left_sum, constant(2));
+    left->append<ir::BranchInst>(join);
+    auto *right_difference = right->append<ir::BinaryInst>(ir::BinaryOp::Sub, sum, constant(2));
+    right->append<ir::BranchInst>(join);
+    auto *phi = join->append<ir::PhiInst>(u32());
+    phi->add_incoming(left, left_difference);
+    phi->add_incoming(right, right_difference);
+    auto *join_difference = join->append<ir::BinaryInst>(ir::BinaryOp::Sub, sum, constant(2));
+    join->append<ir::RetInst>(join->append<ir::BinaryInst>(ir::BinaryOp::Add, phi, join_difference));
+
+    eliminate_common_subexpressions(*function);
+    EXPECT_EQ(left_difference->lhs(), sum);
+    EXPECT_EQ(*left->begin(), left_difference);
+    EXPECT_EQ(phi->incoming_value(left), left_difference);
+    EXPECT_EQ(phi->incoming_value(right), right_difference);
+    EXPECT_EQ(*std::next(join->begin()), join_difference);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(5), 8);
+}
+
+TEST(CommonSubexpressionEliminationTest, Loads) {
+    // Loads can be reused until something is stored. The join can't reuse the load from the entry since one of the
+    // ways into it stores.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *store = function->append_block();
+    auto *skip = function->append_block();
+    auto *join = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(var, function->argument(0));
+    auto *first = entry->append<ir::LoadInst>(var);
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, first, entry->append<ir::LoadInst>(var));
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, sum, constant(0));
+    entry->append<ir::CondBranchInst>(cond, store, skip);
+    auto *incremented = store->append<ir::BinaryInst>(ir::BinaryOp::Add, store->append<ir::LoadInst>(var), constant(1));
+    store->append<ir::StoreInst>(var, incremented);
+    auto *after_store = store->append<ir::LoadInst>(var);
+    store->append<ir::BranchInst>(join);
+    auto *skipped = skip->append<ir::LoadInst>(var);
+    skip->append<ir::BranchInst>(join);
+    auto *phi = join->append<ir::PhiInst>(u32());
+    phi->add_incoming(store, after_store);
+    phi->add_incoming(skip, skipped);
+    auto *joined = join->append<ir::LoadInst>(var);
+    join->append<ir::RetInst>(join->append<ir::BinaryInst>(ir::BinaryOp::Add, phi, joined));
+
+    eliminate_common_subexpressions(*function);
+    EXPECT_EQ(sum->rhs(), first);
+    EXPECT_EQ(incremented->lhs(), first);
+    EXPECT_EQ(phi->incoming_value(store), after_store);
+    EXPECT_EQ(phi->incoming_value(skip), first);
+    EXPECT_EQ(*skip->begin(), skip->terminator());
+    EXPECT_EQ(*std::next(join->begin()), joined);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(0), 2);
+    EXPECT_EQ(compiled(5), 10);
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,145 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/ConstantPropagation.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(ConstantPropagationTest, Fold) {
+    ir::Unit unit;
+    auto *function = unit.append_function("function", u32(), {});
+    auto *entry = function->append_block();
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, constant(0xfffffffe), constant(3));
+    auto *difference = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, sum, constant(2));
+    auto *ret = entry->append<ir::RetInst>(difference);
+
+    propagate_constants(*function);
+    EXPECT_EQ(constant_value(ret->value()), 0xffffffff);
+    EXPECT_EQ(*entry->begin(), ret);
+}
+
+TEST(ConstantPropagationTest, FoldCompare) {
+    // Signed compares look at the sign bit of the operand width rather than of 64 bits.
+    ir::Unit unit;
+    const auto *u8 = ir::IntegerType::get(8);
+    auto *function = unit.append_function("function", ir::BoolType::get(), {});
+    auto *entry = function->append_block();
+    auto *negative = entry->append<ir::CompareInst>(ir::CompareOp::Lt, ir::Constant::get(u8, 0x80),
+                                                    ir::Constant::get(u8, 0));
+    auto *above = entry->append<ir::CompareInst>(ir::CompareOp::UGt, ir::Constant::get(u8, 0x80),
+                                                 ir::Constant::get(u8, 0));
+    auto *wrapped = entry->append<ir::CompareInst>(
+        ir::CompareOp::Eq,
+        entry->append<ir::BinaryInst>(ir::BinaryOp::Add, ir::Constant::get(u8, 0xff), ir::Constant::get(u8, 1)),
+        ir::Constant::get(u8, 0));
+    auto *first = entry->append<ir::RetInst>(negative);
+    auto *second = entry->append<ir::RetInst>(above);
+    auto *third = entry->append<ir::RetInst>(wrapped);
+
+    propagate_constants(*function);
+    EXPECT_EQ(constant_value(first->value()), 1);
+    EXPECT_EQ(constant_value(second->value()), 1);
+    EXPECT_EQ(constant_value(third->value()), 1);
+}
+
+TEST(ConstantPropagationTest, ConstantBranch) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *true_dst = function->append_block();
+    auto *false_dst = function->append_block();
+    auto *exit = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Ne, constant(1), constant(2));
+    entry->append<ir::CondBranchInst>(cond, true_dst, false_dst);
+    true_dst->append<ir::BranchInst>(exit);
+    auto *dead = false_dst->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    false_dst->append<ir::BranchInst>(exit);
+    auto *phi = exit->append<ir::PhiInst>(u32());
+    phi->add_incoming(true_dst, constant(5));
+    phi->add_incoming(false_dst, dead);
+    auto *ret = exit->append<ir::RetInst>(exit->append<ir::BinaryInst>(ir::BinaryOp::Add, phi, constant(10)));
+
+    propagate_constants(*function);
+    auto *branch = entry->terminator()->as<ir::BranchInst>();
+    ASSERT_NE(branch, nullptr);
+    EXPECT_EQ(branch->dst(), true_dst);
+    EXPECT_EQ(constant_value(ret->value()), 15);
+    EXPECT_TRUE(false_dst->users().empty());
+    EXPECT_EQ(*exit->begin(), ret);
+}
+
+TEST(ConstantPropagationTest, ConstantLoop) {
+    // The phi only ever merges in the same value, even though the loop is entered.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    auto *value = body->append<ir::PhiInst>(u32());
+    auto *index = body->append<ir::PhiInst>(u32());
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    auto *next_value = body->append<ir::BinaryInst>(ir::BinaryOp::Sub, value, constant(0));
+    value->add_incoming(entry, constant(4));
+    value->add_incoming(body, next_value);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(body, next_index);
+    entry->append<ir::BranchInst>(body);
+    auto *cond = body->append<ir::CompareInst>(ir::CompareOp::ULt, next_index, function->argument(0));
+    body->append<ir::CondBranchInst>(cond, body, exit);
+    auto *ret = exit->append<ir::RetInst>(next_value);
+
+    propagate_constants(*function);
+    EXPECT_EQ(constant_value(ret->value()), 4);
+    EXPECT_EQ(next_index->lhs(), index);
+    EXPECT_EQ(index->incoming_value(body), next_index);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(10), 4);
+}
+
+TEST(ConstantPropagationTest, UnreachableLoopExit) {
+    // The exit is only reached through a compare that's always false, so the value coming back around is constant
+    // too.
+    ir::Unit unit;
+    auto *function = unit.append_function("function", u32(), {});
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *latch = function->append_block();
+    auto *exit = function->append_block();
+    auto *phi = header->append<ir::PhiInst>(u32());
+    phi->add_incoming(entry, constant(1));
+    entry->append<ir::BranchInst>(header);
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::Eq, phi, constant(2));
+    header->append<ir::CondBranchInst>(cond, exit, latch);
+    auto *next = latch->append<ir::BinaryInst>(ir::BinaryOp::Sub, phi, constant(0));
+    phi->add_incoming(latch, next);
+    latch->append<ir::BranchInst>(header);
+    auto *ret = exit->append<ir::RetInst>(phi);
+
+    propagate_constants(*function);
+    EXPECT_EQ(header->terminator()->as_non_null<ir::BranchInst>()->dst(), latch);
+    EXPECT_EQ(*header->begin(), header->terminator());
+    EXPECT_EQ(*latch->begin(), latch->terminator());
+    EXPECT_TRUE(exit->users().empty());
+    EXPECT_EQ(constant_value(ret->value()), 1);
+}
+
+} // namespace
+} // namespace coel::opt
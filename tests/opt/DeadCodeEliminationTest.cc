@@ -0,0 +1,112 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/opt/DeadCodeElimination.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(DeadCodeEliminationTest, UnusedInstructions) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *unused = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    entry->append<ir::CompareInst>(ir::CompareOp::Eq, unused, constant(2));
+    auto *used = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, function->argument(0), constant(1));
+    auto *ret = entry->append<ir::RetInst>(used);
+
+    eliminate_dead_code(*function);
+    EXPECT_EQ(*entry->begin(), used);
+    EXPECT_EQ(*std::next(entry->begin()), ret);
+    EXPECT_EQ(std::distance(entry->begin(), entry->end()), 2);
+}
+
+TEST(DeadCodeEliminationTest, DeadPhiCycle) {
+    // The phi and the add only use each other, so neither has an effect.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    auto *phi = body->append<ir::PhiInst>(u32());
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Add, phi, constant(1));
+    phi->add_incoming(entry, constant(0));
+    phi->add_incoming(body, next);
+    entry->append<ir::BranchInst>(body);
+    auto *cond = body->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    body->append<ir::CondBranchInst>(cond, exit, body);
+    exit->append<ir::RetInst>(function->argument(0));
+
+    eliminate_dead_code(*function);
+    EXPECT_EQ(*body->begin(), cond);
+    EXPECT_EQ(std::distance(body->begin(), body->end()), 2);
+}
+
+TEST(DeadCodeEliminationTest, UnreachableBlocks) {
+    // Two unreachable blocks branch to each other and into the exit, whose phi has an incoming value from one of them.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *dead = function->append_block();
+    auto *dead_loop = function->append_block();
+    auto *exit = function->append_block();
+    entry->append<ir::BranchInst>(exit);
+    auto *value = dead->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    dead->append<ir::BranchInst>(dead_loop);
+    auto *dead_phi = dead_loop->append<ir::PhiInst>(u32());
+    dead_phi->add_incoming(dead, value);
+    auto *dead_cond = dead_loop->append<ir::CompareInst>(ir::CompareOp::Eq, dead_phi, constant(0));
+    dead_loop->append<ir::CondBranchInst>(dead_cond, exit, dead);
+    auto *one = constant(1);
+    auto *phi = exit->append<ir::PhiInst>(u32());
+    phi->add_incoming(entry, one);
+    phi->add_incoming(dead_loop, dead_phi);
+    auto *ret = exit->append<ir::RetInst>(phi);
+
+    eliminate_dead_code(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, exit}));
+    EXPECT_EQ(phi->incoming(), (std::vector<std::pair<ir::BasicBlock *, ir::Value *>>{{entry, one}}));
+    EXPECT_EQ(ret->value(), phi);
+    EXPECT_EQ(function->argument(0)->users().size(), 0);
+}
+
+TEST(DeadCodeEliminationTest, DeadStackSlot) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *stored = function->append_stack_slot(u32());
+    auto *loaded = function->append_stack_slot(u32());
+    function->append_stack_slot(u32());
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    entry->append<ir::StoreInst>(stored, sum);
+    entry->append<ir::StoreInst>(loaded, function->argument(0));
+    auto *ret = entry->append<ir::RetInst>(entry->append<ir::LoadInst>(loaded));
+
+    eliminate_dead_code(*function);
+    ASSERT_EQ(function->stack_slots().size(), 1);
+    EXPECT_EQ(*function->stack_slots().begin(), loaded);
+    EXPECT_EQ(std::distance(entry->begin(), entry->end()), 3);
+    EXPECT_TRUE((*entry->begin())->is<ir::StoreInst>());
+    EXPECT_EQ(entry->terminator(), ret);
+}
+
+} // namespace
+} // namespace coel::opt
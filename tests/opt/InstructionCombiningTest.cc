@@ -0,0 +1,121 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/InstructionCombining.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(InstructionCombiningTest, Identities) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *x = function->argument(0);
+    auto *y = function->argument(1);
+    auto *plus_zero = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, x, constant(0));
+    auto *minus_zero = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, plus_zero, constant(0));
+    auto *zero = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, y, y);
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, minus_zero, zero);
+    auto *ret = entry->append<ir::RetInst>(sum);
+
+    combine_instructions(*function);
+    EXPECT_EQ(ret->value(), x);
+    EXPECT_EQ(*entry->begin(), ret);
+}
+
+TEST(InstructionCombiningTest, Reassociate) {
+    // (5 + a) + 3 becomes a + 8, and (a - 10) + 4 becomes a - 6 rather than a + 0xfffffffa.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *a = function->argument(0);
+    auto *inner = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, constant(5), a);
+    auto *outer = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, inner, constant(3));
+    auto *first = entry->append<ir::RetInst>(outer);
+    auto *difference = entry->append<ir::BinaryInst>(ir::BinaryOp::Sub, a, constant(10));
+    auto *second = entry->append<ir::RetInst>(entry->append<ir::BinaryInst>(ir::BinaryOp::Add, difference,
+                                                                            constant(4)));
+
+    combine_instructions(*function);
+    auto *combined = first->value()->as_non_null<ir::BinaryInst>();
+    EXPECT_EQ(combined->op(), ir::BinaryOp::Add);
+    EXPECT_EQ(combined->lhs(), a);
+    EXPECT_EQ(constant_value(combined->rhs()), 8);
+    combined = second->value()->as_non_null<ir::BinaryInst>();
+    EXPECT_EQ(combined->op(), ir::BinaryOp::Sub);
+    EXPECT_EQ(combined->lhs(), a);
+    EXPECT_EQ(constant_value(combined->rhs()), 6);
+    EXPECT_EQ(std::distance(entry->begin(), entry->end()), 4);
+}
+
+TEST(InstructionCombiningTest, Compare) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", ir::BoolType::get(), params);
+    auto *entry = function->append_block();
+    auto *x = function->argument(0);
+    auto *swapped = entry->append<ir::RetInst>(entry->append<ir::CompareInst>(ir::CompareOp::ULt, constant(7), x));
+    auto *offset = entry->append<ir::RetInst>(entry->append<ir::CompareInst>(
+        ir::CompareOp::Eq, entry->append<ir::BinaryInst>(ir::BinaryOp::Add, x, constant(3)), constant(1)));
+    auto *same = entry->append<ir::RetInst>(entry->append<ir::CompareInst>(ir::CompareOp::Le, x, x));
+    auto *folded = entry->append<ir::RetInst>(entry->append<ir::CompareInst>(ir::CompareOp::Gt, constant(7),
+                                                                             constant(0xffffffff)));
+
+    combine_instructions(*function);
+    auto *compare = swapped->value()->as_non_null<ir::CompareInst>();
+    EXPECT_EQ(compare->op(), ir::CompareOp::UGt);
+    EXPECT_EQ(compare->lhs(), x);
+    EXPECT_EQ(constant_value(compare->rhs()), 7);
+    compare = offset->value()->as_non_null<ir::CompareInst>();
+    EXPECT_EQ(compare->op(), ir::CompareOp::Eq);
+    EXPECT_EQ(compare->lhs(), x);
+    EXPECT_EQ(constant_value(compare->rhs()), 0xfffffffe);
+    EXPECT_EQ(constant_value(same->value()), 1);
+    EXPECT_EQ(constant_value(folded->value()), 1);
+}
+
+TEST(InstructionCombiningTest, Chain) {
+    // A long chain collapses into a single add, with the intermediate adds removed as they lose their users.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    ir::Value *value = function->argument(0);
+    for (std::size_t i = 0; i < 1000; i++) {
+        const auto op = i % 3 == 0 ? ir::BinaryOp::Sub : ir::BinaryOp::Add;
+        value = entry->append<ir::BinaryInst>(op, value, constant(i % 7));
+    }
+    auto *ret = entry->append<ir::RetInst>(value);
+
+    combine_instructions(*function);
+    EXPECT_EQ(std::distance(entry->begin(), entry->end()), 2);
+    auto *sum = ret->value()->as_non_null<ir::BinaryInst>();
+    EXPECT_EQ(sum->lhs(), function->argument(0));
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    std::uint32_t expected = 100;
+    for (std::uint32_t i = 0; i < 1000; i++) {
+        expected = i % 3 == 0 ? expected - i % 7 : expected + i % 7;
+    }
+    EXPECT_EQ(compiled(100), expected);
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,146 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/LoopInvariantCodeMotion.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(LoopInvariantCodeMotionTest, Hoist) {
+    // sum += (a + b) for a - 1 down to 0. The entry can skip the loop, so it gets a preheader to hoist a + b into.
+    ir::Unit unit;
+    std::array<const ir::Type *, 2> params{u32(), u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *exit = function->append_block();
+    auto *a = function->argument(0);
+    auto *b = function->argument(1);
+    auto *skip = entry->append<ir::CompareInst>(ir::CompareOp::Eq, a, constant(0));
+    entry->append<ir::CondBranchInst>(skip, exit, header);
+    auto *index = header->append<ir::PhiInst>(u32());
+    auto *sum = header->append<ir::PhiInst>(u32());
+    auto *invariant = header->append<ir::BinaryInst>(ir::BinaryOp::Add, a, b);
+    auto *next_sum = header->append<ir::BinaryInst>(ir::BinaryOp::Add, sum, invariant);
+    auto *next_index = header->append<ir::BinaryInst>(ir::BinaryOp::Sub, index, constant(1));
+    auto *done = header->append<ir::CompareInst>(ir::CompareOp::Eq, next_index, constant(0));
+    header->append<ir::CondBranchInst>(done, exit, header);
+    index->add_incoming(entry, a);
+    index->add_incoming(header, next_index);
+    sum->add_incoming(entry, constant(0));
+    sum->add_incoming(header, next_sum);
+    auto *result = exit->append<ir::PhiInst>(u32());
+    result->add_incoming(entry, constant(0));
+    result->add_incoming(header, next_sum);
+    exit->append<ir::RetInst>(result);
+
+    move_loop_invariant_code(*function);
+    auto *preheader = *std::next(function->begin());
+    ASSERT_NE(preheader, header);
+    EXPECT_EQ(instructions_of(preheader), (std::vector<ir::Instruction *>{invariant, preheader->terminator()}));
+    EXPECT_EQ(entry->terminator()->as_non_null<ir::CondBranchInst>()->false_dst(), preheader);
+    EXPECT_EQ(index->incoming_value(preheader), a);
+    EXPECT_EQ(index->incoming_value(entry), nullptr);
+    EXPECT_EQ(*std::next(header->begin(), 2), next_sum);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t, std::uint32_t)>("function");
+    EXPECT_EQ(compiled(0, 5), 0);
+    EXPECT_EQ(compiled(4, 5), 36);
+}
+
+TEST(LoopInvariantCodeMotionTest, Nested) {
+    // The add in the inner loop only depends on an argument, so it ends up outside of both loops. The compare depends
+    // on the outer loop's phi, so it only leaves the inner loop.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *outer = function->append_block();
+    auto *inner = function->append_block();
+    auto *latch = function->append_block();
+    auto *exit = function->append_block();
+    auto *arg = function->argument(0);
+    entry->append<ir::BranchInst>(outer);
+    auto *outer_index = outer->append<ir::PhiInst>(u32());
+    outer->append<ir::BranchInst>(inner);
+    auto *inner_index = inner->append<ir::PhiInst>(u32());
+    auto *invariant = inner->append<ir::BinaryInst>(ir::BinaryOp::Add, arg, constant(1));
+    auto *outer_done = inner->append<ir::CompareInst>(ir::CompareOp::Eq, outer_index, invariant);
+    auto *next_inner = inner->append<ir::BinaryInst>(ir::BinaryOp::Add, inner_index, constant(1));
+    auto *inner_done = inner->append<ir::CompareInst>(ir::CompareOp::Eq, next_inner, constant(3));
+    inner->append<ir::CondBranchInst>(inner_done, latch, inner);
+    auto *next_outer = latch->append<ir::BinaryInst>(ir::BinaryOp::Add, outer_index, constant(1));
+    latch->append<ir::CondBranchInst>(outer_done, exit, outer);
+    outer_index->add_incoming(entry, constant(0));
+    outer_index->add_incoming(latch, next_outer);
+    inner_index->add_incoming(outer, constant(0));
+    inner_index->add_incoming(inner, next_inner);
+    exit->append<ir::RetInst>(next_outer);
+
+    move_loop_invariant_code(*function);
+    EXPECT_EQ(instructions_of(entry), (std::vector<ir::Instruction *>{invariant, entry->terminator()}));
+    EXPECT_EQ(*std::next(outer->begin()), outer_done);
+    EXPECT_EQ(*std::next(inner->begin()), next_inner);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(4), 6);
+}
+
+TEST(LoopInvariantCodeMotionTest, Memory) {
+    // The load of limit is hoisted since nothing in the loop stores to it, but the load of total isn't. The store to
+    // last is sunk into the exit, since only the value stored on the way out is ever seen.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    auto *limit = function->append_stack_slot(u32());
+    auto *total = function->append_stack_slot(u32());
+    auto *last = function->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(limit, function->argument(0));
+    entry->append<ir::StoreInst>(total, constant(0));
+    entry->append<ir::BranchInst>(body);
+    auto *index = body->append<ir::PhiInst>(u32());
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    auto *total_load = body->append<ir::LoadInst>(total);
+    body->append<ir::StoreInst>(total, body->append<ir::BinaryInst>(ir::BinaryOp::Add, total_load, next_index));
+    auto *store_last = body->append<ir::StoreInst>(last, next_index);
+    auto *limit_load = body->append<ir::LoadInst>(limit);
+    auto *done = body->append<ir::CompareInst>(ir::CompareOp::UGe, next_index, limit_load);
+    body->append<ir::CondBranchInst>(done, exit, body);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(body, next_index);
+    exit->append<ir::RetInst>(exit->append<ir::BinaryInst>(ir::BinaryOp::Add, exit->append<ir::LoadInst>(total),
+                                                           exit->append<ir::LoadInst>(last)));
+
+    move_loop_invariant_code(*function);
+    EXPECT_EQ(instructions_of(entry)[2], limit_load);
+    EXPECT_EQ(*std::next(body->begin(), 2), total_load);
+    EXPECT_EQ(*exit->begin(), store_last);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(1), 2);
+    EXPECT_EQ(compiled(10), 65);
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,181 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/LoopRotation.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(LoopRotationTest, WhileLoop) {
+    // sum = 0; i = 0; while (i < n) { sum += i; i++; } return sum;
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    entry->append<ir::BranchInst>(header);
+    auto *index = header->append<ir::PhiInst>(u32());
+    auto *sum = header->append<ir::PhiInst>(u32());
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::ULt, index, function->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next_sum = body->append<ir::BinaryInst>(ir::BinaryOp::Add, sum, index);
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    body->append<ir::BranchInst>(header);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(body, next_index);
+    sum->add_incoming(entry, constant(0));
+    sum->add_incoming(body, next_sum);
+    auto *ret = exit->append<ir::RetInst>(sum);
+
+    rotate_loops(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, body, exit}));
+
+    // The test is done before entering the loop and again at the bottom of it.
+    auto *guard = entry->terminator()->as_non_null<ir::CondBranchInst>();
+    EXPECT_EQ(guard->true_dst(), body);
+    EXPECT_EQ(guard->false_dst(), exit);
+    auto *guard_cond = guard->cond()->as_non_null<ir::CompareInst>();
+    EXPECT_EQ(guard_cond->lhs()->as_non_null<ir::Constant>()->value(), 0);
+    auto *latch = body->terminator()->as_non_null<ir::CondBranchInst>();
+    EXPECT_EQ(latch->true_dst(), body);
+    EXPECT_EQ(latch->cond()->as_non_null<ir::CompareInst>()->lhs(), next_index);
+
+    auto body_phis = instructions_of<ir::PhiInst>(body);
+    ASSERT_EQ(body_phis.size(), 2);
+    EXPECT_EQ(next_index->lhs(), body_phis[0]);
+    EXPECT_EQ(next_sum->lhs(), body_phis[1]);
+    EXPECT_EQ(body_phis[1]->incoming_value(body), next_sum);
+    auto exit_phis = instructions_of<ir::PhiInst>(exit);
+    ASSERT_EQ(exit_phis.size(), 1);
+    EXPECT_EQ(ret->value(), exit_phis[0]);
+    EXPECT_EQ(exit_phis[0]->incoming_value(body), next_sum);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(0), 0);
+    EXPECT_EQ(compiled(1), 0);
+    EXPECT_EQ(compiled(5), 10);
+}
+
+TEST(LoopRotationTest, HeaderValues) {
+    // The header works out a value used both in the body and after the loop, and the exit already has a phi.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    entry->append<ir::BranchInst>(header);
+    auto *remaining = header->append<ir::PhiInst>(u32());
+    auto *next = header->append<ir::BinaryInst>(ir::BinaryOp::Sub, remaining, constant(1));
+    auto *done = header->append<ir::CompareInst>(ir::CompareOp::Eq, remaining, constant(0));
+    header->append<ir::CondBranchInst>(done, exit, body);
+    auto *doubled = body->append<ir::BinaryInst>(ir::BinaryOp::Add, next, next);
+    body->append<ir::BranchInst>(header);
+    remaining->add_incoming(entry, function->argument(0));
+    remaining->add_incoming(body, doubled);
+    auto *result = exit->append<ir::PhiInst>(u32());
+    result->add_incoming(header, remaining);
+    exit->append<ir::RetInst>(exit->append<ir::BinaryInst>(ir::BinaryOp::Add, result, next));
+
+    rotate_loops(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, body, exit}));
+    EXPECT_EQ(body->terminator()->as_non_null<ir::CondBranchInst>()->false_dst(), body);
+    EXPECT_EQ(result->incoming_value(entry), function->argument(0));
+    EXPECT_EQ(result->incoming_value(body), doubled);
+    EXPECT_EQ(instructions_of<ir::PhiInst>(body).size(), 1);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    // Either way the loop finishes with remaining at zero and next wrapped around to all ones.
+    EXPECT_EQ(compiled(0), 0xffffffff);
+    EXPECT_EQ(compiled(1), 0xffffffff);
+}
+
+TEST(LoopRotationTest, SharedExit) {
+    // The body can also break out to the exit, which then has two ways in.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *body = function->append_block();
+    auto *latch = function->append_block();
+    auto *exit = function->append_block();
+    entry->append<ir::BranchInst>(header);
+    auto *index = header->append<ir::PhiInst>(u32());
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::ULt, index, constant(10));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *found = body->append<ir::CompareInst>(ir::CompareOp::Eq, index, function->argument(0));
+    body->append<ir::CondBranchInst>(found, exit, latch);
+    auto *next = latch->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    latch->append<ir::BranchInst>(header);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(latch, next);
+    exit->append<ir::RetInst>(constant(0));
+
+    rotate_loops(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, header, body, latch, exit}));
+    EXPECT_TRUE(latch->terminator()->is<ir::BranchInst>());
+}
+
+TEST(LoopRotationTest, UnreachableUse) {
+    // A block that can't be reached uses the header's phi, and merges a value computed from it into a phi after the
+    // loop.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *header = function->append_block();
+    auto *body = function->append_block();
+    auto *exit = function->append_block();
+    auto *dead = function->append_block();
+    auto *tail = function->append_block();
+    entry->append<ir::BranchInst>(header);
+    auto *index = header->append<ir::PhiInst>(u32());
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::ULt, index, function->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(1));
+    body->append<ir::BranchInst>(header);
+    index->add_incoming(entry, constant(0));
+    index->add_incoming(body, next);
+    exit->append<ir::BranchInst>(tail);
+    auto *dead_value = dead->append<ir::BinaryInst>(ir::BinaryOp::Add, index, constant(2));
+    dead->append<ir::BranchInst>(tail);
+    auto *result = tail->append<ir::PhiInst>(u32());
+    result->add_incoming(exit, index);
+    result->add_incoming(dead, dead_value);
+    tail->append<ir::RetInst>(result);
+
+    rotate_loops(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, body, exit, tail}));
+    auto exit_phis = instructions_of<ir::PhiInst>(exit);
+    ASSERT_EQ(exit_phis.size(), 1);
+    EXPECT_EQ(result->incoming().size(), 1);
+    EXPECT_EQ(result->incoming_value(exit), exit_phis[0]);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(0), 0);
+    EXPECT_EQ(compiled(3), 3);
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,197 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/SimplifyCfg.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(SimplifyCfgTest, MergeBlocks) {
+    // A chain of blocks that each branch straight to the next, with a phi that only has the one incoming value.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *middle = function->append_block();
+    auto *exit = function->append_block();
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    entry->append<ir::BranchInst>(middle);
+    auto *phi = middle->append<ir::PhiInst>(u32());
+    phi->add_incoming(entry, sum);
+    auto *difference = middle->append<ir::BinaryInst>(ir::BinaryOp::Sub, phi, constant(3));
+    middle->append<ir::BranchInst>(exit);
+    auto *ret = exit->append<ir::RetInst>(difference);
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry}));
+    EXPECT_EQ(difference->lhs(), sum);
+    EXPECT_EQ(*entry->begin(), sum);
+    EXPECT_EQ(*std::next(entry->begin()), difference);
+    EXPECT_EQ(entry->terminator(), ret);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(4), 2);
+}
+
+TEST(SimplifyCfgTest, ForwardingBlocks) {
+    // entry -> (left | right), left -> join, right -> middle -> join, where left and middle only branch on.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *left = function->append_block();
+    auto *right = function->append_block();
+    auto *middle = function->append_block();
+    auto *join = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, left, right);
+    left->append<ir::BranchInst>(join);
+    auto *value = right->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    right->append<ir::BranchInst>(middle);
+    middle->append<ir::BranchInst>(join);
+    auto *five = constant(5);
+    auto *phi = join->append<ir::PhiInst>(u32());
+    phi->add_incoming(left, five);
+    phi->add_incoming(middle, value);
+    join->append<ir::RetInst>(phi);
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, right, join}));
+    auto *cond_branch = entry->terminator()->as_non_null<ir::CondBranchInst>();
+    EXPECT_EQ(cond_branch->true_dst(), join);
+    EXPECT_EQ(cond_branch->false_dst(), right);
+    EXPECT_EQ(right->terminator()->as_non_null<ir::BranchInst>()->dst(), join);
+    EXPECT_EQ(phi->incoming_value(entry), five);
+    EXPECT_EQ(phi->incoming_value(right), value);
+    EXPECT_EQ(phi->incoming().size(), 2);
+}
+
+TEST(SimplifyCfgTest, ForwardingBlockKept) {
+    // The block is needed to tell the two edges into the join apart.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *middle = function->append_block();
+    auto *join = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, middle, join);
+    middle->append<ir::BranchInst>(join);
+    auto *phi = join->append<ir::PhiInst>(u32());
+    phi->add_incoming(entry, constant(1));
+    phi->add_incoming(middle, constant(2));
+    join->append<ir::RetInst>(phi);
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, middle, join}));
+    EXPECT_EQ(phi->incoming().size(), 2);
+}
+
+TEST(SimplifyCfgTest, CoincidingArms) {
+    // Both ways through the branch give the phi the same value, so which one is taken doesn't matter.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *middle = function->append_block();
+    auto *join = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, middle, join);
+    middle->append<ir::BranchInst>(join);
+    auto *one = constant(1);
+    auto *phi = join->append<ir::PhiInst>(u32());
+    phi->add_incoming(entry, one);
+    phi->add_incoming(middle, constant(1));
+    auto *ret = join->append<ir::RetInst>(phi);
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry}));
+    EXPECT_EQ(entry->terminator(), ret);
+    EXPECT_EQ(ret->value(), one);
+}
+
+TEST(SimplifyCfgTest, ThreadKnownCondition) {
+    // The flag tested in check is a constant coming in from either side, so both sides can skip check.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *zero = function->append_block();
+    auto *nonzero = function->append_block();
+    auto *check = function->append_block();
+    auto *then = function->append_block();
+    auto *otherwise = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, zero, nonzero);
+    zero->append<ir::BranchInst>(check);
+    auto *sum = nonzero->append<ir::BinaryInst>(ir::BinaryOp::Add, function->argument(0), constant(1));
+    nonzero->append<ir::BranchInst>(check);
+    auto *flag = check->append<ir::PhiInst>(u32());
+    flag->add_incoming(zero, constant(1));
+    flag->add_incoming(nonzero, constant(0));
+    auto *set = check->append<ir::CompareInst>(ir::CompareOp::Eq, flag, constant(1));
+    check->append<ir::CondBranchInst>(set, then, otherwise);
+    then->append<ir::RetInst>(constant(10));
+    auto *ret = otherwise->append<ir::RetInst>(sum);
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, nonzero, then}));
+    auto *cond_branch = entry->terminator()->as_non_null<ir::CondBranchInst>();
+    EXPECT_EQ(cond_branch->true_dst(), then);
+    EXPECT_EQ(cond_branch->false_dst(), nonzero);
+    EXPECT_EQ(nonzero->terminator(), ret);
+
+    jit::JitSession session(unit);
+    auto *compiled = session.function<std::uint32_t(std::uint32_t)>("function");
+    EXPECT_EQ(compiled(0), 10);
+    EXPECT_EQ(compiled(5), 6);
+}
+
+TEST(SimplifyCfgTest, ThreadingKeptForLiveValue) {
+    // The phi is used past the branch, where it needs to have been merged.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *left = function->append_block();
+    auto *right = function->append_block();
+    auto *check = function->append_block();
+    auto *then = function->append_block();
+    auto *otherwise = function->append_block();
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, left, right);
+    left->append<ir::StoreInst>(function->append_stack_slot(u32()), function->argument(0));
+    left->append<ir::BranchInst>(check);
+    right->append<ir::BranchInst>(check);
+    auto *flag = check->append<ir::PhiInst>(u32());
+    flag->add_incoming(left, constant(1));
+    flag->add_incoming(right, constant(2));
+    auto *set = check->append<ir::CompareInst>(ir::CompareOp::Eq, flag, constant(1));
+    check->append<ir::CondBranchInst>(set, then, otherwise);
+    then->append<ir::RetInst>(flag);
+    otherwise->append<ir::RetInst>(constant(0));
+
+    simplify_cfg(*function);
+    EXPECT_EQ(blocks_of(*function), (std::vector<ir::BasicBlock *>{entry, left, check, then, otherwise}));
+    EXPECT_EQ(left->terminator()->as_non_null<ir::BranchInst>()->dst(), check);
+    EXPECT_EQ(flag->incoming().size(), 2);
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,195 @@
+#include "ir/IrTestUtils.hh"
+
+#include <coel/ir/BasicBlock.hh>
+#include <coel/ir/Constant.hh>
+#include <coel/ir/Function.hh>
+#include <coel/ir/Instructions.hh>
+#include <coel/ir/Types.hh>
+#include <coel/ir/Unit.hh>
+#include <coel/jit/JitSession.hh>
+#include <coel/opt/StackPromotion.hh>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+
+namespace coel::opt {
+namespace {
+
+using namespace coel::test;
+
+TEST(StackPromotionTest, StraightLine) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(var, function->argument(0));
+    auto *sum = entry->append<ir::BinaryInst>(ir::BinaryOp::Add, entry->append<ir::LoadInst>(var), constant(1));
+    entry->append<ir::StoreInst>(var, sum);
+    auto *ret = entry->append<ir::RetInst>(entry->append<ir::LoadInst>(var));
+
+    promote_stack_slots(*function);
+    EXPECT_TRUE(function->stack_slots().empty());
+    EXPECT_EQ(sum->lhs(), function->argument(0));
+    EXPECT_EQ(ret->value(), sum);
+    EXPECT_EQ(entry->begin()->as<ir::BinaryInst>(), sum);
+}
+
+TEST(StackPromotionTest, Diamond) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *true_dst = function->append_block();
+    auto *false_dst = function->append_block();
+    auto *exit = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    auto *untouched = function->append_stack_slot(u32());
+    auto *seven = constant(7);
+    auto *ten = constant(10);
+    auto *twenty = constant(20);
+    entry->append<ir::StoreInst>(untouched, seven);
+    auto *cond = entry->append<ir::CompareInst>(ir::CompareOp::Eq, function->argument(0), constant(0));
+    entry->append<ir::CondBranchInst>(cond, true_dst, false_dst);
+    true_dst->append<ir::StoreInst>(var, ten);
+    true_dst->append<ir::BranchInst>(exit);
+    false_dst->append<ir::StoreInst>(var, twenty);
+    false_dst->append<ir::BranchInst>(exit);
+    auto *sum = exit->append<ir::BinaryInst>(ir::BinaryOp::Add, exit->append<ir::LoadInst>(var),
+                                             exit->append<ir::LoadInst>(untouched));
+    exit->append<ir::RetInst>(sum);
+
+    promote_stack_slots(*function);
+    EXPECT_TRUE(function->stack_slots().empty());
+
+    // The slot stored to on both sides gets a phi, but the one only stored to in the entry block doesn't.
+    auto phis = instructions_of<ir::PhiInst>(exit);
+    ASSERT_EQ(phis.size(), 1);
+    EXPECT_EQ(*exit->begin(), phis[0]);
+    EXPECT_EQ(phis[0]->incoming_value(true_dst), ten);
+    EXPECT_EQ(phis[0]->incoming_value(false_dst), twenty);
+    EXPECT_EQ(sum->lhs(), phis[0]);
+    EXPECT_EQ(sum->rhs(), seven);
+    for (auto *block : *function) {
+        EXPECT_TRUE(instructions_of<ir::LoadInst>(block).empty());
+        EXPECT_TRUE(instructions_of<ir::StoreInst>(block).empty());
+    }
+}
+
+TEST(StackPromotionTest, Loop) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *count = unit.append_function("count", u32(), params);
+    auto *entry = count->append_block();
+    auto *body = count->append_block();
+    auto *exit = count->append_block();
+    auto *remaining = count->append_stack_slot(u32());
+    auto *total = count->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(remaining, count->argument(0));
+    entry->append<ir::StoreInst>(total, constant(0));
+    entry->append<ir::BranchInst>(body);
+    auto *sum = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(total), constant(3));
+    body->append<ir::StoreInst>(total, sum);
+    auto *next = body->append<ir::BinaryInst>(ir::BinaryOp::Sub, body->append<ir::LoadInst>(remaining), constant(1));
+    body->append<ir::StoreInst>(remaining, next);
+    auto *cond = body->append<ir::CompareInst>(ir::CompareOp::Ne, next, constant(0));
+    body->append<ir::CondBranchInst>(cond, body, exit);
+    auto *ret = exit->append<ir::RetInst>(exit->append<ir::LoadInst>(total));
+
+    promote_stack_slots(*count);
+    EXPECT_TRUE(count->stack_slots().empty());
+    auto phis = instructions_of<ir::PhiInst>(body);
+    ASSERT_EQ(phis.size(), 2);
+    EXPECT_TRUE(instructions_of<ir::PhiInst>(exit).empty());
+    EXPECT_EQ(ret->value(), sum);
+    for (auto *phi : phis) {
+        EXPECT_EQ(phi->incoming().size(), 2);
+        EXPECT_TRUE(phi->incoming_value(body) == sum || phi->incoming_value(body) == next);
+    }
+
+    jit::JitSession session(unit);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>("count");
+    EXPECT_EQ(function(1), 3);
+    EXPECT_EQ(function(14), 42);
+}
+
+TEST(StackPromotionTest, OnStackReplacement) {
+    // The variant entered from the baseline loop takes the slots as arguments and stores them back at entry, which get
+    // promoted along with the rest.
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *sum = unit.append_function("sum", u32(), params);
+    auto *entry = sum->append_block();
+    auto *header = sum->append_block();
+    auto *body = sum->append_block();
+    auto *exit = sum->append_block();
+    auto *total = sum->append_stack_slot(u32());
+    auto *index = sum->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(total, constant(0));
+    entry->append<ir::StoreInst>(index, constant(0));
+    entry->append<ir::BranchInst>(header);
+    auto *cond = header->append<ir::CompareInst>(ir::CompareOp::ULt, header->append<ir::LoadInst>(index),
+                                                 sum->argument(0));
+    header->append<ir::CondBranchInst>(cond, body, exit);
+    auto *next_index = body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(index), constant(1));
+    body->append<ir::StoreInst>(index, next_index);
+    body->append<ir::StoreInst>(
+        total, body->append<ir::BinaryInst>(ir::BinaryOp::Add, body->append<ir::LoadInst>(total), next_index));
+    body->append<ir::BranchInst>(header);
+    exit->append<ir::RetInst>(exit->append<ir::LoadInst>(total));
+
+    std::size_t promoted = 0;
+    jit::JitOptions options{.tiered = true, .tier_up_threshold = UINT64_MAX, .osr = true, .osr_threshold = 50};
+    options.optimise = [&](ir::Function &function) {
+        promote_stack_slots(function);
+        promoted += function.stack_slots().empty() ? 1 : 0;
+    };
+    jit::JitSession session(unit, options);
+    auto *function = session.function<std::uint32_t(std::uint32_t)>(sum);
+    EXPECT_EQ(function(10), 55);
+    EXPECT_EQ(function(100), 5050);
+    EXPECT_EQ(promoted, 1);
+    EXPECT_EQ(function(1000), 500500);
+}
+
+TEST(StackPromotionTest, EscapingSlot) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    auto *ptr = function->append_stack_slot(ir::PointerType::get(u32()));
+    entry->append<ir::StoreInst>(var, function->argument(0));
+    entry->append<ir::StoreInst>(ptr, var);
+    entry->append<ir::RetInst>(entry->append<ir::LoadInst>(var));
+
+    // The address of var is stored, and ptr holds a pointer.
+    promote_stack_slots(*function);
+    EXPECT_EQ(function->stack_slots().size(), 2);
+    EXPECT_EQ(instructions_of<ir::StoreInst>(entry).size(), 2);
+}
+
+TEST(StackPromotionTest, Unreachable) {
+    ir::Unit unit;
+    std::array<const ir::Type *, 1> params{u32()};
+    auto *function = unit.append_function("function", u32(), params);
+    auto *entry = function->append_block();
+    auto *dead = function->append_block();
+    auto *exit = function->append_block();
+    auto *var = function->append_stack_slot(u32());
+    entry->append<ir::StoreInst>(var, function->argument(0));
+    entry->append<ir::BranchInst>(exit);
+    dead->append<ir::StoreInst>(var, dead->append<ir::LoadInst>(var));
+    dead->append<ir::BranchInst>(exit);
+    auto *ret = exit->append<ir::RetInst>(exit->append<ir::LoadInst>(var));
+
+    promote_stack_slots(*function);
+    EXPECT_TRUE(function->stack_slots().empty());
+    EXPECT_EQ(ret->value(), function->argument(0));
+    EXPECT_TRUE(instructions_of<ir::PhiInst>(exit).empty());
+}
+
+} // namespace
+} // namespace coel::opt
@@ -0,0 +1,104 @@
+#include <coel/x86/Backend.hh>
+#include <coel/x86/Builder.hh>
+#include <coel/x86/InstStream.hh>
+#include <coel/x86/MachineInst.hh>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace coel::x86 {
+namespace {
+
+int s_function = 0;
+int s_symbol = 0;
+int s_target = 0;
+
+InstStream call_symbol() {
+    std::vector<MachineInst> insts;
+    Builder(&insts.emplace_back(MachineInst{Opcode::Lbl})).lbl(&s_function);
+    Builder(&insts.emplace_back(MachineInst{Opcode::CallLbl})).lbl(&s_symbol);
+    insts.push_back(MachineInst{Opcode::Ret});
+    return InstStream(insts);
+}
+
+TEST(x86BackendTest, CallNearSymbol) {
+    auto [encoded, label_offsets, external_calls] = encode(call_symbol(), 0x10000000, {{&s_symbol, 0x10001000}});
+    EXPECT_EQ(label_offsets.at(&s_function), 0);
+    ASSERT_EQ(external_calls.size(), 1);
+    EXPECT_EQ(external_calls[0].first, 0);
+    EXPECT_EQ(external_calls[0].second, &s_symbol);
+    ASSERT_EQ(encoded.size(), 6);
+    EXPECT_EQ(encoded[0], 0xe8); // call off32
+    EXPECT_EQ(encoded[1], 0xfb); // 0x1000 - 5
+    EXPECT_EQ(encoded[2], 0x0f);
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0xc3); // ret
+}
+
+TEST(x86BackendTest, CallFarSymbol) {
+    auto [encoded, label_offsets, external_calls] = encode(call_symbol(), 0x10000000, {{&s_symbol, 0x7f0012345678}});
+    EXPECT_TRUE(external_calls.empty());
+    ASSERT_EQ(encoded.size(), 16);
+    EXPECT_EQ(encoded[0], 0xff); // call r/m64
+    EXPECT_EQ(encoded[1], 0x15); // modrm(0b00, 2, [rip]+disp32)
+    EXPECT_EQ(encoded[2], 0x02); // pool slot at 8 - 6
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+    EXPECT_EQ(encoded[6], 0xc3); // ret
+    EXPECT_EQ(encoded[7], 0xcc); // padding
+    EXPECT_EQ(encoded[8], 0x78);
+    EXPECT_EQ(encoded[9], 0x56);
+    EXPECT_EQ(encoded[10], 0x34);
+    EXPECT_EQ(encoded[11], 0x12);
+    EXPECT_EQ(encoded[12], 0x00);
+    EXPECT_EQ(encoded[13], 0x7f);
+    EXPECT_EQ(encoded[14], 0x00);
+    EXPECT_EQ(encoded[15], 0x00);
+}
+
+// Jumps over the given number of rets to a label, followed by a ret and a jump back to the start.
+InstStream jump_over(std::size_t count) {
+    std::vector<MachineInst> insts;
+    Builder(&insts.emplace_back(MachineInst{Opcode::Lbl})).lbl(&s_function);
+    Builder(&insts.emplace_back(MachineInst{Opcode::JneLbl})).lbl(&s_target);
+    insts.insert(insts.end(), count, MachineInst{Opcode::Ret});
+    Builder(&insts.emplace_back(MachineInst{Opcode::Lbl})).lbl(&s_target);
+    insts.push_back(MachineInst{Opcode::Ret});
+    Builder(&insts.emplace_back(MachineInst{Opcode::JmpLbl})).lbl(&s_function);
+    return InstStream(insts);
+}
+
+TEST(x86BackendTest, JumpShort) {
+    auto [encoded, label_offsets, external_calls] = encode(jump_over(1), 0, {});
+    EXPECT_EQ(label_offsets.at(&s_target), 3);
+    ASSERT_EQ(encoded.size(), 6);
+    EXPECT_EQ(encoded[0], 0x75); // jne off8
+    EXPECT_EQ(encoded[1], 0x01);
+    EXPECT_EQ(encoded[4], 0xeb); // jmp off8
+    EXPECT_EQ(encoded[5], 0xfa); // -6
+}
+
+TEST(x86BackendTest, JumpRelaxed) {
+    auto [encoded, label_offsets, external_calls] = encode(jump_over(130), 0, {});
+    EXPECT_EQ(label_offsets.at(&s_target), 136);
+    ASSERT_EQ(encoded.size(), 142);
+    EXPECT_EQ(encoded[0], 0x0f); // jne off32
+    EXPECT_EQ(encoded[1], 0x85);
+    EXPECT_EQ(encoded[2], 0x82); // 130
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+    EXPECT_EQ(encoded[137], 0xe9); // jmp off32
+    EXPECT_EQ(encoded[138], 0x72); // -142
+    EXPECT_EQ(encoded[139], 0xff);
+    EXPECT_EQ(encoded[140], 0xff);
+    EXPECT_EQ(encoded[141], 0xff);
+}
+
+} // namespace
+} // namespace coel::x86
@@ -0,0 +1,64 @@
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachineInst.hh>
+#include <coel/x86/MachinePasses.hh>
+#include <coel/x86/Register.hh>
+
+#include <gtest/gtest.h>
+
+namespace coel::x86 {
+namespace {
+
+int s_function = 0;
+int s_first = 0;
+int s_second = 0;
+
+TEST(x86BranchFoldingTest, JumpToNext) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::JmpLbl).lbl(&s_first);
+    auto *first = function.append_block(&s_first);
+    first->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    fold_branches(function, stats);
+    EXPECT_EQ(stats.jumps_to_next, 1);
+    EXPECT_TRUE(entry->insts().empty());
+    EXPECT_EQ(first->insts().size(), 1);
+}
+
+TEST(x86BranchFoldingTest, CondJumpToNext) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(1).width(32);
+    entry->append(Opcode::JeLbl).lbl(&s_first);
+    entry->append(Opcode::JmpLbl).lbl(&s_second);
+    function.append_block(&s_first)->append(Opcode::Ret);
+    function.append_block(&s_second)->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    fold_branches(function, stats);
+    EXPECT_EQ(stats.inverted_jumps, 1);
+    ASSERT_EQ(entry->insts().size(), 2);
+    EXPECT_EQ(entry->insts()[1].opcode, Opcode::JneLbl);
+    EXPECT_EQ(entry->insts()[1].operands[0].lbl, &s_second);
+}
+
+TEST(x86BranchFoldingTest, JumpElsewhere) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(1).width(32);
+    entry->append(Opcode::JeLbl).lbl(&s_second);
+    entry->append(Opcode::JmpLbl).lbl(&s_function);
+    function.append_block(&s_first)->append(Opcode::Ret);
+    function.append_block(&s_second)->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    fold_branches(function, stats);
+    EXPECT_EQ(stats.jumps_to_next + stats.inverted_jumps, 0);
+    ASSERT_EQ(entry->insts().size(), 3);
+    EXPECT_EQ(entry->insts()[1].opcode, Opcode::JeLbl);
+    EXPECT_EQ(entry->insts()[2].opcode, Opcode::JmpLbl);
+}
+
+} // namespace
+} // namespace coel::x86
@@ -39,16 +39,27 @@ TEST_P(ArithRegRm, Arith16Reg_axBase_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith16Reg_axBase_r11Disp8) {
+TEST_P(ArithRegRm, Arith16Reg_axBase_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 16).reg(Register::rax).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x66);           // operand size override
+    EXPECT_EQ(encoded[1], 0x41);           // REX.B(r11)
+    EXPECT_EQ(encoded[2], encoded_opcode); // opcode r16, r/m64
+    EXPECT_EQ(encoded[3], 0x03);           // modrm(0b00, ax=0, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith16Reg_axBase_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 16).reg(Register::rax).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 5);
     EXPECT_EQ(encoded[0], 0x66);           // operand size override
     EXPECT_EQ(encoded[1], 0x41);           // REX.B(r11)
     EXPECT_EQ(encoded[2], encoded_opcode); // opcode r16, r/m64
     EXPECT_EQ(encoded[3], 0x43);           // modrm(0b01, ax=0, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[4], 0x08);
 }
 
 TEST_P(ArithRegRm, Arith16Reg_r10wBase_rbpDisp8) {
@@ -63,16 +74,27 @@ TEST_P(ArithRegRm, Arith16Reg_r10wBase_rbpDisp8) {
     EXPECT_EQ(encoded[4], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith16Reg_r10wBase_r11Disp8) {
+TEST_P(ArithRegRm, Arith16Reg_r10wBase_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 16).reg(Register::r10).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x66);           // operand size override
+    EXPECT_EQ(encoded[1], 0x45);           // REX.R(r10w) + REX.B(r11)
+    EXPECT_EQ(encoded[2], encoded_opcode); // opcode r16, r/m64
+    EXPECT_EQ(encoded[3], 0x13);           // modrm(0b00, r10w=2, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith16Reg_r10wBase_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 16).reg(Register::r10).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 5);
     EXPECT_EQ(encoded[0], 0x66);           // operand size override
     EXPECT_EQ(encoded[1], 0x45);           // REX.R(r10w) + REX.B(r11)
     EXPECT_EQ(encoded[2], encoded_opcode); // opcode r16, r/m64
     EXPECT_EQ(encoded[3], 0x53);           // modrm(0b01, r10w=2, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[4], 0x08);
 }
 
 TEST_P(ArithRegImm, Arith16Reg_bxImm8) {
@@ -129,15 +151,25 @@ TEST_P(ArithRegRm, Arith32Reg_eaxBase_rbpDisp8) {
     EXPECT_EQ(encoded[2], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith32Reg_eaxBase_r11Disp8) {
+TEST_P(ArithRegRm, Arith32Reg_eaxBase_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 32).reg(Register::rax).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x41);           // REX.B(r11)
+    EXPECT_EQ(encoded[1], encoded_opcode); // opcode r32, r/m64
+    EXPECT_EQ(encoded[2], 0x03);           // modrm(0b00, eax=0, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith32Reg_eaxBase_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 32).reg(Register::rax).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x41);           // REX.B(r11)
     EXPECT_EQ(encoded[1], encoded_opcode); // opcode r32, r/m64
     EXPECT_EQ(encoded[2], 0x43);           // modrm(0b01, eax=0, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST_P(ArithRegRm, Arith32Reg_r10dBase_rbpDisp8) {
@@ -151,15 +183,25 @@ TEST_P(ArithRegRm, Arith32Reg_r10dBase_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith32Reg_r10dBase_r11Disp8) {
+TEST_P(ArithRegRm, Arith32Reg_r10dBase_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 32).reg(Register::r10).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x45);           // REX.R(r10d) + REX.B(r11)
+    EXPECT_EQ(encoded[1], encoded_opcode); // opcode r32, r/m64
+    EXPECT_EQ(encoded[2], 0x13);           // modrm(0b00, r10d=2, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith32Reg_r10dBase_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 32).reg(Register::r10).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x45);           // REX.R(r10d) + REX.B(r11)
     EXPECT_EQ(encoded[1], encoded_opcode); // opcode r32, r/m64
     EXPECT_EQ(encoded[2], 0x53);           // modrm(0b01, r10d=2, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST_P(ArithRegImm, Arith32Reg_ebxImm8) {
@@ -213,15 +255,25 @@ TEST_P(ArithRegRm, Arith64Reg_raxBase_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith64Reg_raxBase_r11Disp8) {
+TEST_P(ArithRegRm, Arith64Reg_raxBase_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 64).reg(Register::rax).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x49);           // REX.W + REX.B(r11)
+    EXPECT_EQ(encoded[1], encoded_opcode); // opcode r64, r/m64
+    EXPECT_EQ(encoded[2], 0x03);           // modrm(0b00, rax=0, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith64Reg_raxBase_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 64).reg(Register::rax).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x49);           // REX.W + REX.B(r11)
     EXPECT_EQ(encoded[1], encoded_opcode); // opcode r64, r/m64
     EXPECT_EQ(encoded[2], 0x43);           // modrm(0b01, rax=0, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST_P(ArithRegRm, Arith64Reg_r10Base_rbpDisp8) {
@@ -235,15 +287,25 @@ TEST_P(ArithRegRm, Arith64Reg_r10Base_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST_P(ArithRegRm, Arith64Reg_r10Base_r11Disp8) {
+TEST_P(ArithRegRm, Arith64Reg_r10Base_r11) {
     auto [opcode, encoded_opcode] = GetParam();
     BUILD(opcode, 64).reg(Register::r10).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x4d);           // REX.W + REX.R(r10) + REX.B(r11)
+    EXPECT_EQ(encoded[1], encoded_opcode); // opcode r64, r/m64
+    EXPECT_EQ(encoded[2], 0x13);           // modrm(0b00, r10=2, [r11-8=rbx])
+}
+
+TEST_P(ArithRegRm, Arith64Reg_r10Base_r11Disp8) {
+    auto [opcode, encoded_opcode] = GetParam();
+    BUILD(opcode, 64).reg(Register::r10).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x4d);           // REX.W + REX.R(r10) + REX.B(r11)
     EXPECT_EQ(encoded[1], encoded_opcode); // opcode r64, r/m64
     EXPECT_EQ(encoded[2], 0x53);           // modrm(0b01, r10=2, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST_P(ArithRegImm, Arith64Reg_rbxImm8) {
@@ -288,18 +350,83 @@ TEST_P(ArithRegReg, Arith64Reg_r11Reg_r12) {
     EXPECT_EQ(encoded[2], 0xe3);           // modrm(0b11, r12=4, r11=3)
 }
 
+TEST_P(ArithRegImm, Arith32Reg_ebxImm8Negative) {
+    auto [opcode, slash] = GetParam();
+    BUILD(opcode, 32).reg(Register::rbx).imm(0xffffff80);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x83);                 // opcode r/m32, imm8
+    EXPECT_EQ(encoded[1], 0xc3 | (slash << 3u)); // modrm(0b11, slash, ebx=3)
+    EXPECT_EQ(encoded[2], 0x80);
+}
+
+TEST_P(ArithRegImm, Arith64Reg_rbxImm32) {
+    auto [opcode, slash] = GetParam();
+    BUILD(opcode, 64).reg(Register::rbx).imm(0x1000);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 7);
+    EXPECT_EQ(encoded[0], 0x48);                 // REX.W
+    EXPECT_EQ(encoded[1], 0x81);                 // opcode r/m64, imm32
+    EXPECT_EQ(encoded[2], 0xc3 | (slash << 3u)); // modrm(0b11, slash, rbx=3)
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x10);
+    EXPECT_EQ(encoded[5], 0x00);
+    EXPECT_EQ(encoded[6], 0x00);
+}
+
+TEST_P(ArithRegImm, Arith16Reg_axImm16) {
+    auto [opcode, slash] = GetParam();
+    BUILD(opcode, 16).reg(Register::rax).imm(0x1234);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x66);                 // operand size override
+    EXPECT_EQ(encoded[1], 0x05 | (slash << 3u)); // opcode ax, imm16
+    EXPECT_EQ(encoded[2], 0x34);
+    EXPECT_EQ(encoded[3], 0x12);
+}
+
+TEST_P(ArithRegImm, Arith64Reg_raxImm32) {
+    auto [opcode, slash] = GetParam();
+    BUILD(opcode, 64).reg(Register::rax).imm(0x1000);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0x48);                 // REX.W
+    EXPECT_EQ(encoded[1], 0x05 | (slash << 3u)); // opcode rax, imm32
+    EXPECT_EQ(encoded[2], 0x00);
+    EXPECT_EQ(encoded[3], 0x10);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+}
+
 INSTANTIATE_TEST_SUITE_P(x86EncoderTest, ArithRegImm,
                          testing::Values(std::pair<Opcode, std::uint8_t>(Opcode::Add, 0),
                                          std::pair<Opcode, std::uint8_t>(Opcode::Sub, 5),
-                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 7)));
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 7),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Xor, 6)));
 INSTANTIATE_TEST_SUITE_P(x86EncoderTest, ArithRegReg,
                          testing::Values(std::pair<Opcode, std::uint8_t>(Opcode::Add, 0x01),
                                          std::pair<Opcode, std::uint8_t>(Opcode::Sub, 0x29),
-                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 0x39)));
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 0x39),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Xor, 0x31)));
 INSTANTIATE_TEST_SUITE_P(x86EncoderTest, ArithRegRm,
                          testing::Values(std::pair<Opcode, std::uint8_t>(Opcode::Add, 0x03),
                                          std::pair<Opcode, std::uint8_t>(Opcode::Sub, 0x2b),
-                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 0x3b)));
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Cmp, 0x3b),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Xor, 0x33)));
+
+TEST(x86EncoderTest, Add64RipDisp32Imm8) {
+    BUILD(Opcode::Add, 64).off(0x100).imm(1);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 8);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0x83); // add r/m64, imm8
+    EXPECT_EQ(encoded[2], 0x05); // modrm(0b00, 0, [rip]+disp32)
+    EXPECT_EQ(encoded[3], 0xf8);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+    EXPECT_EQ(encoded[6], 0x00);
+    EXPECT_EQ(encoded[7], 0x01);
+}
 
 TEST(x86EncoderTest, CallOff32) {
     BUILD(Opcode::Call, 0).off(0);
@@ -312,6 +439,64 @@ TEST(x86EncoderTest, CallOff32) {
     EXPECT_EQ(encoded[4], 0xff);
 }
 
+TEST(x86EncoderTest, CallIndRipDisp32) {
+    BUILD(Opcode::CallInd, 0).off(0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0xff); // call r/m64
+    EXPECT_EQ(encoded[1], 0x15); // modrm(0b00, 2, [rip]+disp32)
+    EXPECT_EQ(encoded[2], 0xfa);
+    EXPECT_EQ(encoded[3], 0xff);
+    EXPECT_EQ(encoded[4], 0xff);
+    EXPECT_EQ(encoded[5], 0xff);
+}
+
+TEST(x86EncoderTest, Dec32Reg_ecx) {
+    BUILD(Opcode::Dec, 32).reg(Register::rcx);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 2);
+    EXPECT_EQ(encoded[0], 0xff); // dec r/m32
+    EXPECT_EQ(encoded[1], 0xc9); // modrm(0b11, 1, ecx=1)
+}
+
+TEST(x86EncoderTest, Inc64Reg_r11) {
+    BUILD(Opcode::Inc, 64).reg(Register::r11);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
+    EXPECT_EQ(encoded[1], 0xff); // inc r/m64
+    EXPECT_EQ(encoded[2], 0xc3); // modrm(0b11, 0, r11=3)
+}
+
+TEST(x86EncoderTest, Lea32BaseIndex) {
+    BUILD(Opcode::Lea, 32).reg(Register::rax).base_index_disp(Register::rbx, Register::rcx, 1, 0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x8d); // lea r32, m
+    EXPECT_EQ(encoded[1], 0x04); // modrm(0b00, eax=0, SIB)
+    EXPECT_EQ(encoded[2], 0x0b); // sib(1, ecx=1, ebx=3)
+}
+
+TEST(x86EncoderTest, Lea64BaseIndex_r13) {
+    BUILD(Opcode::Lea, 64).reg(Register::r8).base_index_disp(Register::r13, Register::r9, 1, 0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 5);
+    EXPECT_EQ(encoded[0], 0x4f); // REX.W + REX.R(r8) + REX.X(r9) + REX.B(r13)
+    EXPECT_EQ(encoded[1], 0x8d); // lea r64, m
+    EXPECT_EQ(encoded[2], 0x44); // modrm(0b01, r8=0, SIB)
+    EXPECT_EQ(encoded[3], 0x0d); // sib(1, r9=1, r13=5)
+    EXPECT_EQ(encoded[4], 0x00);
+}
+
+TEST(x86EncoderTest, Lea32BaseDisp8) {
+    BUILD(Opcode::Lea, 32).reg(Register::rdx).base_disp(Register::rsi, -1);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x8d); // lea r32, m
+    EXPECT_EQ(encoded[1], 0x56); // modrm(0b01, edx=2, [esi]+disp8)
+    EXPECT_EQ(encoded[2], 0xff);
+}
+
 TEST(x86EncoderTest, Leave64) {
     BUILD_NO_OPERANDS(Opcode::Leave);
     auto [encoded, length] = encode(inst);
@@ -363,36 +548,84 @@ TEST(x86EncoderTest, Mov32Reg_r11dImm32) {
     EXPECT_EQ(encoded[5], 0x00);
 }
 
-TEST(x86EncoderTest, Mov64Reg_rbxImm64) {
+TEST(x86EncoderTest, Mov64Reg_rbxZero) {
     BUILD(Opcode::Mov, 64).reg(Register::rbx).imm(0);
     auto [encoded, length] = encode(inst);
-    EXPECT_EQ(length, 10);
-    EXPECT_EQ(encoded[0], 0x48); // REX.W
-    EXPECT_EQ(encoded[1], 0xbb); // mov r64, imm64 = b8 + rbx=3
+    EXPECT_EQ(length, 5);
+    EXPECT_EQ(encoded[0], 0xbb); // mov r32, imm32 = b8 + ebx=3
+    EXPECT_EQ(encoded[1], 0x00);
+    EXPECT_EQ(encoded[2], 0x00);
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+}
+
+TEST(x86EncoderTest, Mov64Reg_r11Zero) {
+    BUILD(Opcode::Mov, 64).reg(Register::r11).imm(0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0x41); // REX.B(r11)
+    EXPECT_EQ(encoded[1], 0xbb); // mov r32, imm32 = b8 + r11d=3
     EXPECT_EQ(encoded[2], 0x00);
     EXPECT_EQ(encoded[3], 0x00);
     EXPECT_EQ(encoded[4], 0x00);
     EXPECT_EQ(encoded[5], 0x00);
-    EXPECT_EQ(encoded[6], 0x00);
-    EXPECT_EQ(encoded[7], 0x00);
-    EXPECT_EQ(encoded[8], 0x00);
-    EXPECT_EQ(encoded[9], 0x00);
+}
+
+TEST(x86EncoderTest, Mov64Reg_rbxImm64) {
+    BUILD(Opcode::Mov, 64).reg(Register::rbx).imm(0x123456789abcdef0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 10);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0xbb); // mov r64, imm64 = b8 + rbx=3
+    EXPECT_EQ(encoded[2], 0xf0);
+    EXPECT_EQ(encoded[3], 0xde);
+    EXPECT_EQ(encoded[4], 0xbc);
+    EXPECT_EQ(encoded[5], 0x9a);
+    EXPECT_EQ(encoded[6], 0x78);
+    EXPECT_EQ(encoded[7], 0x56);
+    EXPECT_EQ(encoded[8], 0x34);
+    EXPECT_EQ(encoded[9], 0x12);
 }
 
 TEST(x86EncoderTest, Mov64Reg_r11Imm64) {
-    BUILD(Opcode::Mov, 64).reg(Register::r11).imm(0);
+    BUILD(Opcode::Mov, 64).reg(Register::r11).imm(0x123456789abcdef0);
     auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 10);
     EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
     EXPECT_EQ(encoded[1], 0xbb); // mov r64, imm64 = b8 + r11=3
+    EXPECT_EQ(encoded[2], 0xf0);
+    EXPECT_EQ(encoded[3], 0xde);
+    EXPECT_EQ(encoded[4], 0xbc);
+    EXPECT_EQ(encoded[5], 0x9a);
+    EXPECT_EQ(encoded[6], 0x78);
+    EXPECT_EQ(encoded[7], 0x56);
+    EXPECT_EQ(encoded[8], 0x34);
+    EXPECT_EQ(encoded[9], 0x12);
+}
+
+TEST(x86EncoderTest, Mov64Reg_r11Imm32ZeroExtended) {
+    BUILD(Opcode::Mov, 64).reg(Register::r11).imm(0x80000000);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0x41); // REX.B(r11)
+    EXPECT_EQ(encoded[1], 0xbb); // mov r32, imm32 = b8 + r11d=3
     EXPECT_EQ(encoded[2], 0x00);
     EXPECT_EQ(encoded[3], 0x00);
     EXPECT_EQ(encoded[4], 0x00);
-    EXPECT_EQ(encoded[5], 0x00);
-    EXPECT_EQ(encoded[6], 0x00);
-    EXPECT_EQ(encoded[7], 0x00);
-    EXPECT_EQ(encoded[8], 0x00);
-    EXPECT_EQ(encoded[9], 0x00);
+    EXPECT_EQ(encoded[5], 0x80);
+}
+
+TEST(x86EncoderTest, Mov64Reg_rbxImm32SignExtended) {
+    BUILD(Opcode::Mov, 64).reg(Register::rbx).imm(static_cast<std::uint64_t>(-2));
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 7);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0xc7); // mov r/m64, imm32
+    EXPECT_EQ(encoded[2], 0xc3); // modrm(0b11, 0, rbx=3)
+    EXPECT_EQ(encoded[3], 0xfe);
+    EXPECT_EQ(encoded[4], 0xff);
+    EXPECT_EQ(encoded[5], 0xff);
+    EXPECT_EQ(encoded[6], 0xff);
 }
 
 // TODO: Tests for Mov16 and Mov32.
@@ -417,24 +650,42 @@ TEST(x86EncoderTest, Mov64Base_rbpDisp8Reg_r10) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST(x86EncoderTest, Mov64Base_r11Disp8Reg_rax) {
+TEST(x86EncoderTest, Mov64Base_r11Reg_rax) {
     BUILD(Opcode::Mov, 64).base_disp(Register::r11, 0).reg(Register::rax);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
+    EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
+    EXPECT_EQ(encoded[2], 0x03); // modrm(0b00, rax=0, [r11-8=rbx])
+}
+
+TEST(x86EncoderTest, Mov64Base_r11Disp8Reg_rax) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::r11, 8).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
     EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
     EXPECT_EQ(encoded[2], 0x43); // modrm(0b01, rax=0, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
-TEST(x86EncoderTest, Mov64Base_r11Disp8Reg_r10) {
+TEST(x86EncoderTest, Mov64Base_r11Reg_r10) {
     BUILD(Opcode::Mov, 64).base_disp(Register::r11, 0).reg(Register::r10);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x4d); // REX.W + REX.R(r10) + REX.B(r11)
+    EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
+    EXPECT_EQ(encoded[2], 0x13); // modrm(0b00, r10=2, [r11-8=rbx])
+}
+
+TEST(x86EncoderTest, Mov64Base_r11Disp8Reg_r10) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::r11, 8).reg(Register::r10);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x4d); // REX.W + REX.R(r10) + REX.B(r11)
     EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
     EXPECT_EQ(encoded[2], 0x53); // modrm(0b01, r10=2, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST(x86EncoderTest, Mov64Reg_raxBase_rbpDisp8) {
@@ -447,14 +698,23 @@ TEST(x86EncoderTest, Mov64Reg_raxBase_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST(x86EncoderTest, Mov64Reg_raxBase_r11Disp8) {
+TEST(x86EncoderTest, Mov64Reg_raxBase_r11) {
     BUILD(Opcode::Mov, 64).reg(Register::rax).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
+    EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
+    EXPECT_EQ(encoded[2], 0x03); // modrm(0b00, rax=0, [r11-8=rbx])
+}
+
+TEST(x86EncoderTest, Mov64Reg_raxBase_r11Disp8) {
+    BUILD(Opcode::Mov, 64).reg(Register::rax).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r11)
     EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
     EXPECT_EQ(encoded[2], 0x43); // modrm(0b01, rax=0, [r11-8=rbx]+disp8)
-    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[3], 0x08);
 }
 
 TEST(x86EncoderTest, Mov64Reg_r10Base_rbpDisp8) {
@@ -467,16 +727,104 @@ TEST(x86EncoderTest, Mov64Reg_r10Base_rbpDisp8) {
     EXPECT_EQ(encoded[3], 0x00);
 }
 
-TEST(x86EncoderTest, Mov64Reg_r10Base_r11Disp8) {
+TEST(x86EncoderTest, Mov64Reg_r10Base_r11) {
     BUILD(Opcode::Mov, 64).reg(Register::r10).base_disp(Register::r11, 0);
     auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x4d); // REX.W + REX.R(r10) + REX.B(r11)
+    EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
+    EXPECT_EQ(encoded[2], 0x13); // modrm(0b00, r10=2, [r11-8=rbx])
+}
+
+TEST(x86EncoderTest, Mov64Reg_r10Base_r11Disp8) {
+    BUILD(Opcode::Mov, 64).reg(Register::r10).base_disp(Register::r11, 8);
+    auto [encoded, length] = encode(inst);
     EXPECT_EQ(length, 4);
     EXPECT_EQ(encoded[0], 0x4d); // REX.W + REX.R(r10) + REX.B(r11)
     EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
     EXPECT_EQ(encoded[2], 0x53); // modrm(0b01, r10=2, [r11-8=rbx]+disp8)
+    EXPECT_EQ(encoded[3], 0x08);
+}
+
+TEST(x86EncoderTest, Mov64Base_r13Reg_rax) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::r13, 0).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r13)
+    EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
+    EXPECT_EQ(encoded[2], 0x45); // modrm(0b01, rax=0, [r13-8=rbp]+disp8), as mod 0b00 would be [rip]+disp32
     EXPECT_EQ(encoded[3], 0x00);
 }
 
+TEST(x86EncoderTest, Mov64Reg_raxBase_rbpDisp32) {
+    BUILD(Opcode::Mov, 64).reg(Register::rax).base_disp(Register::rbp, -0x100);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 7);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
+    EXPECT_EQ(encoded[2], 0x85); // modrm(0b10, rax=0, [rbp]+disp32)
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0xff);
+    EXPECT_EQ(encoded[5], 0xff);
+    EXPECT_EQ(encoded[6], 0xff);
+}
+
+TEST(x86EncoderTest, Mov64Base_rspDisp8Reg_rax) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::rsp, 8).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 5);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
+    EXPECT_EQ(encoded[2], 0x44); // modrm(0b01, rax=0, sib+disp8)
+    EXPECT_EQ(encoded[3], 0x24); // sib(0, none=4, rsp=4)
+    EXPECT_EQ(encoded[4], 0x08);
+}
+
+TEST(x86EncoderTest, Mov64Base_r12Reg_rax) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::r12, 0).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x49); // REX.W + REX.B(r12)
+    EXPECT_EQ(encoded[1], 0x89); // mov r/m64, r64
+    EXPECT_EQ(encoded[2], 0x04); // modrm(0b00, rax=0, sib)
+    EXPECT_EQ(encoded[3], 0x24); // sib(0, none=4, r12-8=rsp)
+}
+
+TEST(x86EncoderTest, Mov64Reg_raxBaseIndex_rbxScale4_rcx) {
+    BUILD(Opcode::Mov, 64).reg(Register::rax).base_index_disp(Register::rbx, Register::rcx, 4, 0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
+    EXPECT_EQ(encoded[2], 0x04); // modrm(0b00, rax=0, sib)
+    EXPECT_EQ(encoded[3], 0x8b); // sib(4=0b10, rcx=1, rbx=3)
+}
+
+TEST(x86EncoderTest, Mov64Reg_r10BaseIndex_r13Scale8_r9Disp32) {
+    BUILD(Opcode::Mov, 64).reg(Register::r10).base_index_disp(Register::r13, Register::r9, 8, 0x1000);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 8);
+    EXPECT_EQ(encoded[0], 0x4f); // REX.W + REX.R(r10) + REX.X(r9) + REX.B(r13)
+    EXPECT_EQ(encoded[1], 0x8b); // mov r64, r/m64
+    EXPECT_EQ(encoded[2], 0x94); // modrm(0b10, r10=2, sib+disp32)
+    EXPECT_EQ(encoded[3], 0xcd); // sib(8=0b11, r9-8=1, r13-8=5)
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x10);
+    EXPECT_EQ(encoded[6], 0x00);
+    EXPECT_EQ(encoded[7], 0x00);
+}
+
+TEST(x86EncoderTest, Add32Reg_eaxBaseIndex_rbpScale2_r12) {
+    BUILD(Opcode::Add, 32).reg(Register::rax).base_index_disp(Register::rbp, Register::r12, 2, 0);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 5);
+    EXPECT_EQ(encoded[0], 0x42); // REX.X(r12)
+    EXPECT_EQ(encoded[1], 0x03); // add r32, r/m32
+    EXPECT_EQ(encoded[2], 0x44); // modrm(0b01, eax=0, sib+disp8), as there's no [rbp] without a displacement
+    EXPECT_EQ(encoded[3], 0x65); // sib(2=0b01, r12-8=4, rbp=5)
+    EXPECT_EQ(encoded[4], 0x00);
+}
+
 TEST(x86EncoderTest, Mov64Reg_raxReg_rbx) {
     BUILD(Opcode::Mov, 64).reg(Register::rax).reg(Register::rbx);
     auto [encoded, length] = encode(inst);
@@ -495,6 +843,126 @@ TEST(x86EncoderTest, Mov64Reg_r11Reg_r12) {
     EXPECT_EQ(encoded[2], 0xe3); // modrm(0b11, r12=4, r11=3)
 }
 
+TEST(x86EncoderTest, Mov64Base_rbpDisp8Imm32) {
+    BUILD(Opcode::Mov, 64).base_disp(Register::rbp, -8).imm(0x12345678);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 8);
+    EXPECT_EQ(encoded[0], 0x48); // REX.W
+    EXPECT_EQ(encoded[1], 0xc7); // mov r/m64, imm32
+    EXPECT_EQ(encoded[2], 0x45); // modrm(0b01, 0, [rbp]+disp8)
+    EXPECT_EQ(encoded[3], 0xf8);
+    EXPECT_EQ(encoded[4], 0x78);
+    EXPECT_EQ(encoded[5], 0x56);
+    EXPECT_EQ(encoded[6], 0x34);
+    EXPECT_EQ(encoded[7], 0x12);
+}
+
+TEST(x86EncoderTest, JeOff8) {
+    BUILD(Opcode::Je, 0).off(-2);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 2);
+    EXPECT_EQ(encoded[0], 0x74); // je off8
+    EXPECT_EQ(encoded[1], 0xfc);
+}
+
+TEST(x86EncoderTest, JmpOff8) {
+    BUILD(Opcode::Jmp, 0).off(0x10);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 2);
+    EXPECT_EQ(encoded[0], 0xeb); // jmp off8
+    EXPECT_EQ(encoded[1], 0x0e);
+}
+
+TEST(x86EncoderTest, JeOff32) {
+    BUILD(Opcode::Je, 0).off(0x100);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0x0f); // je off32
+    EXPECT_EQ(encoded[1], 0x84);
+    EXPECT_EQ(encoded[2], 0xfa);
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+}
+
+TEST(x86EncoderTest, JmpOff32) {
+    BUILD(Opcode::Jmp, 0).off(-0x200);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 5);
+    EXPECT_EQ(encoded[0], 0xe9); // jmp off32
+    EXPECT_EQ(encoded[1], 0xfb);
+    EXPECT_EQ(encoded[2], 0xfd);
+    EXPECT_EQ(encoded[3], 0xff);
+    EXPECT_EQ(encoded[4], 0xff);
+}
+
+TEST(x86EncoderTest, JmpReg_rax) {
+    BUILD(Opcode::Jmp, 64).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 2);
+    EXPECT_EQ(encoded[0], 0xff); // jmp r/m64
+    EXPECT_EQ(encoded[1], 0xe0); // modrm(0b11, 4, rax=0)
+}
+
+TEST(x86EncoderTest, JmpReg_r11) {
+    BUILD(Opcode::Jmp, 64).reg(Register::r11);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x41); // REX.B
+    EXPECT_EQ(encoded[1], 0xff); // jmp r/m64
+    EXPECT_EQ(encoded[2], 0xe3); // modrm(0b11, 4, r11=3)
+}
+
+TEST(x86EncoderTest, Movzx8Reg_eaxReg_al) {
+    BUILD(Opcode::Movzx, 8).reg(Register::rax).reg(Register::rax);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 3);
+    EXPECT_EQ(encoded[0], 0x0f); // secondary opcode table
+    EXPECT_EQ(encoded[1], 0xb6); // movzx r32, r/m8
+    EXPECT_EQ(encoded[2], 0xc0); // modrm(0b11, eax=0, al=0)
+}
+
+TEST(x86EncoderTest, Movzx8Reg_esiReg_sil) {
+    // sil needs an empty REX prefix to not be taken as dh.
+    BUILD(Opcode::Movzx, 8).reg(Register::rsi).reg(Register::rsi);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x40); // REX
+    EXPECT_EQ(encoded[1], 0x0f); // secondary opcode table
+    EXPECT_EQ(encoded[2], 0xb6); // movzx r32, r/m8
+    EXPECT_EQ(encoded[3], 0xf6); // modrm(0b11, esi=6, sil=6)
+}
+
+TEST(x86EncoderTest, Movzx16Reg_r9dReg_cx) {
+    BUILD(Opcode::Movzx, 16).reg(Register::r9).reg(Register::rcx);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x44); // REX.R(r9)
+    EXPECT_EQ(encoded[1], 0x0f); // secondary opcode table
+    EXPECT_EQ(encoded[2], 0xb7); // movzx r32, r/m16
+    EXPECT_EQ(encoded[3], 0xc9); // modrm(0b11, r9d=1, cx=1)
+}
+
+TEST(x86EncoderTest, Movsx8Reg_eaxReg_r11b) {
+    BUILD(Opcode::Movsx, 8).reg(Register::rax).reg(Register::r11);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x41); // REX.B(r11)
+    EXPECT_EQ(encoded[1], 0x0f); // secondary opcode table
+    EXPECT_EQ(encoded[2], 0xbe); // movsx r32, r/m8
+    EXPECT_EQ(encoded[3], 0xc3); // modrm(0b11, eax=0, r11b=3)
+}
+
+TEST(x86EncoderTest, Movsx16Base_rbpDisp8) {
+    BUILD(Opcode::Movsx, 16).reg(Register::rdx).base_disp(Register::rbp, -2);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 4);
+    EXPECT_EQ(encoded[0], 0x0f); // secondary opcode table
+    EXPECT_EQ(encoded[1], 0xbf); // movsx r32, r/m16
+    EXPECT_EQ(encoded[2], 0x55); // modrm(0b01, edx=2, [rbp]+disp8)
+    EXPECT_EQ(encoded[3], 0xfe);
+}
+
 TEST(x86EncoderTest, PopReg_rbx) {
     BUILD(Opcode::Pop, 64).reg(Register::rbx);
     auto [encoded, length] = encode(inst);
@@ -583,7 +1051,59 @@ INSTANTIATE_TEST_SUITE_P(x86EncoderTest, Setcc,
                                          std::pair<Opcode, std::uint8_t>(Opcode::Setl, 0x9c),
                                          std::pair<Opcode, std::uint8_t>(Opcode::Setg, 0x9f),
                                          std::pair<Opcode, std::uint8_t>(Opcode::Setle, 0x9e),
-                                         std::pair<Opcode, std::uint8_t>(Opcode::Setge, 0x9d)));
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Setge, 0x9d),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Setb, 0x92),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Seta, 0x97),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Setbe, 0x96),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Setae, 0x93)));
+
+// Parameterised on the condition code, which is added to the base opcode of each form.
+class Jcc : public testing::TestWithParam<std::pair<Opcode, std::uint8_t>> {};
+
+TEST_P(Jcc, JccOff8) {
+    auto [opcode, condition] = GetParam();
+    BUILD(opcode, 0).off(-2);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 2);
+    EXPECT_EQ(encoded[0], 0x70 + condition); // jcc off8
+    EXPECT_EQ(encoded[1], 0xfc);
+}
+
+TEST_P(Jcc, JccOff32) {
+    auto [opcode, condition] = GetParam();
+    BUILD(opcode, 0).off(0x100);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(length, 6);
+    EXPECT_EQ(encoded[0], 0x0f);             // secondary opcode table
+    EXPECT_EQ(encoded[1], 0x80 + condition); // jcc off32
+    EXPECT_EQ(encoded[2], 0xfa);
+    EXPECT_EQ(encoded[3], 0x00);
+    EXPECT_EQ(encoded[4], 0x00);
+    EXPECT_EQ(encoded[5], 0x00);
+}
+
+TEST_P(Jcc, Invert) {
+    auto [opcode, condition] = GetParam();
+    const auto inverted = invert_cond_jump(opcode);
+    EXPECT_NE(inverted, opcode);
+    EXPECT_EQ(invert_cond_jump(inverted), opcode);
+    // Conditions come in pairs that differ in the lowest bit.
+    BUILD(inverted, 0).off(-2);
+    auto [encoded, length] = encode(inst);
+    EXPECT_EQ(encoded[0], 0x70 + (condition ^ 1u));
+}
+
+INSTANTIATE_TEST_SUITE_P(x86EncoderTest, Jcc,
+                         testing::Values(std::pair<Opcode, std::uint8_t>(Opcode::Je, 0x4),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jne, 0x5),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jl, 0xc),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jg, 0xf),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jle, 0xe),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jge, 0xd),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jb, 0x2),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Ja, 0x7),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jbe, 0x6),
+                                         std::pair<Opcode, std::uint8_t>(Opcode::Jae, 0x3)));
 
 } // namespace
 } // namespace coel::x86
@@ -0,0 +1,78 @@
+#include <coel/x86/Builder.hh>
+#include <coel/x86/InstStream.hh>
+#include <coel/x86/MachineInst.hh>
+#include <coel/x86/Register.hh>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace coel::x86 {
+namespace {
+
+int s_label = 0;
+
+TEST(x86InstStreamTest, RoundTrip) {
+    std::vector<MachineInst> insts;
+    Builder(&insts.emplace_back(MachineInst{Opcode::Lbl})).lbl(&s_label);
+    Builder(&insts.emplace_back(MachineInst{Opcode::Mov})).reg(Register::r11).imm(0x123456789abcdef0).width(64);
+    Builder(&insts.emplace_back(MachineInst{Opcode::Sub})).reg(Register::rsp).imm(-16).width(64);
+    Builder(&insts.emplace_back(MachineInst{Opcode::Mov}))
+        .base_index_disp(Register::rbx, Register::rcx, 8, -0x1000)
+        .reg(Register::rax)
+        .width(32);
+    Builder(&insts.emplace_back(MachineInst{Opcode::Mov})).reg(Register::rax).base_disp(Register::rbp, -8).width(16);
+    Builder(&insts.emplace_back(MachineInst{Opcode::Jmp})).off(-0x80000001);
+    insts.push_back(MachineInst{Opcode::Ret});
+
+    InstStream stream(insts);
+    ASSERT_EQ(stream.size(), insts.size());
+    EXPECT_LT(stream.byte_size(), insts.size() * sizeof(MachineInst) / 4);
+
+    auto it = stream.begin();
+    EXPECT_EQ(it->opcode, Opcode::Lbl);
+    EXPECT_EQ(it->operands[0].type, OperandType::Lbl);
+    EXPECT_EQ(it->operands[0].lbl, &s_label);
+    EXPECT_EQ(it->operands[1].type, OperandType::None);
+
+    ++it;
+    EXPECT_EQ(it->opcode, Opcode::Mov);
+    EXPECT_EQ(it->operand_width, 64);
+    EXPECT_EQ(it->operands[0].type, OperandType::Reg);
+    EXPECT_EQ(it->operands[0].reg, Register::r11);
+    EXPECT_EQ(it->operands[1].type, OperandType::Imm);
+    EXPECT_EQ(it->operands[1].imm, 0x123456789abcdef0);
+
+    ++it;
+    EXPECT_EQ(it->opcode, Opcode::Sub);
+    EXPECT_EQ(it->operands[1].imm, static_cast<std::uint64_t>(-16));
+
+    ++it;
+    EXPECT_EQ(it->operand_width, 32);
+    EXPECT_EQ(it->operands[0].type, OperandType::BaseIndexDisp);
+    EXPECT_EQ(it->operands[0].base, Register::rbx);
+    EXPECT_EQ(it->operands[0].index, Register::rcx);
+    EXPECT_EQ(it->operands[0].scale, 8);
+    EXPECT_EQ(it->operands[0].disp, -0x1000);
+    EXPECT_EQ(it->operands[1].reg, Register::rax);
+
+    ++it;
+    EXPECT_EQ(it->operand_width, 16);
+    EXPECT_EQ(it->operands[1].type, OperandType::BaseDisp);
+    EXPECT_EQ(it->operands[1].base, Register::rbp);
+    EXPECT_EQ(it->operands[1].disp, -8);
+
+    ++it;
+    EXPECT_EQ(it->opcode, Opcode::Jmp);
+    EXPECT_EQ(it->operands[0].type, OperandType::Off);
+    EXPECT_EQ(it->operands[0].off, -0x80000001);
+
+    ++it;
+    EXPECT_EQ(it->opcode, Opcode::Ret);
+    EXPECT_EQ(it->operands[0].type, OperandType::None);
+    EXPECT_EQ(++it, stream.end());
+}
+
+} // namespace
+} // namespace coel::x86
@@ -0,0 +1,180 @@
+#include <coel/x86/MachineFunction.hh>
+#include <coel/x86/MachineInst.hh>
+#include <coel/x86/MachinePasses.hh>
+#include <coel/x86/Register.hh>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace coel::x86 {
+namespace {
+
+int s_function = 0;
+int s_target = 0;
+
+TEST(x86PeepholeTest, SelfMove) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Mov).reg(Register::rax).reg(Register::rax).width(32);
+    entry->append(Opcode::Mov).reg(Register::rax).reg(Register::rbx).width(32);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.self_moves, 1);
+    ASSERT_EQ(entry->insts().size(), 2);
+    EXPECT_EQ(entry->insts()[0].operands[1].reg, Register::rbx);
+}
+
+TEST(x86PeepholeTest, ZeroMove) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Mov).reg(Register::r11).imm(0).width(64);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.zero_moves, 1);
+    const auto &inst = entry->insts()[0];
+    EXPECT_EQ(inst.opcode, Opcode::Xor);
+    EXPECT_EQ(inst.operand_width, 32);
+    EXPECT_EQ(inst.operands[0].reg, Register::r11);
+    EXPECT_EQ(inst.operands[1].reg, Register::r11);
+}
+
+TEST(x86PeepholeTest, ZeroMoveFlagsLive) {
+    // The mov sits between a cmp and the jump that reads its flags, so it can't become an xor.
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(1).width(32);
+    entry->append(Opcode::Mov).reg(Register::rax).imm(0).width(32);
+    auto *next = function.append_block(&s_target);
+    next->append(Opcode::JeLbl).lbl(&s_function);
+    next->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.zero_moves, 0);
+    EXPECT_EQ(entry->insts()[1].opcode, Opcode::Mov);
+}
+
+TEST(x86PeepholeTest, IncrementDecrement) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Add).reg(Register::rax).imm(1).width(64);
+    entry->append(Opcode::Sub).reg(Register::rbx).imm(1).width(32);
+    entry->append(Opcode::Add).reg(Register::rcx).imm(static_cast<std::uint64_t>(-1)).width(16);
+    entry->append(Opcode::Add).reg(Register::rdx).imm(2).width(32);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.increments, 1);
+    EXPECT_EQ(stats.decrements, 2);
+    const auto &insts = entry->insts();
+    EXPECT_EQ(insts[0].opcode, Opcode::Inc);
+    EXPECT_EQ(insts[0].operand_width, 64);
+    EXPECT_EQ(insts[1].opcode, Opcode::Dec);
+    EXPECT_EQ(insts[2].opcode, Opcode::Dec);
+    EXPECT_EQ(insts[2].operands[0].reg, Register::rcx);
+    EXPECT_EQ(insts[3].opcode, Opcode::Add);
+}
+
+TEST(x86PeepholeTest, RedundantCompare) {
+    // A countdown, where the dec already sets the zero flag that jne reads.
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Sub).reg(Register::rcx).imm(1).width(32);
+    entry->append(Opcode::Mov).base_disp(Register::rbp, -4).reg(Register::rcx).width(32);
+    entry->append(Opcode::Cmp).reg(Register::rcx).imm(0).width(32);
+    entry->append(Opcode::JneLbl).lbl(&s_function);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.redundant_compares, 1);
+    EXPECT_EQ(stats.decrements, 1);
+    const auto &insts = entry->insts();
+    ASSERT_EQ(insts.size(), 4);
+    EXPECT_EQ(insts[0].opcode, Opcode::Dec);
+    EXPECT_EQ(insts[1].opcode, Opcode::Mov);
+    EXPECT_EQ(insts[2].opcode, Opcode::JneLbl);
+}
+
+TEST(x86PeepholeTest, CompareKept) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    // The signed conditions also read the sign and overflow flags, which the sub sets differently.
+    entry->append(Opcode::Sub).reg(Register::rax).reg(Register::rbx).width(32);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(0).width(32);
+    entry->append(Opcode::JlLbl).lbl(&s_target);
+    // The register is overwritten after the add.
+    entry->append(Opcode::Add).reg(Register::rax).reg(Register::rbx).width(32);
+    entry->append(Opcode::Mov).reg(Register::rax).reg(Register::rcx).width(32);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(0).width(32);
+    entry->append(Opcode::JeLbl).lbl(&s_target);
+    // The add is on a different register.
+    entry->append(Opcode::Add).reg(Register::rbx).reg(Register::rcx).width(32);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(0).width(32);
+    entry->append(Opcode::JeLbl).lbl(&s_target);
+    // The add is at a different width.
+    entry->append(Opcode::Add).reg(Register::rax).reg(Register::rcx).width(64);
+    entry->append(Opcode::Cmp).reg(Register::rax).imm(0).width(32);
+    entry->append(Opcode::JeLbl).lbl(&s_target);
+    auto *target = function.append_block(&s_target);
+    target->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.redundant_compares, 0);
+    EXPECT_EQ(entry->insts().size(), 13);
+}
+
+TEST(x86PeepholeTest, ThreeOperandAdd) {
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Mov).reg(Register::rax).reg(Register::rbx).width(32);
+    entry->append(Opcode::Add).reg(Register::rax).reg(Register::rcx).width(32);
+    entry->append(Opcode::Mov).reg(Register::rdx).reg(Register::rsi).width(64);
+    entry->append(Opcode::Sub).reg(Register::rdx).imm(8).width(64);
+    entry->append(Opcode::Mov).reg(Register::rdi).reg(Register::rsi).width(32);
+    entry->append(Opcode::Add).reg(Register::rdi).reg(Register::rdi).width(32);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.three_operand_adds, 3);
+    const auto &insts = entry->insts();
+    ASSERT_EQ(insts.size(), 4);
+    EXPECT_EQ(insts[0].opcode, Opcode::Lea);
+    EXPECT_EQ(insts[0].operands[0].reg, Register::rax);
+    EXPECT_EQ(insts[0].operands[1].type, OperandType::BaseIndexDisp);
+    EXPECT_EQ(insts[0].operands[1].base, Register::rbx);
+    EXPECT_EQ(insts[0].operands[1].index, Register::rcx);
+    EXPECT_EQ(insts[1].opcode, Opcode::Lea);
+    EXPECT_EQ(insts[1].operand_width, 64);
+    EXPECT_EQ(insts[1].operands[1].type, OperandType::BaseDisp);
+    EXPECT_EQ(insts[1].operands[1].base, Register::rsi);
+    EXPECT_EQ(insts[1].operands[1].disp, -8);
+    EXPECT_EQ(insts[2].operands[1].base, Register::rsi);
+    EXPECT_EQ(insts[2].operands[1].index, Register::rsi);
+}
+
+TEST(x86PeepholeTest, ThreeOperandAddFlagsLive) {
+    // The jl reads the flags of the add, which the lea wouldn't set.
+    MachineFunction function;
+    auto *entry = function.append_block(&s_function);
+    entry->append(Opcode::Mov).reg(Register::rax).reg(Register::rbx).width(32);
+    entry->append(Opcode::Add).reg(Register::rax).reg(Register::rcx).width(32);
+    entry->append(Opcode::JlLbl).lbl(&s_function);
+    entry->append(Opcode::Ret);
+
+    MachinePassStats stats;
+    peephole(function, stats);
+    EXPECT_EQ(stats.three_operand_adds, 0);
+    EXPECT_EQ(entry->insts()[1].opcode, Opcode::Add);
+}
+
+} // namespace
+} // namespace coel::x86